@@ -0,0 +1,184 @@
+#pragma once
+
+#include "AssetLoader.h"
+#include "Helpers.h"
+#include "MappedFile.h"
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// --------------------------------------------------------
+// Caches assets (e.g. texture SRVs) by file, so nothing is
+// ever decoded twice in a process
+//
+// - Paths are normalized, so different spellings of one
+//   file share an entry
+// - Files are also keyed by a hash of their bytes: a copy
+//   of an already-loaded file at another path gets the
+//   same asset without being decoded again
+// - Loading is in two steps, like AssetLoader's meshes:
+//   Decode turns file bytes into CPU data and may run on a
+//   worker thread; Create turns that into the asset and
+//   only runs on the thread calling Get()
+// - Failed loads are cached too (as an empty Value), so a
+//   missing file isn't retried every call
+// --------------------------------------------------------
+template<typename Decoded, typename Value>
+class AssetCache
+{
+public:
+	typedef std::function<bool(const char* data, size_t size, Decoded& decoded)> DecodeFunction;
+	typedef std::function<Value(const Decoded& decoded)> CreateFunction;
+
+	struct Stats
+	{
+		size_t Hits;        // Path already loaded
+		size_t ContentHits; // Same bytes already loaded from another path
+		size_t Misses;      // Decoded and created
+		size_t Failures;    // Couldn't be read or decoded
+	};
+
+private:
+	// What a worker hands back: the file's hash, plus its decoded
+	// data if this file was the first with those bytes
+	struct Loaded
+	{
+		uint64_t Hash = 0;
+		bool Read = false;
+		bool Claimed = false;
+		bool Succeeded = false;
+		Decoded Data;
+	};
+
+	DecodeFunction decode;
+	CreateFunction create;
+	Stats stats;
+
+	// Only touched by the thread calling Prefetch() / Get()
+	// - byPath holds both normalized paths and the spellings
+	//   callers used, so repeat lookups skip normalizing
+	std::unordered_map<std::wstring, Value> byPath;
+	std::unordered_map<uint64_t, Value> byContent;
+	std::unordered_map<std::wstring, std::shared_future<std::shared_ptr<Loaded>>> pending;
+
+	// Which path gets to decode each distinct file content; shared with workers
+	std::mutex claimLock;
+	std::unordered_map<uint64_t, std::wstring> claims;
+
+	static std::wstring Normalize(const std::wstring& path)
+	{
+		std::error_code error;
+		std::filesystem::path absolute = std::filesystem::absolute(path, error);
+		return (error ? std::filesystem::path(path) : absolute).lexically_normal().wstring();
+	}
+
+	std::shared_ptr<Loaded> Load(const std::wstring& path)
+	{
+		std::shared_ptr<Loaded> loaded = std::make_shared<Loaded>();
+		MappedFile file;
+		if (!file.Open(path))
+			return loaded;
+
+		loaded->Read = true;
+		loaded->Hash = HashBytes(file.GetData(), file.GetSize());
+		{
+			std::lock_guard<std::mutex> lock(claimLock);
+			loaded->Claimed = claims.insert({ loaded->Hash, path }).second;
+		}
+
+		if (loaded->Claimed)
+			loaded->Succeeded = decode(file.GetData(), file.GetSize(), loaded->Data);
+		return loaded;
+	}
+
+public:
+	AssetCache(DecodeFunction decode, CreateFunction create) :
+		decode(decode),
+		create(create),
+		stats()
+	{
+	}
+
+	// Starts reading and decoding a file on the loader's threads,
+	// unless it's already loaded or on its way
+	// - The loader has to outlive the matching Get()
+	void Prefetch(const std::wstring& path, AssetLoader& loader)
+	{
+		std::wstring key = Normalize(path);
+		if (byPath.count(key) || pending.count(key))
+			return;
+
+		pending[key] = loader.Submit([this, key]() { return Load(key); }).share();
+	}
+
+	// The asset for a file, loading it (or waiting on its prefetch) the first time
+	Value Get(const std::wstring& path)
+	{
+		auto found = byPath.find(path);
+		if (found != byPath.end())
+		{
+			stats.Hits++;
+			return found->second;
+		}
+
+		// A new spelling of a loaded file
+		std::wstring key = Normalize(path);
+		found = byPath.find(key);
+		if (found != byPath.end())
+		{
+			stats.Hits++;
+			byPath[path] = found->second;
+			return found->second;
+		}
+
+		std::shared_ptr<Loaded> loaded;
+		auto waiting = pending.find(key);
+		if (waiting != pending.end())
+		{
+			loaded = waiting->second.get();
+			pending.erase(waiting);
+		}
+		else
+			loaded = Load(key);
+
+		Value value = Value();
+		if (loaded->Read && !loaded->Claimed)
+		{
+			// Another path has these bytes; make sure it's created, then share it
+			std::wstring owner;
+			{
+				std::lock_guard<std::mutex> lock(claimLock);
+				owner = claims[loaded->Hash];
+			}
+			if (!byContent.count(loaded->Hash))
+				Get(owner);
+			value = byContent[loaded->Hash];
+			stats.ContentHits++;
+		}
+		else if (loaded->Succeeded)
+		{
+			value = create(loaded->Data);
+			byContent[loaded->Hash] = value;
+			stats.Misses++;
+		}
+		else
+		{
+			// Unreadable, or read but not decodable
+			if (loaded->Read)
+				byContent[loaded->Hash] = value;
+			stats.Failures++;
+		}
+
+		byPath[key] = value;
+		byPath[path] = value;
+		return value;
+	}
+
+	// Distinct file contents loaded (or failed)
+	size_t GetCount() { return byContent.size(); }
+	const Stats& GetStats() { return stats; }
+};
@@ -0,0 +1,67 @@
+#include "AssetLoader.h"
+
+AssetLoader::AssetLoader(unsigned int threadCount) :
+	stopping(false)
+{
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+
+	for (unsigned int i = 0; i < threadCount; i++)
+		workers.emplace_back(&AssetLoader::WorkerLoop, this);
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobLock);
+		stopping = true;
+	}
+	jobReady.notify_all();
+
+	for (auto& worker : workers)
+		worker.join();
+}
+
+void AssetLoader::Enqueue(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(jobLock);
+		jobs.push_back(std::move(job));
+	}
+	jobReady.notify_one();
+}
+
+// --------------------------------------------------------
+// Runs jobs until the loader is destroyed and the queue
+// has drained
+// --------------------------------------------------------
+void AssetLoader::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(jobLock);
+			jobReady.wait(lock, [this]() { return stopping || !jobs.empty(); });
+			if (jobs.empty())
+				return;
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		job();
+	}
+}
+
+std::future<std::shared_ptr<MeshCache>> AssetLoader::LoadMesh(const std::wstring& objFile)
+{
+	return Submit([objFile]() {
+		std::shared_ptr<MeshCache> cache = std::make_shared<MeshCache>();
+		if (!cache->Load(objFile))
+			cache.reset();
+		return cache;
+	});
+}
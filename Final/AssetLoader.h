@@ -0,0 +1,59 @@
+#pragma once
+
+#include "MeshCache.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// Small worker pool for loading assets off the main thread
+//
+// - Submit() queues any callable and returns a future for
+//   its result; jobs run in the order they were queued
+// - Workers only do file I/O and decoding.  Anything that
+//   touches the D3D context stays on the thread that owns
+//   it, which waits on the futures and does the upload
+// - The destructor finishes every queued job before the
+//   workers are joined
+// --------------------------------------------------------
+class AssetLoader
+{
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex jobLock;
+	std::condition_variable jobReady;
+	bool stopping;
+
+	void WorkerLoop();
+	void Enqueue(std::function<void()> job);
+
+public:
+	// 0 threads means one per hardware thread
+	AssetLoader(unsigned int threadCount = 0);
+	~AssetLoader();
+
+	AssetLoader(AssetLoader const&) = delete;
+	void operator=(AssetLoader const&) = delete;
+
+	template<typename Work>
+	std::future<decltype(std::declval<Work>()())> Submit(Work work)
+	{
+		// std::function needs something copyable, so the task lives in a shared_ptr
+		auto task = std::make_shared<std::packaged_task<decltype(work())()>>(std::move(work));
+		auto result = task->get_future();
+		Enqueue([task]() { (*task)(); });
+		return result;
+	}
+
+	// Loads a mesh through its binary cache; null if the load failed
+	std::future<std::shared_ptr<MeshCache>> LoadMesh(const std::wstring& objFile);
+
+	unsigned int GetThreadCount() { return (unsigned int)workers.size(); }
+};
@@ -0,0 +1,450 @@
+#include "BVH.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// Centroid bins tried per axis when looking for a split
+	const int BinCount = 16;
+
+	struct Bin
+	{
+		XMFLOAT3 BoundsMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 BoundsMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		uint32_t Count = 0;
+	};
+
+	void Grow(XMFLOAT3& boundsMin, XMFLOAT3& boundsMax, const XMFLOAT3& otherMin, const XMFLOAT3& otherMax)
+	{
+		boundsMin = XMFLOAT3(std::min(boundsMin.x, otherMin.x), std::min(boundsMin.y, otherMin.y), std::min(boundsMin.z, otherMin.z));
+		boundsMax = XMFLOAT3(std::max(boundsMax.x, otherMax.x), std::max(boundsMax.y, otherMax.y), std::max(boundsMax.z, otherMax.z));
+	}
+
+	float SurfaceArea(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+	{
+		float x = boundsMax.x - boundsMin.x;
+		float y = boundsMax.y - boundsMin.y;
+		float z = boundsMax.z - boundsMin.z;
+		return 2.0f * (x * y + y * z + z * x);
+	}
+
+	// Distance along the ray to where it enters the box, or FLT_MAX if it misses
+	float RayBoxDistance(const XMFLOAT3& origin, const XMFLOAT3& inverseDirection, const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+	{
+		float near = 0.0f;
+		float far = FLT_MAX;
+		const float* o = &origin.x;
+		const float* inv = &inverseDirection.x;
+		const float* lo = &boundsMin.x;
+		const float* hi = &boundsMax.x;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float t0 = (lo[axis] - o[axis]) * inv[axis];
+			float t1 = (hi[axis] - o[axis]) * inv[axis];
+			near = std::max(near, std::min(t0, t1));
+			far = std::min(far, std::max(t0, t1));
+		}
+		return near <= far ? near : FLT_MAX;
+	}
+
+	// The same plane test as FrustumCuller, so both agree box for box
+	bool OutsidePlane(const XMFLOAT4& plane, const XMFLOAT3& center, const XMFLOAT3& extents, bool& straddles)
+	{
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float radius = fabsf(plane.x) * extents.x + fabsf(plane.y) * extents.y + fabsf(plane.z) * extents.z;
+		straddles = distance - radius < 0.0f;
+		return distance + radius < 0.0f;
+	}
+}
+
+BVH::BVH() :
+	needsRefit(false)
+{
+}
+
+void BVH::Resize(size_t itemCount)
+{
+	itemCenter.resize(itemCount, XMFLOAT3(0, 0, 0));
+	itemExtents.resize(itemCount, XMFLOAT3(0, 0, 0));
+	nodes.clear();
+	items.clear();
+	needsRefit = false;
+}
+
+void BVH::SetBounds(Item item, const XMFLOAT3& center, const XMFLOAT3& extents)
+{
+	itemCenter[item] = center;
+	itemExtents[item] = extents;
+	needsRefit = true;
+}
+
+// Shrinks a leaf's bounds to its items
+void BVH::FitNode(Node& node)
+{
+	node.BoundsMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	node.BoundsMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (uint32_t i = node.First; i < node.First + node.Count; i++)
+	{
+		XMFLOAT3 boundsMin, boundsMax;
+		GetItemBounds(items[i], boundsMin, boundsMax);
+		Grow(node.BoundsMin, node.BoundsMax, boundsMin, boundsMax);
+	}
+}
+
+void BVH::GetItemBounds(Item item, XMFLOAT3& boundsMin, XMFLOAT3& boundsMax)
+{
+	const XMFLOAT3& c = itemCenter[item];
+	const XMFLOAT3& e = itemExtents[item];
+	boundsMin = XMFLOAT3(c.x - e.x, c.y - e.y, c.z - e.z);
+	boundsMax = XMFLOAT3(c.x + e.x, c.y + e.y, c.z + e.z);
+}
+
+// --------------------------------------------------------
+// Builds the tree from scratch, splitting nodes until the
+// surface area heuristic says a leaf is cheaper
+// --------------------------------------------------------
+void BVH::Build()
+{
+	size_t itemCount = itemCenter.size();
+	nodes.clear();
+	items.resize(itemCount);
+	needsRefit = false;
+	if (itemCount == 0)
+		return;
+
+	// Splitting reorders these instead of chasing item ids around
+	std::vector<BuildItem> buildItems(itemCount);
+	for (size_t i = 0; i < itemCount; i++)
+	{
+		GetItemBounds((Item)i, buildItems[i].BoundsMin, buildItems[i].BoundsMax);
+		buildItems[i].Center = itemCenter[i];
+		buildItems[i].Id = (Item)i;
+	}
+
+	// A binary tree over n items never needs more than 2n - 1 nodes
+	nodes.reserve(itemCount * 2 - 1);
+	Node root = {};
+	root.First = 0;
+	root.Count = (uint32_t)itemCount;
+	root.BoundsMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	root.BoundsMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (const BuildItem& b : buildItems)
+		Grow(root.BoundsMin, root.BoundsMax, b.BoundsMin, b.BoundsMax);
+	nodes.push_back(root);
+
+	// Nodes are split in creation order, so children always follow parents
+	for (uint32_t n = 0; n < nodes.size(); n++)
+		Subdivide(n, buildItems);
+
+	for (size_t i = 0; i < itemCount; i++)
+		items[i] = buildItems[i].Id;
+}
+
+// --------------------------------------------------------
+// Splits a leaf in two if that's cheaper by SAH
+// - Item centroids are dropped into bins along each axis,
+//   and every boundary between bins is a candidate
+// - Cost is relative: visiting a node costs its area, and
+//   testing its items costs area * count
+// --------------------------------------------------------
+void BVH::Subdivide(uint32_t nodeIndex, std::vector<BuildItem>& buildItems)
+{
+	Node node = nodes[nodeIndex];
+	if (node.Count <= MaxLeafItems)
+		return;
+
+	BuildItem* first = &buildItems[node.First];
+	BuildItem* last = first + node.Count;
+
+	XMFLOAT3 centroidMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	XMFLOAT3 centroidMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (BuildItem* b = first; b < last; b++)
+		Grow(centroidMin, centroidMax, b->Center, b->Center);
+
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	int bestSplit = 0;
+	Bin bestLeft, bestRight;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float lo = (&centroidMin.x)[axis];
+		float hi = (&centroidMax.x)[axis];
+		if (hi <= lo)
+			continue;
+
+		Bin bins[BinCount];
+		float scale = BinCount / (hi - lo);
+		for (BuildItem* b = first; b < last; b++)
+		{
+			int bin = std::min(BinCount - 1, (int)(((&b->Center.x)[axis] - lo) * scale));
+			Grow(bins[bin].BoundsMin, bins[bin].BoundsMax, b->BoundsMin, b->BoundsMax);
+			bins[bin].Count++;
+		}
+
+		// Sweep from the right to get each split's right-hand side,
+		// then from the left, pricing each split as we go
+		Bin rights[BinCount];
+		for (int bin = BinCount - 1; bin > 0; bin--)
+		{
+			rights[bin] = bin + 1 < BinCount ? rights[bin + 1] : Bin();
+			Grow(rights[bin].BoundsMin, rights[bin].BoundsMax, bins[bin].BoundsMin, bins[bin].BoundsMax);
+			rights[bin].Count += bins[bin].Count;
+		}
+
+		Bin left;
+		for (int split = 1; split < BinCount; split++)
+		{
+			Grow(left.BoundsMin, left.BoundsMax, bins[split - 1].BoundsMin, bins[split - 1].BoundsMax);
+			left.Count += bins[split - 1].Count;
+			if (left.Count == 0 || rights[split].Count == 0)
+				continue;
+
+			float cost =
+				SurfaceArea(left.BoundsMin, left.BoundsMax) * left.Count +
+				SurfaceArea(rights[split].BoundsMin, rights[split].BoundsMax) * rights[split].Count;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+				bestLeft = left;
+				bestRight = rights[split];
+			}
+		}
+	}
+
+	// Every centroid in the same place, or splitting doesn't pay
+	float area = SurfaceArea(node.BoundsMin, node.BoundsMax);
+	if (bestAxis < 0 || area + bestCost >= area * node.Count)
+		return;
+
+	float lo = (&centroidMin.x)[bestAxis];
+	float scale = BinCount / ((&centroidMax.x)[bestAxis] - lo);
+	BuildItem* middle = std::partition(first, last,
+		[&](const BuildItem& b) {
+			return std::min(BinCount - 1, (int)(((&b.Center.x)[bestAxis] - lo) * scale)) < bestSplit;
+		});
+
+	// The winning bins already hold each side's bounds
+	Node left = {};
+	left.First = node.First;
+	left.Count = (uint32_t)(middle - first);
+	left.BoundsMin = bestLeft.BoundsMin;
+	left.BoundsMax = bestLeft.BoundsMax;
+
+	Node right = {};
+	right.First = left.First + left.Count;
+	right.Count = node.Count - left.Count;
+	right.BoundsMin = bestRight.BoundsMin;
+	right.BoundsMax = bestRight.BoundsMax;
+
+	nodes[nodeIndex].First = (uint32_t)nodes.size();
+	nodes[nodeIndex].Count = 0;
+	nodes.push_back(left);
+	nodes.push_back(right);
+}
+
+// --------------------------------------------------------
+// Re-fits every node's bounds to its items' current boxes,
+// keeping the tree's shape
+// - Children come after their parents, so walking the
+//   array backwards finishes children first
+// - Cheap enough to run every frame, but the tree gets
+//   looser as items move away from where they were built
+// --------------------------------------------------------
+void BVH::Refit()
+{
+	if (!needsRefit)
+		return;
+
+	for (size_t n = nodes.size(); n-- > 0;)
+	{
+		Node& node = nodes[n];
+		if (node.Count > 0)
+		{
+			FitNode(node);
+			continue;
+		}
+
+		const Node& left = nodes[node.First];
+		const Node& right = nodes[node.First + 1];
+		node.BoundsMin = left.BoundsMin;
+		node.BoundsMax = left.BoundsMax;
+		Grow(node.BoundsMin, node.BoundsMax, right.BoundsMin, right.BoundsMax);
+	}
+	needsRefit = false;
+}
+
+// A subtree's items are one contiguous run, from its leftmost leaf to its rightmost
+void BVH::AddSubtree(uint32_t nodeIndex, std::vector<Item>& results)
+{
+	uint32_t first = nodeIndex;
+	while (nodes[first].Count == 0)
+		first = nodes[first].First;
+	uint32_t last = nodeIndex;
+	while (nodes[last].Count == 0)
+		last = nodes[last].First + 1;
+
+	results.insert(results.end(), &items[nodes[first].First], &items[nodes[last].First] + nodes[last].Count);
+}
+
+// --------------------------------------------------------
+// Collects items whose boxes aren't entirely outside the
+// frustum
+// - Nodes entirely inside every plane add their whole
+//   subtree without testing anything below them
+// --------------------------------------------------------
+void BVH::QueryFrustum(const XMFLOAT4* planes, std::vector<Item>& results)
+{
+	if (nodes.empty())
+		return;
+
+	stack.clear();
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		uint32_t nodeIndex = stack.back();
+		stack.pop_back();
+
+		XMFLOAT3 center(
+			(node.BoundsMin.x + node.BoundsMax.x) * 0.5f,
+			(node.BoundsMin.y + node.BoundsMax.y) * 0.5f,
+			(node.BoundsMin.z + node.BoundsMax.z) * 0.5f);
+		XMFLOAT3 extents(
+			(node.BoundsMax.x - node.BoundsMin.x) * 0.5f,
+			(node.BoundsMax.y - node.BoundsMin.y) * 0.5f,
+			(node.BoundsMax.z - node.BoundsMin.z) * 0.5f);
+
+		bool outside = false;
+		bool inside = true;
+		for (int p = 0; p < 6 && !outside; p++)
+		{
+			bool straddles;
+			outside = OutsidePlane(planes[p], center, extents, straddles);
+			inside = inside && !straddles;
+		}
+		if (outside)
+			continue;
+
+		if (inside)
+		{
+			AddSubtree(nodeIndex, results);
+			continue;
+		}
+
+		if (node.Count == 0)
+		{
+			stack.push_back(node.First);
+			stack.push_back(node.First + 1);
+			continue;
+		}
+
+		for (uint32_t i = node.First; i < node.First + node.Count; i++)
+		{
+			Item item = items[i];
+			bool straddles;
+			bool itemOutside = false;
+			for (int p = 0; p < 6 && !itemOutside; p++)
+				itemOutside = OutsidePlane(planes[p], itemCenter[item], itemExtents[item], straddles);
+			if (!itemOutside)
+				results.push_back(item);
+		}
+	}
+}
+
+void BVH::QueryOverlap(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax, std::vector<Item>& results)
+{
+	auto overlaps = [&](const XMFLOAT3& otherMin, const XMFLOAT3& otherMax) {
+		return
+			otherMin.x <= boundsMax.x && otherMax.x >= boundsMin.x &&
+			otherMin.y <= boundsMax.y && otherMax.y >= boundsMin.y &&
+			otherMin.z <= boundsMax.z && otherMax.z >= boundsMin.z;
+	};
+
+	if (nodes.empty())
+		return;
+
+	stack.clear();
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (!overlaps(node.BoundsMin, node.BoundsMax))
+			continue;
+
+		if (node.Count == 0)
+		{
+			stack.push_back(node.First);
+			stack.push_back(node.First + 1);
+			continue;
+		}
+
+		for (uint32_t i = node.First; i < node.First + node.Count; i++)
+		{
+			XMFLOAT3 otherMin, otherMax;
+			GetItemBounds(items[i], otherMin, otherMax);
+			if (overlaps(otherMin, otherMax))
+				results.push_back(items[i]);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Walks nearer children first and skips anything farther
+// than the closest hit so far
+// --------------------------------------------------------
+bool BVH::Raycast(const XMFLOAT3& origin, const XMFLOAT3& direction, Item& hit, float& distance)
+{
+	if (nodes.empty())
+		return false;
+
+	XMFLOAT3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	float closest = FLT_MAX;
+
+	stack.clear();
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (RayBoxDistance(origin, inverseDirection, node.BoundsMin, node.BoundsMax) >= closest)
+			continue;
+
+		if (node.Count == 0)
+		{
+			const Node& left = nodes[node.First];
+			const Node& right = nodes[node.First + 1];
+			float leftDistance = RayBoxDistance(origin, inverseDirection, left.BoundsMin, left.BoundsMax);
+			float rightDistance = RayBoxDistance(origin, inverseDirection, right.BoundsMin, right.BoundsMax);
+
+			// Pushed last, popped first
+			uint32_t nearer = leftDistance <= rightDistance ? node.First : node.First + 1;
+			float farDistance = std::max(leftDistance, rightDistance);
+			if (farDistance < closest)
+				stack.push_back(nearer == node.First ? node.First + 1 : node.First);
+			if (std::min(leftDistance, rightDistance) < closest)
+				stack.push_back(nearer);
+			continue;
+		}
+
+		for (uint32_t i = node.First; i < node.First + node.Count; i++)
+		{
+			XMFLOAT3 boundsMin, boundsMax;
+			GetItemBounds(items[i], boundsMin, boundsMax);
+			float d = RayBoxDistance(origin, inverseDirection, boundsMin, boundsMax);
+			if (d < closest)
+			{
+				closest = d;
+				hit = items[i];
+			}
+		}
+	}
+
+	distance = closest;
+	return closest < FLT_MAX;
+}
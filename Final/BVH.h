@@ -0,0 +1,88 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// --------------------------------------------------------
+// Bounding volume hierarchy over world-space boxes, for
+// frustum, ray and overlap queries that don't have to look
+// at every item
+//
+// - Items are indices (e.g. into the entity list).  Give
+//   each its box with SetBounds(), then Build()
+// - Build() splits with the surface area heuristic over
+//   binned centroids, so it's meant for load time or after
+//   large changes
+// - When items move, SetBounds() again and Refit(), which
+//   only grows/shrinks the existing nodes around them
+// - Nodes are one flat array, children stored in pairs
+//   after their parent
+// --------------------------------------------------------
+class BVH
+{
+public:
+	typedef uint32_t Item;
+
+	// Most items a leaf holds before the build tries to split it
+	static constexpr uint32_t MaxLeafItems = 4;
+
+private:
+	// Internal nodes have Count == 0 and children First, First + 1.
+	// Leaves hold items[First .. First + Count)
+	struct Node
+	{
+		DirectX::XMFLOAT3 BoundsMin;
+		uint32_t First;
+		DirectX::XMFLOAT3 BoundsMax;
+		uint32_t Count;
+	};
+
+	// An item's box and centroid, packed together while building
+	struct BuildItem
+	{
+		DirectX::XMFLOAT3 BoundsMin;
+		DirectX::XMFLOAT3 BoundsMax;
+		DirectX::XMFLOAT3 Center;
+		Item Id;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<Item> items;
+	std::vector<DirectX::XMFLOAT3> itemCenter;
+	std::vector<DirectX::XMFLOAT3> itemExtents;
+	bool needsRefit;
+
+	// Reused by queries, so they don't allocate
+	std::vector<uint32_t> stack;
+
+	void GetItemBounds(Item item, DirectX::XMFLOAT3& boundsMin, DirectX::XMFLOAT3& boundsMax);
+	void FitNode(Node& node);
+	void Subdivide(uint32_t nodeIndex, std::vector<BuildItem>& buildItems);
+	void AddSubtree(uint32_t nodeIndex, std::vector<Item>& results);
+
+public:
+	BVH();
+
+	// Items are 0 .. itemCount - 1, all with empty bounds at first
+	void Resize(size_t itemCount);
+	void SetBounds(Item item, const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents);
+
+	void Build();
+	void Refit();
+
+	size_t GetItemCount() { return itemCenter.size(); }
+	size_t GetNodeCount() { return nodes.size(); }
+
+	// Queries add matching items to results (without clearing it first)
+	// - Frustum planes are (a, b, c, d), inside where ax + by + cz + d >= 0,
+	//   like FrustumCuller's
+	void QueryFrustum(const DirectX::XMFLOAT4* planes, std::vector<Item>& results);
+	void QueryOverlap(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax, std::vector<Item>& results);
+
+	// Finds the closest item box along a ray (any length direction)
+	// - Returns false on a miss, otherwise the item and the hit's
+	//   distance in units of direction
+	bool Raycast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, Item& hit, float& distance);
+};
@@ -1,5 +1,9 @@
 #include "Camera.h"
+
+// Input is Windows-only, so the input-driven Update() is too
+#if defined(_WIN32)
 #include "Input.h"
+#endif
 
 using namespace DirectX;
 
@@ -15,11 +19,11 @@ Camera::Camera(
 	float farClip,
 	bool isPerspective) :
 	aspectRatio(aspectRatio),
-	moveSpeed(moveSpeed),
-	mouseSensitivity(mouseSensitivity),
 	fov(fov),
 	nearClip(nearClip),
 	farClip(farClip),
+	moveSpeed(moveSpeed),
+	mouseSensitivity(mouseSensitivity),
 	isPerspective(isPerspective)
 {
 	transform.SetPosition(x, y, z);
@@ -56,6 +60,23 @@ void Camera::UpdateViewMatrix() {
 	XMStoreFloat4x4(&view, viewMat);
 }
 
+// --------------------------------------------------------
+// Un-projects the pixel at the near and far planes; the ray
+// starts at the near one and points (normalized) at the far
+// --------------------------------------------------------
+void Camera::GetPickRay(float screenX, float screenY, float screenWidth, float screenHeight, XMFLOAT3& origin, XMFLOAT3& direction) {
+	float x = screenX / screenWidth * 2.0f - 1.0f;
+	float y = 1.0f - screenY / screenHeight * 2.0f;
+
+	XMMATRIX invViewProj = XMMatrixInverse(0, XMLoadFloat4x4(&view) * XMLoadFloat4x4(&projection));
+	XMVECTOR nearPoint = XMVector3TransformCoord(XMVectorSet(x, y, 0, 1), invViewProj);
+	XMVECTOR farPoint = XMVector3TransformCoord(XMVectorSet(x, y, 1, 1), invViewProj);
+
+	XMStoreFloat3(&origin, nearPoint);
+	XMStoreFloat3(&direction, XMVector3Normalize(farPoint - nearPoint));
+}
+
+#if defined(_WIN32)
 void Camera::Update(float dt) {
 	float dist = dt * moveSpeed;
 
@@ -83,3 +104,4 @@ void Camera::Update(float dt) {
 
 	UpdateViewMatrix();
 }
+#endif
@@ -1,6 +1,6 @@
 #pragma once
 #include <DirectXMath.h>
-#include "transform.h"
+#include "Transform.h"
 
 class Camera
 {
@@ -16,6 +16,9 @@ public:
 	Transform* GetTransform();
 	void UpdateProjectionMatrix(float aspectRatio);
 	void UpdateViewMatrix();
-	void Update(float dt);
+
+	// World-space ray through a pixel, e.g. the mouse position, for picking
+	void GetPickRay(float screenX, float screenY, float screenWidth, float screenHeight, DirectX::XMFLOAT3& origin, DirectX::XMFLOAT3& direction);
+	void Update(float dt); // Input-driven, Windows only
 };
 
@@ -1,18 +1,13 @@
-#include "Lighting.hlsli"
+#include "ClusteredLighting.hlsli"
 #include "CelShadingFunctions.hlsli"
 
-#define LIGHT_COUNT 5
-
-// Input for color
-cbuffer ExternalData : register(b0)
+// Input for color, set when the material changes
+cbuffer PerMaterial : register(b1)
 {
 	float3 colorTint;
-	float3 cameraPosition;
+	float roughness; // Unused (the roughness map wins), but keeps the layout PixelShader's
 	float2 uvScale;
 	float2 uvOffset;
-	float3 ambient;
-	int lightCount;
-	Light lights[LIGHT_COUNT];
 }
 
 Texture2D Albedo			: register(t0);
@@ -49,8 +44,11 @@ output main(VertexToPixel input)
 
 	float3 finalColor = ambient * surfaceColor;
 
-	for (int i = 0; i < lightCount; i++) {
-		Light light = lights[i];
+	// Only the lights whose range reaches this pixel's cluster
+	LightCluster cluster = GetLightCluster(input.screenPosition);
+	uint clusterLightCount = GetClusterLightCount(cluster);
+	for (uint i = 0; i < clusterLightCount; i++) {
+		Light light = GetClusterLight(cluster, i);
 		light.Direction = normalize(light.Direction);
 
 		float3 toLight = float3(0.0f, 0.0f, 0.0f);
@@ -0,0 +1,55 @@
+#ifndef __GGP_CLUSTERED_LIGHTING__
+#define __GGP_CLUSTERED_LIGHTING__
+
+#include "Lighting.hlsli"
+
+// Where one cluster's lights are in LightIndices
+struct LightCluster
+{
+	uint Offset;
+	uint Count;
+};
+
+// Camera, lights and the cluster grid, set once per frame
+// - Tiles are clusterTileScale pixels^-1 across, and a depth's
+//   slice is log(depth) * clusterDepthScale + clusterDepthBias
+// - The first globalLightCount light indices (the directional
+//   lights) apply everywhere
+cbuffer PerFrame : register(b0)
+{
+	float3 cameraPosition;
+	float clusterDepthScale;
+	float3 ambient;
+	float clusterDepthBias;
+	float2 clusterTileScale;
+	uint globalLightCount;
+	uint3 clusterCounts;
+}
+
+// Built by LightClusters on the CPU every frame
+StructuredBuffer<Light> Lights					: register(t8);
+StructuredBuffer<LightCluster> LightClusters	: register(t9);
+StructuredBuffer<uint> LightIndices				: register(t10);
+
+// The cluster a pixel is in: its screen tile, then the slice
+// of the view depth that SV_POSITION.w carries
+LightCluster GetLightCluster(float4 screenPosition)
+{
+	uint2 tile = min((uint2)(screenPosition.xy * clusterTileScale), clusterCounts.xy - 1);
+	int slice = (int)floor(log(screenPosition.w) * clusterDepthScale + clusterDepthBias);
+	uint z = (uint)clamp(slice, 0, (int)clusterCounts.z - 1);
+	return LightClusters[tile.x + clusterCounts.x * (tile.y + clusterCounts.y * z)];
+}
+
+// How many lights reach a pixel in the cluster, and the i'th one
+uint GetClusterLightCount(LightCluster cluster)
+{
+	return globalLightCount + cluster.Count;
+}
+
+Light GetClusterLight(LightCluster cluster, uint i)
+{
+	return Lights[LightIndices[i < globalLightCount ? i : cluster.Offset + i - globalLightCount]];
+}
+
+#endif
@@ -413,6 +413,8 @@ HRESULT DXCore::Run()
 			Input::GetInstance().Update();
 
 			// The game loop
+			//  - Draw() may just hand the frame to a render thread,
+			//    so the next Update() runs while it's drawn
 			Update(deltaTime, totalTime);
 			Draw(deltaTime, totalTime);
 
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstring>
+
+// --------------------------------------------------------
+// Tracks which bytes of a CPU-side copy of a buffer have
+// changed since it was last uploaded
+//
+// - Write() only dirties the buffer when the bytes really
+//   differ, so setting a value to what it already holds
+//   (the same lights every frame, say) costs no upload
+// - The range covers every changed write; Clear() it once
+//   the buffer's been uploaded
+// --------------------------------------------------------
+struct DirtyRange
+{
+	unsigned int Start = 0;
+	unsigned int End = 0; // One past the last dirty byte; Start == End when clean
+
+	bool IsDirty() const { return End > Start; }
+	unsigned int GetSize() const { return End - Start; }
+	void Clear() { Start = End = 0; }
+
+	void Add(unsigned int offset, unsigned int size)
+	{
+		if (size == 0)
+			return;
+
+		if (!IsDirty())
+		{
+			Start = offset;
+			End = offset + size;
+			return;
+		}
+
+		Start = offset < Start ? offset : Start;
+		End = offset + size > End ? offset + size : End;
+	}
+
+	// Copies data into buffer at offset, marking it dirty if it changed
+	// - Returns whether it did
+	bool Write(unsigned char* buffer, unsigned int offset, const void* data, unsigned int size)
+	{
+		if (memcmp(buffer + offset, data, size) == 0)
+			return false;
+
+		memcpy(buffer + offset, data, size);
+		Add(offset, size);
+		return true;
+	}
+};
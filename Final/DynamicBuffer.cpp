@@ -0,0 +1,52 @@
+#include "DynamicBuffer.h"
+
+DynamicBuffer::DynamicBuffer(UINT bindFlags, size_t stride, UINT miscFlags) :
+	bindFlags(bindFlags),
+	miscFlags(miscFlags),
+	stride(stride),
+	capacity(0)
+{
+}
+
+bool DynamicBuffer::Reserve(Microsoft::WRL::ComPtr<ID3D11Device> device, size_t count)
+{
+	if (count <= capacity && buffer)
+		return true;
+
+	size_t newCapacity = 64;
+	while (newCapacity < count)
+		newCapacity *= 2;
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.ByteWidth = (UINT)(stride * newCapacity);
+	desc.BindFlags = bindFlags;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	desc.MiscFlags = miscFlags;
+	if (miscFlags & D3D11_RESOURCE_MISC_BUFFER_STRUCTURED)
+		desc.StructureByteStride = (UINT)stride;
+
+	buffer.Reset();
+	capacity = 0;
+	if (FAILED(device->CreateBuffer(&desc, 0, buffer.GetAddressOf())))
+		return false;
+	capacity = newCapacity;
+	return true;
+}
+
+void* DynamicBuffer::Map(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	if (!buffer)
+		return 0;
+
+	// Discarding hands back fresh memory instead of waiting on the GPU
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return 0;
+	return mapped.pData;
+}
+
+void DynamicBuffer::Unmap(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	context->Unmap(buffer.Get(), 0);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <cstddef>
+
+// --------------------------------------------------------
+// A dynamic buffer of fixed-stride elements, rewritten whole
+// every time it's mapped
+// - Grows (to the next power of two) when the data doesn't
+//   fit, and never shrinks
+// - Never empty once reserved, so there's always something
+//   to bind or view
+// - Structured buffers pass D3D11_RESOURCE_MISC_BUFFER_STRUCTURED
+//   as miscFlags; the stride is set for them
+// --------------------------------------------------------
+class DynamicBuffer
+{
+private:
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	UINT bindFlags;
+	UINT miscFlags;
+	size_t stride;
+	size_t capacity;
+
+public:
+	DynamicBuffer(UINT bindFlags, size_t stride, UINT miscFlags = 0);
+
+	// Makes room for count elements; false if the buffer couldn't be made.
+	// Growing replaces the buffer, so views of it have to be remade
+	bool Reserve(Microsoft::WRL::ComPtr<ID3D11Device> device, size_t count);
+
+	// The whole buffer, with its old contents discarded, or null if it couldn't be mapped
+	void* Map(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	void Unmap(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	ID3D11Buffer* Get() { return buffer.Get(); }
+	ID3D11Buffer* const* GetAddressOf() { return buffer.GetAddressOf(); }
+	size_t GetCapacity() { return capacity; }
+	size_t GetStride() { return stride; }
+};
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "SpscQueue.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+// --------------------------------------------------------
+// Double-buffered hand-over of frame snapshots from the
+// update thread to the render thread, so the next frame's
+// update runs while the last one is drawn
+//
+// Update thread, each frame:
+//  - BeginUpdate() for a snapshot to fill
+//  - EndUpdate() once it's filled, publishing it
+// Render thread, until BeginRender() returns null:
+//  - BeginRender() for the next published snapshot
+//  - EndRender() once it's drawn, handing it back
+//
+// - There are two snapshots: while one is drawn the other
+//   is filled, so update runs at most a frame ahead, and
+//   waits in BeginUpdate() if drawing falls behind
+// - Published and returned snapshots travel through two
+//   lock-free queues; a side with nothing to take yields
+//   for a moment, then sleeps until the other side hands
+//   something over, so an idle pipeline (a minimized or
+//   modal-looping window) doesn't hold a core
+// - Handing over only takes the lock when the other side
+//   is asleep
+// - A published snapshot belongs to the render thread
+//   until it's returned; neither side touches a snapshot
+//   the other holds
+// - Close() makes BeginRender() return null once every
+//   published snapshot has been drawn; Open() again after
+//   the render thread has finished
+// --------------------------------------------------------
+template<typename Snapshot>
+class FramePipeline
+{
+private:
+	Snapshot snapshots[2];
+	SpscQueue<Snapshot*, 2> published;
+	SpscQueue<Snapshot*, 2> returned;
+	std::atomic<bool> closed;
+
+	// Sleeping waiters, and how a side wakes the other
+	std::mutex sleepLock;
+	std::condition_variable wake;
+	std::atomic<size_t> sleepers;
+
+	// How often each side found nothing to take and had to wait,
+	// and how many of those waits ran long enough to sleep
+	std::atomic<size_t> updateStalls;
+	std::atomic<size_t> renderStalls;
+	std::atomic<size_t> sleeps;
+
+	// Yields before sleeping, enough to catch a quick hand-over
+	static constexpr int SpinCount = 64;
+
+	template<typename Ready>
+	void Wait(Ready ready)
+	{
+		for (int spin = 0; spin < SpinCount; spin++)
+		{
+			if (ready())
+				return;
+			std::this_thread::yield();
+		}
+
+		// Registered before the last check, so a hand-over after it
+		// sees the sleeper (the fences pair with the one in Wake())
+		std::unique_lock<std::mutex> lock(sleepLock);
+		sleepers.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!ready())
+		{
+			sleeps.fetch_add(1, std::memory_order_relaxed);
+			wake.wait(lock, ready);
+		}
+		sleepers.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	void Wake()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleepers.load(std::memory_order_relaxed) == 0)
+			return;
+
+		// Taking the lock means the sleeper is waiting, not between its check and wait()
+		{ std::lock_guard<std::mutex> lock(sleepLock); }
+		wake.notify_all();
+	}
+
+public:
+	FramePipeline() :
+		closed(false),
+		sleepers(0),
+		updateStalls(0),
+		renderStalls(0),
+		sleeps(0)
+	{
+		for (Snapshot& snapshot : snapshots)
+			returned.TryPush(&snapshot);
+	}
+
+	FramePipeline(FramePipeline const&) = delete;
+	void operator=(FramePipeline const&) = delete;
+
+	Snapshot* BeginUpdate()
+	{
+		Snapshot* snapshot;
+		if (returned.TryPop(snapshot))
+			return snapshot;
+
+		updateStalls.fetch_add(1, std::memory_order_relaxed);
+		Wait([&]() { return returned.TryPop(snapshot); });
+		return snapshot;
+	}
+
+	void EndUpdate(Snapshot* snapshot)
+	{
+		published.TryPush(snapshot);
+		Wake();
+	}
+
+	Snapshot* BeginRender()
+	{
+		Snapshot* snapshot;
+		if (published.TryPop(snapshot))
+			return snapshot;
+
+		renderStalls.fetch_add(1, std::memory_order_relaxed);
+		bool popped = false;
+		Wait([&]() {
+			popped = published.TryPop(snapshot);
+			return popped || closed.load(std::memory_order_acquire);
+		});
+		if (popped)
+			return snapshot;
+
+		// Something may have been published just before closing
+		return published.TryPop(snapshot) ? snapshot : nullptr;
+	}
+
+	void EndRender(Snapshot* snapshot)
+	{
+		returned.TryPush(snapshot);
+		Wake();
+	}
+
+	void Close()
+	{
+		closed.store(true, std::memory_order_release);
+		Wake();
+	}
+	void Open() { closed.store(false, std::memory_order_release); }
+
+	size_t GetUpdateStalls() const { return updateStalls.load(); }
+	size_t GetRenderStalls() const { return renderStalls.load(); }
+	size_t GetSleeps() const { return sleeps.load(); }
+};
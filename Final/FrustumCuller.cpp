@@ -0,0 +1,157 @@
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// Fewer boxes aren't worth a job
+	const size_t MinBoxesPerJob = 1024;
+}
+
+FrustumCuller::FrustumCuller() :
+	planes(),
+	count(0),
+	visibleCount(0)
+{
+}
+
+// --------------------------------------------------------
+// Pulls the six frustum planes out of view * projection
+// (Gribb & Hartmann), using D3D's 0 <= z <= w clip range
+// --------------------------------------------------------
+void FrustumCuller::Begin(const XMFLOAT4X4& view, const XMFLOAT4X4& projection)
+{
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMLoadFloat4x4(&view) * XMLoadFloat4x4(&projection));
+
+	// Columns of the combined matrix
+	XMVECTOR column[4];
+	for (int c = 0; c < 4; c++)
+		column[c] = XMVectorSet(viewProj.m[0][c], viewProj.m[1][c], viewProj.m[2][c], viewProj.m[3][c]);
+
+	XMStoreFloat4(&planes[0], XMPlaneNormalize(column[3] + column[0])); // Left
+	XMStoreFloat4(&planes[1], XMPlaneNormalize(column[3] - column[0])); // Right
+	XMStoreFloat4(&planes[2], XMPlaneNormalize(column[3] + column[1])); // Bottom
+	XMStoreFloat4(&planes[3], XMPlaneNormalize(column[3] - column[1])); // Top
+	XMStoreFloat4(&planes[4], XMPlaneNormalize(column[2]));             // Near
+	XMStoreFloat4(&planes[5], XMPlaneNormalize(column[3] - column[2])); // Far
+
+	// Storage is kept, so steady-state frames don't allocate
+	count = 0;
+	visibleCount = 0;
+}
+
+// --------------------------------------------------------
+// The world box has to hold the rotated box, so each of its
+// extents sums the local extents through the absolute
+// values of the world matrix
+// --------------------------------------------------------
+void TransformBounds(const XMFLOAT3& localCenter, const XMFLOAT3& localExtents, const XMFLOAT4X4& world, XMFLOAT3& center, XMFLOAT3& extents)
+{
+	XMMATRIX worldMat = XMLoadFloat4x4(&world);
+	XMStoreFloat3(&center, XMVector3TransformCoord(XMLoadFloat3(&localCenter), worldMat));
+	XMStoreFloat3(&extents,
+		XMVectorAbs(worldMat.r[0]) * XMVectorReplicate(localExtents.x) +
+		XMVectorAbs(worldMat.r[1]) * XMVectorReplicate(localExtents.y) +
+		XMVectorAbs(worldMat.r[2]) * XMVectorReplicate(localExtents.z));
+}
+
+// Moves a local box into world space and queues it
+size_t FrustumCuller::Add(const XMFLOAT3& localCenter, const XMFLOAT3& localExtents, const XMFLOAT4X4& world)
+{
+	// Grows a batch at a time, so Cull() never runs off the end
+	if (count + 4 > centerX.size())
+	{
+		for (auto* component : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ })
+			component->resize(count + 4, 0.0f);
+		visible.resize(count + 4);
+	}
+
+	XMFLOAT3 c, e;
+	TransformBounds(localCenter, localExtents, world, c, e);
+	centerX[count] = c.x;
+	centerY[count] = c.y;
+	centerZ[count] = c.z;
+	extentX[count] = e.x;
+	extentY[count] = e.y;
+	extentZ[count] = e.z;
+	return count++;
+}
+
+// --------------------------------------------------------
+// Tests every queued box, four per SIMD batch
+// - A box is out if it's entirely behind any one plane:
+//   distance(center) + projected radius < 0
+// --------------------------------------------------------
+void FrustumCuller::Cull(JobSystem* jobs)
+{
+	// The last batch may include leftover boxes past count, which are ignored
+	size_t padded = (count + 3) & ~(size_t)3;
+
+	XMVECTOR a[6], b[6], c[6], d[6], absA[6], absB[6], absC[6];
+	for (int p = 0; p < 6; p++)
+	{
+		a[p] = XMVectorReplicate(planes[p].x);
+		b[p] = XMVectorReplicate(planes[p].y);
+		c[p] = XMVectorReplicate(planes[p].z);
+		d[p] = XMVectorReplicate(planes[p].w);
+		absA[p] = XMVectorAbs(a[p]);
+		absB[p] = XMVectorAbs(b[p]);
+		absC[p] = XMVectorAbs(c[p]);
+	}
+
+	XMVECTOR zero = XMVectorZero();
+	auto cullBatches = [&](size_t firstBatch, size_t endBatch) {
+		for (size_t i = firstBatch * 4; i < endBatch * 4; i += 4)
+		{
+			XMVECTOR cx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&centerX[i]));
+			XMVECTOR cy = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&centerY[i]));
+			XMVECTOR cz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&centerZ[i]));
+			XMVECTOR ex = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&extentX[i]));
+			XMVECTOR ey = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&extentY[i]));
+			XMVECTOR ez = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&extentZ[i]));
+
+			XMVECTOR outside = XMVectorFalseInt();
+			for (int p = 0; p < 6; p++)
+			{
+				XMVECTOR distance = a[p] * cx + b[p] * cy + c[p] * cz + d[p];
+				XMVECTOR radius = absA[p] * ex + absB[p] * ey + absC[p] * ez;
+				outside = XMVectorOrInt(outside, XMVectorLess(distance + radius, zero));
+			}
+
+			uint32_t masks[4];
+			XMStoreInt4(masks, outside);
+			for (int j = 0; j < 4; j++)
+				visible[i + j] = masks[j] == 0;
+		}
+	};
+	if (jobs)
+		jobs->ParallelFor(padded / 4, MinBoxesPerJob / 4, cullBatches);
+	else
+		cullBatches(0, padded / 4);
+
+	visibleCount = 0;
+	for (size_t i = 0; i < count; i++)
+		visibleCount += visible[i];
+}
+
+bool FrustumCuller::IsBoxVisible(const XMFLOAT3& center, const XMFLOAT3& extents)
+{
+	for (int p = 0; p < 6; p++)
+	{
+		const XMFLOAT4& plane = planes[p];
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float radius = fabsf(plane.x) * extents.x + fabsf(plane.y) * extents.y + fabsf(plane.z) * extents.z;
+		if (distance + radius < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+void FrustumCuller::GetWorldBox(size_t i, XMFLOAT3& center, XMFLOAT3& extents)
+{
+	center = XMFLOAT3(centerX[i], centerY[i], centerZ[i]);
+	extents = XMFLOAT3(extentX[i], extentY[i], extentZ[i]);
+}
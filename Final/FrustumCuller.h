@@ -0,0 +1,57 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// Moves a local bounding box into world space, as the
+// smallest box around the transformed one
+void TransformBounds(const DirectX::XMFLOAT3& localCenter, const DirectX::XMFLOAT3& localExtents, const DirectX::XMFLOAT4X4& world, DirectX::XMFLOAT3& center, DirectX::XMFLOAT3& extents);
+
+// --------------------------------------------------------
+// Culls world-space bounding boxes against a camera frustum
+//
+// Each frame:
+//  - Begin() with the camera's view and projection
+//  - Add() every object's local bounds and world matrix,
+//    in draw order
+//  - Cull(), then check IsVisible() by the same order;
+//    given jobs, Cull() splits the boxes across threads
+//
+// Boxes are stored as arrays per component, so Cull()
+// tests four at a time against all six planes
+// --------------------------------------------------------
+class FrustumCuller
+{
+private:
+	// Planes as (a, b, c, d), inside where ax + by + cz + d >= 0
+	DirectX::XMFLOAT4 planes[6];
+
+	size_t count;
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	std::vector<uint8_t> visible;
+	size_t visibleCount;
+
+public:
+	FrustumCuller();
+
+	void Begin(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection);
+	size_t Add(const DirectX::XMFLOAT3& localCenter, const DirectX::XMFLOAT3& localExtents, const DirectX::XMFLOAT4X4& world);
+	void Cull(JobSystem* jobs = 0);
+
+	// Valid after Begin()
+	const DirectX::XMFLOAT4* GetPlanes() { return planes; }
+
+	bool IsVisible(size_t i) { return visible[i] != 0; }
+	size_t GetCount() { return count; }
+	size_t GetVisibleCount() { return visibleCount; }
+	size_t GetCulledCount() { return count - visibleCount; }
+
+	// Tests a single box the slow way, for checking Cull()
+	bool IsBoxVisible(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents);
+	void GetWorldBox(size_t i, DirectX::XMFLOAT3& center, DirectX::XMFLOAT3& extents);
+};
@@ -3,18 +3,27 @@
 #include "Input.h"
 #include "Helpers.h"
 #include "Material.h"
-#include "WICTextureLoader.h"
+#include "AssetLoader.h"
+#include "TextureDecoder.h"
+#include "WorldViewProjection.h"
 
 // Needed for a helper function to load pre-compiled shader files
 #pragma comment(lib, "d3dcompiler.lib")
 #include <d3dcompiler.h>
 #include <iostream>
-
-#define PI 3.14159265359
+#include <map>
+#include <random>
 
 // For the DirectX Math library
 using namespace DirectX;
 
+namespace
+{
+	// Smaller batches draw one at a time through PerObject, since an
+	// instance buffer upload costs more than it saves on a draw or two
+	const size_t MinInstancedBatch = 4;
+}
+
 // --------------------------------------------------------
 // Constructor
 //
@@ -31,7 +40,16 @@ Game::Game(HINSTANCE hInstance)
 		720,				// Height of the window's client area
 		false,				// Sync the framerate to the monitor refresh? (lock framerate)
 		true),				// Show extra stats (fps) in title bar?
-	ambient(0.5f, 0.5f, 0.5f)
+	ambient(0.5f, 0.5f, 0.5f),
+	lightBuffer(sizeof(Light)),
+	lightClusterBuffer(sizeof(LightCluster)),
+	lightIndexBuffer(sizeof(uint32_t)),
+	frameNumber(0),
+	textures(DecodeImageMemory, [this](const DecodedImage& image) {
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+		CreateTextureFromImage(device, context, image, srv.GetAddressOf());
+		return srv;
+	})
 {
 #if defined(DEBUG) || defined(_DEBUG)
 	// Do we want a console window?  Probably only in debug mode
@@ -54,6 +72,9 @@ Game::~Game()
 	// Call Release() on any Direct3D objects made within this class
 	// - Note: this is unnecessary for D3D objects stored in ComPtrs
 
+	// Anything still queued is drawn before the context goes away
+	StopRenderThread();
+
 	ImGui_ImplDX11_Shutdown();
 	ImGui_ImplWin32_Shutdown();
 	ImGui::DestroyContext();
@@ -76,6 +97,14 @@ void Game::Init()
 	
 	// Set up the pause toggle
 	isPaused = false;
+	useScatteredLights = false;
+
+	// Build the entity BVH around where everything starts
+	pickedEntity = -1;
+	entityBounds.Resize(entities.size());
+	scene.UpdateMatrices();
+	UpdateEntityBounds();
+	entityBounds.Build();
 
 	// ImGui stuff
 	// Initialize ImGui itself & platform/renderer backends
@@ -95,6 +124,11 @@ void Game::Init()
 		// Essentially: "What kind of shape should the GPU draw with our vertices?"
 		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	}
+
+	// Entities don't change after this, so snapshots copy their nodes in this order
+	for (auto& e : entities)
+		entityNodes.push_back(e->GetNode());
+	StartRenderThread();
 	// unsigned int size = sizeof(VertexShaderExternalData);
 	// size = (size + 15) / 16 * 16;
 }
@@ -114,6 +148,8 @@ void Game::LoadShaders()
 		FixPath(L"VertexShader.cso").c_str());
 	triangleVertexShader = std::make_shared<SimpleVertexShader>(device, context,
 		FixPath(L"TriangleVS.cso").c_str());
+	instancedVertexShader = std::make_shared<SimpleVertexShader>(device, context,
+		FixPath(L"InstancedVS.cso").c_str());
 	pixelShader = std::make_shared<SimplePixelShader>(device, context,
 		FixPath(L"PixelShader.cso").c_str());
 	celPixelShader = std::make_shared<SimplePixelShader>(device, context,
@@ -146,19 +182,64 @@ void Game::CreateGeometry()
 	sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
 	device->CreateSamplerState(&sampDesc, clamp.GetAddressOf());
 
+	// Every file is read and decoded on the loader's worker threads.
+	// This thread only creates GPU resources, waiting on each asset
+	// as it's needed, so the lights and sky are set up meanwhile.
+	// Textures go through the cache, so each is only decoded once.
+	AssetLoader loader;
+	auto loadTexture = [&](const wchar_t* file) {
+		std::wstring path = FixPath(file);
+		textures.Prefetch(path, loader);
+		return path;
+	};
+	auto uploadTexture = [&](const std::wstring& path) {
+		return textures.Get(path);
+	};
+	auto uploadMesh = [&](std::future<std::shared_ptr<MeshCache>>& pending) {
+		std::shared_ptr<MeshCache> cache = pending.get();
+		if (!cache)
+			cache = std::make_shared<MeshCache>();
+		return std::make_shared<Mesh>(*cache, device);
+	};
+
+	// Queued roughly in the order they're needed below
+	auto cubeFile = loader.LoadMesh(FixPath(L"../../Assets/cube.obj"));
+	auto sphereFile = loader.LoadMesh(FixPath(L"../../Assets/sphere.obj"));
+	auto cylinderFile = loader.LoadMesh(FixPath(L"../../Assets/cylinder.obj"));
+	auto helixFile = loader.LoadMesh(FixPath(L"../../Assets/helix.obj"));
+	auto torusFile = loader.LoadMesh(FixPath(L"../../Assets/torus.obj"));
+	auto quadFile = loader.LoadMesh(FixPath(L"../../Assets/quad.obj"));
+	auto quad2sidedFile = loader.LoadMesh(FixPath(L"../../Assets/quad_double_sided.obj"));
+
+	auto planet1Albedo = loadTexture(L"../../Assets/Textures/planets/planet-texture-1.png");
+	auto planet1Normals = loadTexture(L"../../Assets/Textures/planets/planet-texture-1-normal.png");
+	auto planet1Roughness = loadTexture(L"../../Assets/Textures/planets/planet-texture-1-roughness.png");
+	auto planet2Albedo = loadTexture(L"../../Assets/Textures/planets/planet-texture-2.png");
+	auto planet2Normals = loadTexture(L"../../Assets/Textures/planets/planet-texture-2-normal.png");
+	auto planet2Roughness = loadTexture(L"../../Assets/Textures/planets/planet-texture-2-roughness.png");
+	auto planet3Albedo = loadTexture(L"../../Assets/Textures/planets/planet-texture-3.png");
+	auto planet3Normals = loadTexture(L"../../Assets/Textures/planets/planet-texture-3-normal.png");
+	auto planet3Roughness = loadTexture(L"../../Assets/Textures/planets/planet-texture-3-roughness.png");
+	auto planet4Albedo = loadTexture(L"../../Assets/Textures/planets/planet-texture-4.png");
+	auto planet4Normals = loadTexture(L"../../Assets/Textures/planets/planet-texture-4-normal.png");
+	auto planet4Roughness = loadTexture(L"../../Assets/Textures/planets/planet-texture-4-roughness.png");
+	auto sunAlbedo = loadTexture(L"../../Assets/Textures/planets/sun-texture.png");
+	auto sunNormals = loadTexture(L"../../Assets/Textures/flat_normals.png");
+	auto sunRoughness = loadTexture(L"../../Assets/Textures/planets/sun-texture-roughness.png");
+	auto ramp = loadTexture(L"../../Assets/Textures/ramps/ramptexture3.png");
+	auto rampSpec = loadTexture(L"../../Assets/Textures/ramps/specramptexture.png");
+
 	// Importing primitives from Assets
-	std::shared_ptr<Mesh> cubeMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/cube.obj").c_str(), device);
-	std::shared_ptr<Mesh> cylinderMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/cylinder.obj").c_str(), device);
-	std::shared_ptr<Mesh> helixMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/helix.obj").c_str(), device);
-	std::shared_ptr<Mesh> sphereMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/sphere.obj").c_str(), device);
-	std::shared_ptr<Mesh> torusMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/torus.obj").c_str(), device);
-	std::shared_ptr<Mesh> quadMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/quad.obj").c_str(), device);
-	std::shared_ptr<Mesh> quad2sidedMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/quad_double_sided.obj").c_str(), device);
+	std::shared_ptr<Mesh> cubeMesh = uploadMesh(cubeFile);
+	std::shared_ptr<Mesh> sphereMesh = uploadMesh(sphereFile);
+	std::shared_ptr<Mesh> cylinderMesh = uploadMesh(cylinderFile);
+	std::shared_ptr<Mesh> helixMesh = uploadMesh(helixFile);
+	std::shared_ptr<Mesh> torusMesh = uploadMesh(torusFile);
+	std::shared_ptr<Mesh> quadMesh = uploadMesh(quadFile);
+	std::shared_ptr<Mesh> quad2sidedMesh = uploadMesh(quad2sidedFile);
 
 	// Creating our lights
 	{
-		lightCount = 5;
-
 		Light light1 = {};
 		light1.Type = LIGHT_TYPE_DIRECTIONAL;
 		light1.Direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
@@ -195,6 +276,24 @@ void Game::CreateGeometry()
 		light5.Color = XMFLOAT3(1.0f, 0.5f, 0.8f);
 		light5.Intensity = 1.0f;
 		lights.push_back(light5);
+
+		// Plenty of small point lights around the scene, which the light
+		// clusters keep to a few per pixel; off until toggled in the stats window
+		const int scatteredLightCount = 1000;
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> spread(-60.0f, 60.0f);
+		std::uniform_real_distribution<float> heights(-5.0f, 15.0f);
+		std::uniform_real_distribution<float> ranges(3.0f, 8.0f);
+		std::uniform_real_distribution<float> colors(0.2f, 1.0f);
+		for (int i = 0; i < scatteredLightCount; i++) {
+			Light light = {};
+			light.Type = LIGHT_TYPE_POINT;
+			light.Position = XMFLOAT3(spread(random), heights(random), spread(random));
+			light.Range = ranges(random);
+			light.Color = XMFLOAT3(colors(random), colors(random), colors(random));
+			light.Intensity = 1.0f;
+			scatteredLights.push_back(light);
+		}
 	}
 
 	// Sky Texturing
@@ -222,46 +321,29 @@ void Game::CreateGeometry()
 	// Texture Stuff
 	{
 		// Loading Textures
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet1AlbedoSRV;
-		CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/planets/planet-texture-1.png").c_str(), 0, planet1AlbedoSRV.GetAddressOf());
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet1NormalsSRV;
-		CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/planets/planet-texture-1-normal.png").c_str(), 0, planet1NormalsSRV.GetAddressOf());
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet1RoughnessSRV;
-		CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/planets/planet-texture-1-roughness.png").c_str(), 0, planet1RoughnessSRV.GetAddressOf());
-
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet2AlbedoSRV;
-		CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/planets/planet-texture-2.png").c_str(), 0, planet2AlbedoSRV.GetAddressOf());
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet2NormalsSRV;
-		CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/planets/planet-texture-2-normal.png").c_str(), 0, planet2NormalsSRV.GetAddressOf());
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet2RoughnessSRV;
-		CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/planets/planet-texture-2-roughness.png").c_str(), 0, planet2RoughnessSRV.GetAddressOf());
-
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet3AlbedoSRV;
-		CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/planets/planet-texture-3.png").c_str(), 0, planet3AlbedoSRV.GetAddressOf());
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet3NormalsSRV;
-		CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/planets/planet-texture-3-normal.png").c_str(), 0, planet3NormalsSRV.GetAddressOf());
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet3RoughnessSRV;
-		CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/planets/planet-texture-3-roughness.png").c_str(), 0, planet3RoughnessSRV.GetAddressOf());
-
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet4AlbedoSRV;
-		CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/planets/planet-texture-4.png").c_str(), 0, planet4AlbedoSRV.GetAddressOf());
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet4NormalsSRV;
-		CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/planets/planet-texture-4-normal.png").c_str(), 0, planet4NormalsSRV.GetAddressOf());
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet4RoughnessSRV;
-		CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/planets/planet-texture-4-roughness.png").c_str(), 0, planet4RoughnessSRV.GetAddressOf());
-
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> sunAlbedoSRV;
-		CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/planets/sun-texture.png").c_str(), 0, sunAlbedoSRV.GetAddressOf());
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> sunNormalsSRV;
-		CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/flat_normals.png").c_str(), 0, sunNormalsSRV.GetAddressOf());
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> sunRoughnessSRV;
-		CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/planets/sun-texture-roughness.png").c_str(), 0, sunRoughnessSRV.GetAddressOf());
-
-
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> rampSRV;
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> rampSpecSRV;
-		CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/ramps/ramptexture3.png").c_str(), 0, rampSRV.GetAddressOf());
-		CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/ramps/specramptexture.png").c_str(), 0, rampSpecSRV.GetAddressOf());
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet1AlbedoSRV = uploadTexture(planet1Albedo);
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet1NormalsSRV = uploadTexture(planet1Normals);
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet1RoughnessSRV = uploadTexture(planet1Roughness);
+
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet2AlbedoSRV = uploadTexture(planet2Albedo);
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet2NormalsSRV = uploadTexture(planet2Normals);
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet2RoughnessSRV = uploadTexture(planet2Roughness);
+
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet3AlbedoSRV = uploadTexture(planet3Albedo);
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet3NormalsSRV = uploadTexture(planet3Normals);
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet3RoughnessSRV = uploadTexture(planet3Roughness);
+
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet4AlbedoSRV = uploadTexture(planet4Albedo);
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet4NormalsSRV = uploadTexture(planet4Normals);
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> planet4RoughnessSRV = uploadTexture(planet4Roughness);
+
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> sunAlbedoSRV = uploadTexture(sunAlbedo);
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> sunNormalsSRV = uploadTexture(sunNormals);
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> sunRoughnessSRV = uploadTexture(sunRoughness);
+
+
+		rampSRV = uploadTexture(ramp);
+		rampSpecSRV = uploadTexture(rampSpec);
 
 		
 
@@ -304,22 +386,44 @@ void Game::CreateGeometry()
 		matSun->AddTextureSRV("NormalMap", sunNormalsSRV);
 		matSun->AddTextureSRV("RoughnessMap", sunRoughnessSRV);
 
+		// Enough visible entities sharing one of these and a mesh are drawn as
+		// one instanced batch.  The cel ramps go in with each material's own
+		// textures, so they're all bound together
+		for (auto& material : { matPlanet1, matPlanet2, matPlanet3, matPlanet4, matSun }) {
+			material->AddTextureSRV("CelRamp", rampSRV);
+			material->AddTextureSRV("CelRampSpec", rampSpecSRV);
+			if (instancedVertexShader->GetPerInstanceCompatible())
+				material->SetInstancedVertexShader(instancedVertexShader);
+		}
 
-		// Creating a set of entities
-		entities.push_back(std::make_shared<GameEntity>(sphereMesh, matSun));
-		entities.push_back(std::make_shared<GameEntity>(sphereMesh, matPlanet1));
-		entities.push_back(std::make_shared<GameEntity>(sphereMesh, matPlanet2));
-		entities.push_back(std::make_shared<GameEntity>(sphereMesh, matPlanet3));
-		entities.push_back(std::make_shared<GameEntity>(sphereMesh, matPlanet4));
-
-		entities[0]->GetTransform()->Scale(10, 10, 10);
-		entities[1]->GetTransform()->Scale(1.2f, 1.2f, 1.2f);
-		entities[1]->GetTransform()->MoveAbsolute(15, 0, 0);
-		entities[2]->GetTransform()->Scale(5, 5, 5);
-		entities[2]->GetTransform()->MoveAbsolute(20, 0, 0);
-		entities[3]->GetTransform()->MoveAbsolute(30, 0, 0);
-		entities[4]->GetTransform()->Scale(3, 3, 3);
-		entities[4]->GetTransform()->MoveAbsolute(50, 0, 0);
+
+		// Creating the solar system hierarchy.  The sun and the planets'
+		// orbits hang off an unscaled root, so the sun's size doesn't
+		// scale the orbits, and each orbit's anchor carries its planet
+		// around.  Each planet's size is on its own node, under the anchor.
+		TransformStore::Handle solarSystem = scene.Create();
+		TransformStore::Handle planet1Orbit = orbits.AddOrbit(scene, solarSystem, 15.0f, 20.0f);
+		TransformStore::Handle planet2Orbit = orbits.AddOrbit(scene, solarSystem, 40.0f, 40.0f);
+		TransformStore::Handle planet3Orbit = orbits.AddOrbit(scene, solarSystem, 60.0f, 60.0f);
+		TransformStore::Handle planet4Orbit = orbits.AddOrbit(scene, solarSystem, 75.0f, 80.0f);
+
+		entities.push_back(std::make_shared<GameEntity>(sphereMesh, matSun, &scene, solarSystem));
+		entities.push_back(std::make_shared<GameEntity>(sphereMesh, matPlanet1, &scene, planet1Orbit));
+		entities.push_back(std::make_shared<GameEntity>(sphereMesh, matPlanet2, &scene, planet2Orbit));
+		entities.push_back(std::make_shared<GameEntity>(sphereMesh, matPlanet3, &scene, planet3Orbit));
+		entities.push_back(std::make_shared<GameEntity>(sphereMesh, matPlanet4, &scene, planet4Orbit));
+
+		scene.Scale(entities[0]->GetNode(), 10, 10, 10);
+		scene.Scale(entities[1]->GetNode(), 1.2f, 1.2f, 1.2f);
+		scene.Scale(entities[2]->GetNode(), 5, 5, 5);
+		scene.Scale(entities[4]->GetNode(), 3, 3, 3);
+
+		// Entities sharing a material and mesh could share an instanced batch
+		std::map<std::pair<Material*, Mesh*>, uint32_t> groups;
+		for (size_t i = 0; i < entities.size(); i++) {
+			auto group = groups.insert({ { entities[i]->GetMaterial().get(), entities[i]->GetMesh().get() }, (uint32_t)i });
+			batchGroups.push_back(group.first->second);
+		}
 	}
 }
 
@@ -331,6 +435,11 @@ void Game::CreateGeometry()
 // --------------------------------------------------------
 void Game::OnResize()
 {
+	// The render thread is using the buffers about to be replaced, so it
+	// finishes the frames already handed over and starts again after
+	bool rendering = renderThread.joinable();
+	StopRenderThread();
+
 	// Handle base-level DX resize stuff
 	DXCore::OnResize();
 
@@ -338,6 +447,9 @@ void Game::OnResize()
 	if (camera) camera->UpdateProjectionMatrix((float)windowWidth / windowHeight);
 
 	CalcPostProcessing();
+
+	if (rendering)
+		StartRenderThread();
 }
 
 // Adjust necessary post-processing resources when the window resizes and on startup
@@ -387,6 +499,65 @@ void Game::CalcPostProcessing() {
 	device->CreateShaderResourceView(depthsTexture.Get(), 0, depthSRV.GetAddressOf());
 }
 
+// --------------------------------------------------------
+// Uploads each entity shader's PerFrame buffer (camera and
+// lights), so draws only upload what changes between them
+// - Also restarts the shaders' upload counts for the frame
+// --------------------------------------------------------
+void Game::SetFrameData(GameSnapshot& frame)
+{
+	// The vertex shaders' camera matrices are folded into each object's
+	// world-view-projection, so only the pixel shaders have a PerFrame
+	// (see ShaderConstants.h)
+	for (auto& vs : { vertexShader, instancedVertexShader })
+		vs->ResetUploadStats();
+
+	// Lights are binned into the camera's clusters, and the pixel shaders
+	// read them, the clusters and their light lists from structured buffers
+	lightClusters.Build(frame.View, frame.Projection, frame.Lights.data(), frame.Lights.size());
+	lightBuffer.Upload(device, context, frame.Lights.data(), frame.Lights.size());
+	lightClusterBuffer.Upload(device, context, lightClusters.GetClusters(), LightClusters::ClusterCount);
+	lightIndexBuffer.Upload(device, context, lightClusters.GetLightIndices(), lightClusters.GetLightIndexCount());
+
+	ClusteredLightingPerFrame pixelFrame = {};
+	pixelFrame.cameraPosition = frame.CameraPosition;
+	pixelFrame.ambient = frame.Ambient;
+	pixelFrame.clusterDepthScale = lightClusters.GetDepthScale();
+	pixelFrame.clusterDepthBias = lightClusters.GetDepthBias();
+	pixelFrame.clusterTileScale = XMFLOAT2((float)LightClusters::TilesX / frame.WindowWidth, (float)LightClusters::TilesY / frame.WindowHeight);
+	pixelFrame.globalLightCount = lightClusters.GetGlobalLightCount();
+	pixelFrame.clusterCounts = XMUINT3(LightClusters::TilesX, LightClusters::TilesY, LightClusters::Slices);
+	for (auto& ps : { pixelShader, celPixelShader }) {
+		ps->ResetUploadStats();
+		SimpleShaderHandle perFrame = ps->GetBufferHandle(ClusteredLightingPerFrame::BufferName);
+		ps->SetBufferData(perFrame, pixelFrame);
+		ps->CopyBufferData(perFrame);
+	}
+
+	// Both pixel shaders read these from the same registers, so setting
+	// them through one sets them for the other
+	pixelShader->SetShaderResourceView("Lights", lightBuffer.GetSRV());
+	pixelShader->SetShaderResourceView("LightClusters", lightClusterBuffer.GetSRV());
+	pixelShader->SetShaderResourceView("LightIndices", lightIndexBuffer.GetSRV());
+
+	const SimpleConstantBuffer* perObject = vertexShader->GetBufferInfo("PerObject");
+	frame.Stats.ObjectBytes = perObject ? perObject->Size : 0;
+}
+
+// --------------------------------------------------------
+// Moves each entity's mesh bounds to where the entity is now
+// - The BVH still needs a Build() or Refit() afterwards
+// --------------------------------------------------------
+void Game::UpdateEntityBounds()
+{
+	for (size_t i = 0; i < entities.size(); i++) {
+		XMFLOAT3 center, extents;
+		TransformBounds(entities[i]->GetMesh()->GetBoundsCenter(), entities[i]->GetMesh()->GetBoundsExtents(),
+			scene.GetWorldMatrix(entities[i]->GetNode()), center, extents);
+		entityBounds.SetBounds((BVH::Item)i, center, extents);
+	}
+}
+
 // --------------------------------------------------------
 // Update your game here - user input, move objects, AI, etc.
 // --------------------------------------------------------
@@ -397,23 +568,18 @@ void Game::Update(float deltaTime, float totalTime)
 		Quit();
 
 	// Handle planetary motion
-	if (!isPaused) {
-		if (angle >= 360.0f) angle = 0.0f;
-		for (int i = 1; i < entities.size(); i++) {
-			entities[1]->GetTransform()->Rotate(0, -0.001f, 0);
-			float radius = 0.0f;
-			if (i == 1) radius = 15.0f;
-			else if (i == 2) radius = 40.0f;
-			else if (i == 3) radius = 60.0f;
-			else if (i == 4) radius = 75.0f;
-			XMFLOAT3 offset = XMFLOAT3(sin((angle * i) * (PI / 180)) * radius, 0.0f, cos((angle * i) * (PI / 180)) * radius);
-			// std::cout << offset.x << " " << offset.y << " " << offset.z << endl;
-			std::cout << sin(angle * (PI / 180)) << endl;
-			entities[i]->GetTransform()->SetPosition(offset.x, offset.y, offset.z);
-		}
-		angle += 20.0f * deltaTime;
+	if (!isPaused)
+	{
+		orbits.Update(scene, deltaTime);
+		scene.Rotate(entities[1]->GetNode(), 0, -0.24f * deltaTime, 0);
 	}
 
+	// Flush every moved transform (and its children) in one pass,
+	// so drawing only reads cached matrices
+	scene.UpdateMatrices(&jobs);
+	UpdateEntityBounds();
+	entityBounds.Refit();
+
 	camera->Update(deltaTime);
 
 	// ImGui
@@ -446,6 +612,15 @@ void Game::Update(float deltaTime, float totalTime)
 		// Determine new input capture (youll uncomment later)
 		input.SetKeyboardCapture(io.WantCaptureKeyboard);
 		input.SetMouseCapture(io.WantCaptureMouse);
+
+		// Right click picks whatever entity is under the mouse
+		if (input.MouseRightPress()) {
+			XMFLOAT3 origin, direction;
+			camera->GetPickRay((float)input.GetMouseX(), (float)input.GetMouseY(), (float)windowWidth, (float)windowHeight, origin, direction);
+			BVH::Item hit;
+			float distance;
+			pickedEntity = entityBounds.Raycast(origin, direction, hit, distance) ? (int)hit : -1;
+		}
 		// Show the demo window
 		// ImGui::ShowDemoWindow();
 
@@ -453,19 +628,118 @@ void Game::Update(float deltaTime, float totalTime)
 		ImGui::Text("fps: %f", io.Framerate);
 		ImGui::Text("Window Width: %f", io.DisplaySize.x);
 		ImGui::Text("Window Height: %f", io.DisplaySize.y);
+		ImGui::Text("Entities drawn: %zu", lastStats.Drawn);
+		ImGui::Text("Entities culled: %zu", lastStats.Culled);
+		ImGui::Text("Picked entity (right click): %d", pickedEntity);
+		ImGui::Checkbox("Scattered point lights", &useScatteredLights);
+		ImGui::Text("Lights: %zu (%zu clustered light indices)",
+			lights.size() + (useScatteredLights ? scatteredLights.size() : 0), lastStats.LightIndices);
+		const RenderQueue::Stats& drawStats = lastStats.Draws;
+		ImGui::Text("Batches: %zu for %zu entities (%zu instanced)", drawStats.Batches, drawStats.Draws, lastStats.InstancedDraws);
+		ImGui::Text("Shader binds: %zu (%zu skipped)", drawStats.ShaderBinds, drawStats.ShaderBindsSkipped);
+		ImGui::Text("Material binds: %zu (%zu skipped)", drawStats.MaterialBinds, drawStats.MaterialBindsSkipped);
+		ImGui::Text("Mesh binds: %zu (%zu skipped)", drawStats.MeshBinds, drawStats.MeshBindsSkipped);
+		const SimpleShaderUploadStats& uploadStats = lastStats.Uploads;
+		ImGui::Text("Constant uploads: %zu (%zu unchanged, skipped)", uploadStats.Uploads, uploadStats.UploadsSkipped);
+		ImGui::Text("Constant data: %zu bytes uploaded, %zu changed (%zu per non-instanced object)", uploadStats.BytesUploaded, uploadStats.BytesChanged, lastStats.ObjectBytes);
+		const TextureCache::Stats& textureStats = textures.GetStats();
+		ImGui::Text("Textures: %zu loaded, %zu hits, %zu shared by content, %zu failed",
+			textureStats.Misses, textureStats.Hits, textureStats.ContentHits, textureStats.Failures);
 		ImGui::End();
 		ImGui::Begin("Orbit Controller");
-		XMFLOAT3 pos = entities[0]->GetTransform()->GetPosition();
+		XMFLOAT3 pos = scene.GetPosition(entities[0]->GetNode());
 		ImGui::Checkbox("Toggle Orbit", &isPaused);
 		ImGui::End();
 	}
 }
 
+GameSnapshot::~GameSnapshot()
+{
+	for (ImDrawList* list : GuiLists)
+		IM_DELETE(list);
+}
+
+// Replaces the snapshot's ImGui output with a copy of drawData's
+void GameSnapshot::CaptureGui(const ImDrawData* drawData)
+{
+	for (ImDrawList* list : GuiLists)
+		IM_DELETE(list);
+	GuiLists.clear();
+
+	Gui = *drawData;
+	for (int i = 0; i < drawData->CmdListsCount; i++)
+		GuiLists.push_back(drawData->CmdLists[i]->CloneOutput());
+	Gui.CmdLists = GuiLists.data();
+}
+
 // --------------------------------------------------------
-// Clear the screen, redraw everything, present to the user
-// 
+// Copies everything drawing needs into a snapshot and hands
+// it to the render thread, which draws it while the next
+// Update() runs
+// - Waits for a free snapshot if the render thread is still
+//   drawing the one before last
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
+{
+	GameSnapshot* frame = pipeline.BeginUpdate();
+
+	// The render thread wrote these when it last drew this snapshot
+	lastStats = frame->Stats;
+
+	frame->Frame = frameNumber++;
+	frame->DeltaTime = deltaTime;
+	frame->TotalTime = totalTime;
+	frame->View = camera->GetView();
+	frame->Projection = camera->GetProjection();
+	frame->CameraPosition = camera->GetTransform()->GetPosition();
+	frame->WindowWidth = windowWidth;
+	frame->WindowHeight = windowHeight;
+	CaptureTransforms(scene, entityNodes.data(), entityNodes.size(), *frame);
+	frame->Materials.resize(entities.size());
+	for (size_t i = 0; i < entities.size(); i++)
+		frame->Materials[i] = entities[i]->GetMaterial()->GetMaterialData();
+	frame->Ambient = ambient;
+	frame->Lights = lights;
+	if (useScatteredLights)
+		frame->Lights.insert(frame->Lights.end(), scatteredLights.begin(), scatteredLights.end());
+
+	ImGui::Render();
+	frame->CaptureGui(ImGui::GetDrawData());
+
+	pipeline.EndUpdate(frame);
+}
+
+void Game::StartRenderThread()
+{
+	pipeline.Open();
+	renderThread = std::thread(&Game::RenderLoop, this);
+}
+
+// Draws whatever's been handed over, then stops the render thread
+void Game::StopRenderThread()
+{
+	if (!renderThread.joinable())
+		return;
+
+	pipeline.Close();
+	renderThread.join();
+}
+
+void Game::RenderLoop()
+{
+	while (GameSnapshot* frame = pipeline.BeginRender()) {
+		Render(*frame);
+		pipeline.EndRender(frame);
+	}
+}
+
+// --------------------------------------------------------
+// Clear the screen, redraw everything, present to the user
+// - Runs on the render thread, reading only the snapshot
+//   and what changes only while the render thread is
+//   stopped (Init() and OnResize())
+// --------------------------------------------------------
+void Game::Render(GameSnapshot& frame)
 {
 	PreProcess();
 	/*
@@ -474,34 +748,125 @@ void Game::Draw(float deltaTime, float totalTime)
 		1, // How many are we activating? Can do multiple at once
 		vsConstantBuffer.GetAddressOf());
 	*/
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> rampSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> rampSpecSRV;
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/ramps/ramptexture3.png").c_str(), 0, rampSRV.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/ramps/specramptexture.png").c_str(), 0, rampSpecSRV.GetAddressOf());
-
-	// Draw loop
-	for (auto& e : entities) {
-		// Setting material properties that need to be updated with data from Game
-		e->GetMaterial()->GetPixelShader()->SetFloat("time", totalTime);
-		e->GetMaterial()->GetPixelShader()->SetFloat3("ambient", ambient);
-		e->GetMaterial()->GetPixelShader()->SetInt("lightCount", lightCount);
-		e->GetMaterial()->GetPixelShader()->SetData(
-			"lights", // The name of the (eventual) variable in the shader
-			&lights[0], // The address of the data to set
-			sizeof(Light) * (int)lights.size()); // The size of the data (the whole struct!) to set
-		e->GetMaterial()->GetPixelShader()->SetShaderResourceView("CelRamp", rampSRV);
-		e->GetMaterial()->GetPixelShader()->SetShaderResourceView("CelRampSpec", rampSpecSRV);
-		e->Draw(context, camera);
+	SetFrameData(frame);
+
+	// Cull against the camera before touching any shader state
+	culler.Begin(frame.View, frame.Projection);
+	for (size_t i = 0; i < entities.size(); i++) {
+		culler.Add(entities[i]->GetMesh()->GetBoundsCenter(), entities[i]->GetMesh()->GetBoundsExtents(), frame.Worlds[i]);
+	}
+	culler.Cull(&jobs);
+
+	// Only batch groups with enough visible entities are instanced
+	batchGroupCounts.assign(entities.size(), 0);
+	for (size_t i = 0; i < entities.size(); i++) {
+		if (culler.IsVisible(i))
+			batchGroupCounts[batchGroups[i]]++;
+	}
+
+	// Queue what's left, sorted by shader, material, mesh and depth
+	XMMATRIX viewMat = XMLoadFloat4x4(&frame.View);
+	renderQueue.Clear();
+	visibleEntities.clear();
+	visibleSlots.resize(entities.size());
+	drawInstanced.resize(entities.size());
+	for (size_t i = 0; i < entities.size(); i++) {
+		if (!culler.IsVisible(i))
+			continue;
+
+		auto& e = entities[i];
+		visibleSlots[i] = (uint32_t)visibleEntities.size();
+		visibleEntities.push_back((uint32_t)i);
+
+		const XMFLOAT4X4& world = frame.Worlds[i];
+		float depth = XMVectorGetZ(XMVector3TransformCoord(XMVectorSet(world._41, world._42, world._43, 1.0f), viewMat));
+		auto instancedVS = e->GetMaterial()->GetInstancedVertexShader();
+		drawInstanced[i] = instancedVS && batchGroupCounts[batchGroups[i]] >= MinInstancedBatch;
+		renderQueue.Add((uint32_t)i,
+			drawInstanced[i] ? instancedVS.get() : e->GetMaterial()->GetVertexShader().get(),
+			e->GetMaterial()->GetPixelShader().get(),
+			e->GetMaterial().get(),
+			e->GetMesh().get(),
+			depth);
+	}
+	renderQueue.Sort();
+
+	// Every visible entity's world-view-projection in one pass, instead of
+	// each vertex multiplying world, view and projection
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(viewMat, XMLoadFloat4x4(&frame.Projection)));
+	worldViewProjections.resize(visibleEntities.size());
+	jobs.ParallelFor(visibleEntities.size(), 1024, [&](size_t begin, size_t end) {
+		ComputeWorldViewProjections(viewProjection, frame.Worlds.data(), visibleEntities.data() + begin, end - begin, worldViewProjections.data() + begin);
+	});
+
+	// Draw loop - each bind only happens when the sorted draws change it,
+	// and big enough runs of the same mesh and material become one
+	// instanced draw.  Their vertex shader keeps them apart in the queue
+	size_t instancedDraws = 0;
+	renderQueue.SubmitBatches(
+		[&](uint32_t i) {
+			auto material = entities[i]->GetMaterial();
+			if (drawInstanced[i])
+				material->SetInstancedShaders();
+			else
+				material->SetShaders();
+		},
+		[&](uint32_t i) { entities[i]->GetMaterial()->SetMaterialData(frame.Materials[i]); },
+		[&](uint32_t i) { entities[i]->GetMesh()->SetBuffers(context); },
+		[&](const uint32_t* indices, size_t count) {
+			auto material = entities[indices[0]]->GetMaterial();
+			auto mesh = entities[indices[0]]->GetMesh();
+
+			if (!drawInstanced[indices[0]]) {
+				for (size_t n = 0; n < count; n++) {
+					uint32_t i = indices[n];
+					material->SetObjectData(worldViewProjections[visibleSlots[i]], frame.Worlds[i], frame.WorldInvTransposes[i]);
+					mesh->DrawIndexed(context);
+				}
+				return;
+			}
+
+			InstanceData* instances = instanceBuffer.Map(device, context, count);
+			if (!instances)
+				return;
+			for (size_t n = 0; n < count; n++) {
+				uint32_t i = indices[n];
+				instances[n].World = frame.Worlds[i];
+				instances[n].WorldInvTranspose = frame.WorldInvTransposes[i];
+				instances[n].WorldViewProjection = worldViewProjections[visibleSlots[i]];
+			}
+			instanceBuffer.Unmap(context);
+			instanceBuffer.Bind(context);
+			mesh->DrawIndexedInstanced(context, (unsigned int)count);
+			instancedDraws += count;
+		});
+
+	// Reported back to the update side through the snapshot
+	FrameStats& stats = frame.Stats;
+	stats.Drawn = culler.GetVisibleCount();
+	stats.Culled = culler.GetCulledCount();
+	stats.LightIndices = lightClusters.GetLightIndexCount();
+	stats.Draws = renderQueue.GetStats();
+	stats.InstancedDraws = instancedDraws;
+	stats.Uploads = SimpleShaderUploadStats();
+	ISimpleShader* entityShaders[] = { vertexShader.get(), instancedVertexShader.get(), pixelShader.get(), celPixelShader.get() };
+	for (ISimpleShader* shader : entityShaders) {
+		const SimpleShaderUploadStats& shaderStats = shader->GetUploadStats();
+		stats.Uploads.Uploads += shaderStats.Uploads;
+		stats.Uploads.UploadsSkipped += shaderStats.UploadsSkipped;
+		stats.Uploads.BytesUploaded += shaderStats.BytesUploaded;
+		stats.Uploads.BytesChanged += shaderStats.BytesChanged;
 	}
 
-	sky->Draw(camera);
+	sky->Draw(frame.View, frame.Projection);
 
-	PostProcess();
+	PostProcess(frame);
 	// ImGui
 	{
-		// Draw ImGui
-		ImGui::Render();
-		ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+		// Draw ImGui, as it was built by the update side
+		if (frame.Gui.Valid)
+			ImGui_ImplDX11_RenderDrawData(&frame.Gui);
 	}
 
 
@@ -549,7 +914,7 @@ void Game::PreProcess() {
 }
 
 // Handle anything that gets applied right after draw code
-void Game::PostProcess() {
+void Game::PostProcess(const GameSnapshot& frame) {
 	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), 0);
 	triangleVertexShader->SetShader();
 
@@ -558,8 +923,8 @@ void Game::PostProcess() {
 	depthNormalPixelShader->SetShaderResourceView("Depth", depthSRV.Get());
 	depthNormalPixelShader->SetSamplerState("Sampler", clamp.Get());
 	depthNormalPixelShader->SetShader();
-	depthNormalPixelShader->SetFloat("width", 1.0f / windowWidth);
-	depthNormalPixelShader->SetFloat("height", 1.0f / windowHeight);
+	depthNormalPixelShader->SetFloat("width", 1.0f / frame.WindowWidth);
+	depthNormalPixelShader->SetFloat("height", 1.0f / frame.WindowHeight);
 	depthNormalPixelShader->SetFloat("normal", 5.0f);
 	depthNormalPixelShader->SetFloat("depth", 5.0f);
 	depthNormalPixelShader->CopyAllBufferData();
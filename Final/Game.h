@@ -7,16 +7,64 @@
 #include "Camera.h"
 #include "Light.h"
 #include "Sky.h"
+#include "OrbitSystem.h"
+#include "FrustumCuller.h"
+#include "BVH.h"
+#include "RenderQueue.h"
+#include "InstanceBuffer.h"
+#include "JobSystem.h"
+#include "FramePipeline.h"
+#include "RenderSnapshot.h"
+#include "LightClusters.h"
+#include "StructuredBuffer.h"
+#include "TextureDecoder.h"
 #include "ImGui/imgui.h"
 #include "ImGui/imgui_impl_dx11.h"
 #include "ImGui/imgui_impl_win32.h"
 #include <DirectXMath.h>
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 #include <memory>
+#include <thread>
 #include <vector>
 
 using namespace std;
 
+// What the render thread reports back about a frame it drew
+struct FrameStats
+{
+	size_t Drawn = 0;
+	size_t Culled = 0;
+	size_t LightIndices = 0;
+	RenderQueue::Stats Draws = {};
+	size_t InstancedDraws = 0;
+	SimpleShaderUploadStats Uploads = {}; // Constant buffer uploads by the frame's draws
+	size_t ObjectBytes = 0;               // The size of each object's constants
+};
+
+// --------------------------------------------------------
+// A frame as Game hands it to its render thread: the scene
+// snapshot plus the frame's ImGui output, and the stats the
+// render thread writes back as it draws
+// --------------------------------------------------------
+struct GameSnapshot : RenderSnapshot
+{
+	// ImGui reuses its draw lists each frame, so these are clones
+	ImDrawData Gui;
+	std::vector<ImDrawList*> GuiLists;
+
+	// The window size the frame was made for; WM_SIZE changes the
+	// window's own on the main thread while this frame may be drawn
+	unsigned int WindowWidth = 0;
+	unsigned int WindowHeight = 0;
+
+	FrameStats Stats;
+
+	GameSnapshot() : Gui() {}
+	~GameSnapshot();
+
+	void CaptureGui(const ImDrawData* drawData);
+};
+
 class Game 
 	: public DXCore
 {
@@ -30,6 +78,9 @@ public:
 	void Init();
 	void OnResize();
 	void Update(float deltaTime, float totalTime);
+
+	// Only hands the frame over; the render thread draws it while
+	// the next Update() runs
 	void Draw(float deltaTime, float totalTime);
 
 private:
@@ -39,7 +90,15 @@ private:
 	void CreateGeometry();
 	void CalcPostProcessing();
 	void PreProcess();
-	void PostProcess();
+	void PostProcess(const GameSnapshot& frame);
+	void UpdateEntityBounds();
+
+	// Render thread
+	void StartRenderThread();
+	void StopRenderThread();
+	void RenderLoop();
+	void Render(GameSnapshot& frame);
+	void SetFrameData(GameSnapshot& frame);
 
 	// Note the usage of ComPtr below
 	//  - This is a smart pointer for objects that abide by the
@@ -57,6 +116,7 @@ private:
 
 	shared_ptr<SimpleVertexShader> vertexShader;
 	shared_ptr<SimpleVertexShader> triangleVertexShader;
+	shared_ptr<SimpleVertexShader> instancedVertexShader;
 
 	std::shared_ptr<Camera> camera;
 
@@ -65,12 +125,71 @@ private:
 	DirectX::XMFLOAT3 ambient;
 
 	std::vector<Light> lights;
-	int lightCount;
-	float angle;
 	bool isPaused;
 
+	// Optional small point lights all over the scene, to see the light
+	// clusters under load; added to lights only while the toggle is on
+	std::vector<Light> scatteredLights;
+	bool useScatteredLights;
+
+	// Frames handed from Draw() to the render thread.  Once it's started,
+	// only it uses the context, light clusters and buffers, culler, render
+	// queue and instance buffer; the rest belongs to the update side
+	FramePipeline<GameSnapshot> pipeline;
+	std::thread renderThread;
+	uint64_t frameNumber;
+	std::vector<TransformStore::Handle> entityNodes;
+
+	// The stats of the last frame drawn, for the stats window
+	FrameStats lastStats;
+
+	// Lights binned by where they reach, so each pixel only loops over
+	// the ones nearby; rebuilt and uploaded every frame
+	LightClusters lightClusters;
+	StructuredBuffer lightBuffer;
+	StructuredBuffer lightClusterBuffer;
+	StructuredBuffer lightIndexBuffer;
+
+	// Splits the transform flush, culling and draw preparation across threads
+	JobSystem jobs;
+
+	// Every entity's transform is a node in here
+	TransformStore scene;
+	OrbitSystem orbits;
+
+	// Skips entities outside the camera's view
+	FrustumCuller culler;
+
+	// World bounds of every entity, for picking; -1 when nothing is picked
+	BVH entityBounds;
+	int pickedEntity;
+
+	// Orders each frame's draws to skip redundant state changes
+	RenderQueue renderQueue;
+
+	// The visible entities and their world-view-projections, computed in
+	// one batch per frame; visibleSlots maps an entity to its place here
+	std::vector<uint32_t> visibleEntities;
+	std::vector<uint32_t> visibleSlots;
+	std::vector<DirectX::XMFLOAT4X4> worldViewProjections;
+
+	// Entities sharing a material and mesh share a batch group, named by
+	// the group's first entity.  Groups with at least MinInstancedBatch
+	// visible entities are drawn instanced this frame, the rest one by one
+	std::vector<uint32_t> batchGroups;
+	std::vector<uint32_t> batchGroupCounts;
+	std::vector<uint8_t> drawInstanced;
+
+	// World matrices for instanced batches, refilled per batch
+	InstanceBuffer instanceBuffer;
+
 	std::shared_ptr<Sky> sky;
 
+	// Every texture loaded, by file; the cel ramps are shared by all cel materials
+	TextureCache textures;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> rampSRV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> rampSpecSRV;
+
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> clamp;
 
@@ -1,14 +1,19 @@
 #include "GameEntity.h"
 
 // ctors account for varying color inputs
-GameEntity::GameEntity(std::shared_ptr<Mesh> mesh, shared_ptr<Material> material) : mesh(mesh), material(material) {}
+GameEntity::GameEntity(std::shared_ptr<Mesh> mesh, shared_ptr<Material> material, TransformStore* scene, TransformStore::Handle parent) :
+	scene(scene),
+	node(scene->Create(parent)),
+	mesh(mesh),
+	material(material)
+{}
 
 // getters
 shared_ptr<Mesh> GameEntity::GetMesh() {
 	return mesh;
 }
-Transform* GameEntity::GetTransform() {
-	return &transform;
+TransformStore::Handle GameEntity::GetNode() {
+	return node;
 }
 shared_ptr<Material> GameEntity::GetMaterial() {
 	return material;
@@ -21,9 +26,3 @@ void GameEntity::SetMesh(std::shared_ptr<Mesh> mesh) {
 void GameEntity::SetMaterial(std::shared_ptr<Material> material) { 
 	this->material = material; 
 }
-
-// Draw handles buffers locally to free up space in Game
-void GameEntity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera) {
-	material->SetUpShaders(&transform, camera);
-	mesh->Draw(context);
-}
\ No newline at end of file
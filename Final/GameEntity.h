@@ -2,7 +2,7 @@
 #include <memory>
 #include <DirectXMath.h>
 #include <wrl/client.h>
-#include "Transform.h"
+#include "TransformStore.h"
 #include "Mesh.h"
 #include "DXCore.h"
 #include "Camera.h"
@@ -13,16 +13,18 @@ using namespace std;
 class GameEntity
 {
 private:
-	Transform transform;
+	// The entity's node in the scene hierarchy
+	TransformStore* scene;
+	TransformStore::Handle node;
+
 	shared_ptr<Mesh> mesh;
 	shared_ptr<Material> material;
 public:
-	GameEntity(std::shared_ptr<Mesh> mesh, shared_ptr<Material> material);
+	GameEntity(std::shared_ptr<Mesh> mesh, shared_ptr<Material> material, TransformStore* scene, TransformStore::Handle parent = TransformStore::NoParent);
 	std::shared_ptr<Mesh> GetMesh();
-	Transform* GetTransform();
+	TransformStore::Handle GetNode();
 	shared_ptr<Material> GetMaterial();
 	void SetMaterial(shared_ptr<Material> material);
 	void SetMesh(shared_ptr<Mesh> mesh);
-	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera);
 };
 
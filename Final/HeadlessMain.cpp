@@ -0,0 +1,2576 @@
+#include "Camera.h"
+#include "FrustumCuller.h"
+#include "BVH.h"
+#include "RenderQueue.h"
+#include "InstanceData.h"
+#include "Light.h"
+#include "LightClusters.h"
+#include "Transform.h"
+#include "OrbitSystem.h"
+#include "TransformStore.h"
+#include "MeshData.h"
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "ObjParser.h"
+#include "AssetLoader.h"
+#include "AssetCache.h"
+#include "DirtyRange.h"
+#include "ShaderReflection.h"
+#include "ShaderConstants.h"
+#include "WorldViewProjection.h"
+#include "JobSystem.h"
+#include "FramePipeline.h"
+#include "RenderSnapshot.h"
+#include "Helpers.h"
+#include <DirectXMath.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Headless entry point for running the engine's CPU-side
+// hot paths without a window or a D3D device
+//
+// Usage:
+//  Headless [--frames N]
+//  Headless [--threads N] --obj file.obj [--obj ...]
+//  Headless --cached --obj file.obj [--obj ...]
+//  Headless [--threads N] --async --obj file.obj [--obj ...]
+//  Headless --obj-scaling file.obj
+//  Headless [--threads N] --tangents file.obj
+//  Headless --transforms N [--transforms ...]
+//  Headless --transform-micro N
+//  Headless --hierarchy N [--deep]
+//  Headless --culling N
+//  Headless --bvh N
+//  Headless --render-queue N
+//  Headless --instancing N
+//  Headless --texture-cache
+//  Headless --constant-uploads N
+//  Headless --shader-reflection
+//  Headless --shader-constants
+//  Headless --wvp N
+//  Headless --light-clusters N
+//  Headless [--threads N] --jobs N
+//  Headless --pipeline N
+// --------------------------------------------------------
+
+// Seconds elapsed since the given time point
+static double SecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Loads each .obj file and reports vertex/index counts and timing
+static int RunMeshLoads(const std::vector<std::string>& objFiles, unsigned int threadCount)
+{
+	for (auto& file : objFiles)
+	{
+		MeshData meshData;
+		auto start = std::chrono::high_resolution_clock::now();
+		if (!LoadOBJ(NarrowToWide(file), meshData, threadCount))
+		{
+			printf("Failed to load %s\n", file.c_str());
+			return 1;
+		}
+		double parseTime = SecondsSince(start);
+
+		MappedFile mapped;
+		mapped.Open(NarrowToWide(file));
+		double megabytes = mapped.GetSize() / (1024.0 * 1024.0);
+
+		start = std::chrono::high_resolution_clock::now();
+		CalculateTangents(meshData.Vertices.data(), (int)meshData.Vertices.size(), meshData.Indices.data(), (int)meshData.Indices.size());
+		double tangentTime = SecondsSince(start);
+
+		printf("%s: %zu verts, %zu indices, parse %.3f ms (%.1f MB/s), tangents %.3f ms\n",
+			file.c_str(), meshData.Vertices.size(), meshData.Indices.size(),
+			parseTime * 1000.0, megabytes / parseTime, tangentTime * 1000.0);
+	}
+	return 0;
+}
+
+// --------------------------------------------------------
+// Loads each .obj through its binary cache, the same way
+// Mesh does, and reports whether the cache had to be built
+// - Sums every vertex so the mapped pages are really read,
+//   like a buffer upload would
+// --------------------------------------------------------
+static int RunCachedMeshLoads(const std::vector<std::string>& objFiles)
+{
+	for (auto& file : objFiles)
+	{
+		MeshCache cache;
+		auto start = std::chrono::high_resolution_clock::now();
+		if (!cache.Load(NarrowToWide(file)))
+		{
+			printf("Failed to load %s\n", file.c_str());
+			return 1;
+		}
+		double loadTime = SecondsSince(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		float checksum = 0.0f;
+		const Vertex* verts = cache.GetVertices();
+		for (unsigned int i = 0; i < cache.GetVertexCount(); i++)
+			checksum += verts[i].Position.x + verts[i].Tangent.x;
+		double readTime = SecondsSince(start);
+
+		printf("%s: %u verts, %u indices, %s in %.3f ms, read in %.3f ms, checksum %f\n",
+			file.c_str(), cache.GetVertexCount(), cache.GetIndexCount(),
+			cache.WasRebuilt() ? "built cache" : "mapped cache",
+			loadTime * 1000.0, readTime * 1000.0, checksum);
+	}
+	return 0;
+}
+
+// --------------------------------------------------------
+// Compares rebuilding N transforms' matrices as individual
+// heap-allocated Transforms against a TransformStore, with
+// everything dirty, every 10th dirty and nothing dirty
+// --------------------------------------------------------
+static float MaxDifference(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+{
+	float difference = 0.0f;
+	for (int r = 0; r < 4; r++)
+		for (int c = 0; c < 4; c++)
+			difference = std::max(difference, std::fabs(a.m[r][c] - b.m[r][c]));
+	return difference;
+}
+
+static int RunTransformBenchmark(size_t transformCount)
+{
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> positions(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> angles(-XM_PI, XM_PI);
+	std::uniform_real_distribution<float> scales(0.5f, 4.0f);
+
+	std::vector<std::shared_ptr<Transform>> objects;
+	TransformStore store;
+	store.Reserve(transformCount);
+	for (size_t i = 0; i < transformCount; i++)
+	{
+		float p[3] = { positions(random), positions(random), positions(random) };
+		float r[3] = { angles(random), angles(random), angles(random) };
+		float s[3] = { scales(random), scales(random), scales(random) };
+
+		std::shared_ptr<Transform> t = std::make_shared<Transform>();
+		t->SetPosition(p[0], p[1], p[2]);
+		t->SetRotation(r[0], r[1], r[2]);
+		t->SetScale(s[0], s[1], s[2]);
+		objects.push_back(t);
+
+		TransformStore::Handle h = store.Create();
+		store.SetPosition(h, p[0], p[1], p[2]);
+		store.SetRotation(h, r[0], r[1], r[2]);
+		store.SetScale(h, s[0], s[1], s[2]);
+	}
+
+	// Enough repeats that small counts still take measurable time
+	int repeats = (int)std::max<size_t>(1, 2000000 / transformCount);
+	float checksum = 0.0f;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < repeats; i++)
+	{
+		for (auto& t : objects)
+		{
+			t->Rotate(0, 0, 0);
+			XMFLOAT4X4 world = t->GetWorldMatrix();
+			XMFLOAT4X4 worldInvTranspose = t->GetWorldInverseTransposeMatrix();
+			checksum += world._41 + worldInvTranspose._11;
+		}
+	}
+	double objectTime = SecondsSince(start) / repeats;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < repeats; i++)
+	{
+		for (size_t h = 0; h < transformCount; h++)
+			store.Rotate((TransformStore::Handle)h, 0, 0, 0);
+		store.UpdateMatrices();
+	}
+	double allDirtyTime = SecondsSince(start) / repeats;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < repeats; i++)
+	{
+		for (size_t h = 0; h < transformCount; h += 10)
+			store.Rotate((TransformStore::Handle)h, 0, 0, 0);
+		store.UpdateMatrices();
+	}
+	double tenthDirtyTime = SecondsSince(start) / repeats;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < repeats; i++)
+		store.UpdateMatrices();
+	double cleanTime = SecondsSince(start) / repeats;
+
+	float maxDifference = 0.0f;
+	for (size_t h = 0; h < transformCount; h++)
+	{
+		maxDifference = std::max(maxDifference, MaxDifference(objects[h]->GetWorldMatrix(), store.GetWorldMatrix((TransformStore::Handle)h)));
+		maxDifference = std::max(maxDifference, MaxDifference(objects[h]->GetWorldInverseTransposeMatrix(), store.GetWorldInverseTransposeMatrix((TransformStore::Handle)h)));
+	}
+
+	printf("%zu transforms (checksum %f):\n", transformCount, checksum);
+	printf("  Transform objects:   %10.3f ms\n", objectTime * 1000.0);
+	printf("  store, all dirty:    %10.3f ms (%.2fx)\n", allDirtyTime * 1000.0, objectTime / allDirtyTime);
+	printf("  store, every 10th:   %10.3f ms\n", tenthDirtyTime * 1000.0);
+	printf("  store, none dirty:   %10.3f ms\n", cleanTime * 1000.0);
+	printf("  max difference %g\n", maxDifference);
+
+	// Scales up to 4 and translations up to 100 leave some float noise
+	if (maxDifference > 1e-3f)
+	{
+		printf("TransformStore doesn't match Transform\n");
+		return 1;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------
+// Times a Transform's matrix rebuild three ways over N
+// transforms: the old products plus general XMMatrixInverse,
+// the TRS-derived rebuild, and getters on clean transforms
+// --------------------------------------------------------
+static int RunTransformMicroBenchmark(size_t transformCount)
+{
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> positions(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> angles(-XM_PI, XM_PI);
+	std::uniform_real_distribution<float> scales(0.5f, 4.0f);
+
+	std::vector<Transform> transforms(transformCount);
+	for (auto& t : transforms)
+	{
+		t.SetPosition(positions(random), positions(random), positions(random));
+		t.SetRotation(angles(random), angles(random), angles(random));
+		t.SetScale(scales(random), scales(random), scales(random));
+	}
+
+	int repeats = (int)std::max<size_t>(1, 2000000 / transformCount);
+	std::vector<XMFLOAT4X4> worlds(transformCount);
+	std::vector<XMFLOAT4X4> inverseTransposes(transformCount);
+
+	// What UpdateMatrices() used to do
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < repeats; i++)
+	{
+		for (size_t j = 0; j < transformCount; j++)
+		{
+			XMFLOAT3 position = transforms[j].GetPosition();
+			XMFLOAT3 rotation = transforms[j].GetPitchYawRoll();
+			XMFLOAT3 scale = transforms[j].GetScale();
+
+			XMMATRIX world =
+				XMMatrixScaling(scale.x, scale.y, scale.z) *
+				XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z) *
+				XMMatrixTranslation(position.x, position.y, position.z);
+			XMStoreFloat4x4(&worlds[j], world);
+			XMStoreFloat4x4(&inverseTransposes[j], XMMatrixInverse(0, XMMatrixTranspose(world)));
+		}
+	}
+	double generalTime = SecondsSince(start) / repeats;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < repeats; i++)
+	{
+		for (auto& t : transforms)
+		{
+			t.Rotate(0, 0, 0);
+			t.UpdateMatrices();
+		}
+	}
+	double trsTime = SecondsSince(start) / repeats;
+
+	float checksum = 0.0f;
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < repeats; i++)
+	{
+		for (auto& t : transforms)
+		{
+			XMFLOAT4X4 world = t.GetWorldMatrix();
+			XMFLOAT4X4 worldInvTranspose = t.GetWorldInverseTransposeMatrix();
+			checksum += world._41 + worldInvTranspose._11;
+		}
+	}
+	double cleanTime = SecondsSince(start) / repeats;
+
+	float maxDifference = 0.0f;
+	for (size_t j = 0; j < transformCount; j++)
+	{
+		maxDifference = std::max(maxDifference, MaxDifference(transforms[j].GetWorldMatrix(), worlds[j]));
+		maxDifference = std::max(maxDifference, MaxDifference(transforms[j].GetWorldInverseTransposeMatrix(), inverseTransposes[j]));
+	}
+
+	printf("%zu transforms (checksum %f):\n", transformCount, checksum);
+	printf("  products + XMMatrixInverse: %8.3f ns/transform\n", generalTime * 1e9 / transformCount);
+	printf("  from TRS parts:             %8.3f ns/transform (%.2fx)\n", trsTime * 1e9 / transformCount, generalTime / trsTime);
+	printf("  clean getters:              %8.3f ns/transform\n", cleanTime * 1e9 / transformCount);
+	printf("  max difference %g\n", maxDifference);
+
+	if (maxDifference > 1e-3f)
+	{
+		printf("TRS-derived matrices don't match the general inverse\n");
+		return 1;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------
+// Checks the SIMD (and threaded) tangents against the
+// original scalar routine at 1, 2, 4 ... threads, and
+// times both
+// --------------------------------------------------------
+static int RunTangentCheck(const std::string& file, unsigned int maxThreads)
+{
+	MeshData meshData;
+	if (!LoadOBJ(NarrowToWide(file), meshData))
+	{
+		printf("Failed to load %s\n", file.c_str());
+		return 1;
+	}
+
+	if (maxThreads == 0)
+		maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::vector<Vertex> reference = meshData.Vertices;
+	auto start = std::chrono::high_resolution_clock::now();
+	CalculateTangentsScalar(reference.data(), (int)reference.size(), meshData.Indices.data(), (int)meshData.Indices.size());
+	double scalarTime = SecondsSince(start);
+	printf("%zu verts, %zu triangles\n", reference.size(), meshData.Indices.size() / 3);
+	printf("    scalar: %8.3f ms\n", scalarTime * 1000.0);
+
+	for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		std::vector<Vertex> verts = meshData.Vertices;
+		start = std::chrono::high_resolution_clock::now();
+		CalculateTangents(verts.data(), (int)verts.size(), meshData.Indices.data(), (int)meshData.Indices.size(), threads);
+		double elapsed = SecondsSince(start);
+
+		// NaNs (from degenerate uvs) count as matching if both sides have them
+		float maxDifference = 0.0f;
+		for (size_t i = 0; i < verts.size(); i++)
+		{
+			const float* a = &verts[i].Tangent.x;
+			const float* b = &reference[i].Tangent.x;
+			for (int c = 0; c < 3; c++)
+			{
+				if (a[c] != a[c] && b[c] != b[c])
+					continue;
+				float difference = std::fabs(a[c] - b[c]);
+				if (!(difference <= maxDifference))
+					maxDifference = difference;
+			}
+		}
+
+		bool matches = maxDifference <= 1e-5f;
+		printf("%2u threads: %8.3f ms (%.2fx scalar), max difference %g%s\n",
+			threads, elapsed * 1000.0, scalarTime / elapsed, maxDifference,
+			matches ? "" : " - DOESN'T MATCH SCALAR");
+		if (!matches)
+			return 1;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------
+// Loads every .obj one after another on this thread, then
+// again through an AssetLoader, and compares wall times
+//
+// - Each job is a single-threaded parse plus tangents, so
+//   the speedup comes from loading files side by side
+// - The main thread "uploads" each mesh (sums its vertices)
+//   as its future becomes ready, like CreateGeometry does
+// --------------------------------------------------------
+static std::shared_ptr<MeshData> LoadMeshJob(const std::string& file)
+{
+	std::shared_ptr<MeshData> meshData = std::make_shared<MeshData>();
+	if (!LoadOBJ(NarrowToWide(file), *meshData, 1))
+		return nullptr;
+
+	CalculateTangents(meshData->Vertices.data(), (int)meshData->Vertices.size(), meshData->Indices.data(), (int)meshData->Indices.size());
+	return meshData;
+}
+
+static float SumVertices(const MeshData& meshData)
+{
+	float checksum = 0.0f;
+	for (auto& v : meshData.Vertices)
+		checksum += v.Position.x + v.Tangent.x;
+	return checksum;
+}
+
+static int RunAsyncMeshLoads(const std::vector<std::string>& objFiles, unsigned int threadCount)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	float serialChecksum = 0.0f;
+	for (auto& file : objFiles)
+	{
+		std::shared_ptr<MeshData> meshData = LoadMeshJob(file);
+		if (!meshData)
+		{
+			printf("Failed to load %s\n", file.c_str());
+			return 1;
+		}
+		serialChecksum += SumVertices(*meshData);
+	}
+	double serialTime = SecondsSince(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	float asyncChecksum = 0.0f;
+	unsigned int workerCount = 0;
+	{
+		AssetLoader loader(threadCount);
+		workerCount = loader.GetThreadCount();
+
+		std::vector<std::future<std::shared_ptr<MeshData>>> pending;
+		for (auto& file : objFiles)
+			pending.push_back(loader.Submit([file]() { return LoadMeshJob(file); }));
+
+		for (auto& mesh : pending)
+		{
+			std::shared_ptr<MeshData> meshData = mesh.get();
+			if (!meshData)
+				return 1;
+			asyncChecksum += SumVertices(*meshData);
+		}
+	}
+	double asyncTime = SecondsSince(start);
+
+	printf("%zu meshes: serial %.3f ms, async (%u workers) %.3f ms, speedup %.2fx\n",
+		objFiles.size(), serialTime * 1000.0, workerCount, asyncTime * 1000.0, serialTime / asyncTime);
+
+	if (serialChecksum != asyncChecksum)
+	{
+		printf("Async load doesn't match serial load (%f vs %f)\n", asyncChecksum, serialChecksum);
+		return 1;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------
+// Parses the same .obj with 1, 2, 4 ... threads (up to
+// --threads, or one per core), checking that every run
+// matches the single-threaded output
+// --------------------------------------------------------
+static int RunObjScaling(const std::string& file, unsigned int maxThreads)
+{
+	MappedFile mapped;
+	if (!mapped.Open(NarrowToWide(file)))
+	{
+		printf("Failed to open %s\n", file.c_str());
+		return 1;
+	}
+	double megabytes = mapped.GetSize() / (1024.0 * 1024.0);
+
+	if (maxThreads == 0)
+		maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	MeshData reference;
+	double serialTime = 0.0;
+
+	for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		MeshData meshData;
+		auto start = std::chrono::high_resolution_clock::now();
+		if (!ParseOBJ(mapped.GetData(), mapped.GetSize(), meshData, threads))
+		{
+			printf("Failed to parse %s\n", file.c_str());
+			return 1;
+		}
+		double elapsed = SecondsSince(start);
+
+		bool identical = true;
+		if (threads == 1)
+		{
+			reference = meshData;
+			serialTime = elapsed;
+		}
+		else
+		{
+			identical =
+				meshData.Indices == reference.Indices &&
+				meshData.Vertices.size() == reference.Vertices.size() &&
+				memcmp(meshData.Vertices.data(), reference.Vertices.data(), sizeof(Vertex) * meshData.Vertices.size()) == 0;
+		}
+
+		printf("%2u threads: %8.3f ms (%7.1f MB/s, %.2fx)%s\n",
+			threads, elapsed * 1000.0, megabytes / elapsed, serialTime / elapsed,
+			identical ? "" : " - OUTPUT DIFFERS");
+		if (!identical)
+			return 1;
+	}
+	return 0;
+}
+
+// Runs the solar system update loop - same scene as Game::CreateGeometry
+static int RunUpdateLoop(int frameCount)
+{
+	Camera camera(0.0f, 10.0f, -55.0f, 1280.0f / 720.0f, 5.0f, 5.0f, XM_PI / 3, 0.01f, 150.0f, true);
+
+	// Same hierarchy as Game::CreateGeometry
+	TransformStore scene;
+	OrbitSystem orbits;
+	TransformStore::Handle solarSystem = scene.Create();
+	std::vector<TransformStore::Handle> bodies;
+	bodies.push_back(scene.Create(solarSystem));
+	bodies.push_back(scene.Create(orbits.AddOrbit(scene, solarSystem, 15.0f, 20.0f)));
+	bodies.push_back(scene.Create(orbits.AddOrbit(scene, solarSystem, 40.0f, 40.0f)));
+	bodies.push_back(scene.Create(orbits.AddOrbit(scene, solarSystem, 60.0f, 60.0f)));
+	bodies.push_back(scene.Create(orbits.AddOrbit(scene, solarSystem, 75.0f, 80.0f)));
+	scene.Scale(bodies[0], 10, 10, 10);
+	scene.Scale(bodies[1], 1.2f, 1.2f, 1.2f);
+	scene.Scale(bodies[2], 5, 5, 5);
+	scene.Scale(bodies[4], 3, 3, 3);
+
+	const float deltaTime = 1.0f / 60.0f;
+	float checksum = 0.0f;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		orbits.Update(scene, deltaTime);
+		scene.Rotate(bodies[1], 0, -0.24f * deltaTime, 0);
+		scene.UpdateMatrices();
+		camera.UpdateViewMatrix();
+
+		// Pull the matrices the draw loop would upload
+		for (TransformStore::Handle body : bodies)
+		{
+			const XMFLOAT4X4& world = scene.GetWorldMatrix(body);
+			const XMFLOAT4X4& worldInvTranspose = scene.GetWorldInverseTransposeMatrix(body);
+			checksum += world._41 + worldInvTranspose._11;
+		}
+	}
+	double elapsed = SecondsSince(start);
+
+	printf("%d frames in %.3f ms (%.3f us/frame), checksum %f\n",
+		frameCount, elapsed * 1000.0, elapsed * 1000000.0 / frameCount, checksum);
+
+	// Planet 2 still sits on its orbit, unturned and at its own size
+	const XMFLOAT4X4& planet2 = scene.GetWorldMatrix(bodies[2]);
+	float distance = sqrtf(planet2._41 * planet2._41 + planet2._43 * planet2._43);
+	if (fabsf(distance - 40.0f) > 1e-3f || fabsf(planet2._11 - 5.0f) > 1e-3f || fabsf(planet2._13) > 1e-3f)
+	{
+		printf("Planet 2 is off its orbit or turning with it\n");
+		return 1;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------
+// A scene node the old-fashioned way, for comparison with
+// TransformStore's flat hierarchy pass
+// --------------------------------------------------------
+struct PointerNode
+{
+	Transform Local;
+	XMFLOAT4X4 World;
+	XMFLOAT4X4 WorldInvTranspose;
+	std::vector<PointerNode*> Children;
+};
+
+static void UpdatePointerNode(PointerNode* node, FXMMATRIX parentWorld, CXMMATRIX parentInvTranspose)
+{
+	XMFLOAT4X4 local = node->Local.GetWorldMatrix();
+	XMFLOAT4X4 localInvTranspose = node->Local.GetWorldInverseTransposeMatrix();
+	XMMATRIX world = XMLoadFloat4x4(&local) * parentWorld;
+	XMMATRIX invTranspose = XMLoadFloat4x4(&localInvTranspose) * parentInvTranspose;
+	XMStoreFloat4x4(&node->World, world);
+	XMStoreFloat4x4(&node->WorldInvTranspose, invTranspose);
+
+	for (PointerNode* child : node->Children)
+		UpdatePointerNode(child, world, invTranspose);
+}
+
+// --------------------------------------------------------
+// Builds a random N-node forest (each node's parent is a
+// random earlier node, or 64 long chains if --deep), spins
+// every root, and times the world matrix update against
+// recursively walking heap-allocated nodes
+// --------------------------------------------------------
+static int RunHierarchyBenchmark(size_t nodeCount, bool deep)
+{
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> positions(-10.0f, 10.0f);
+	std::uniform_real_distribution<float> angles(-XM_PI, XM_PI);
+	// Chains are long enough that any scale would compound out of float range
+	std::uniform_real_distribution<float> scales(deep ? 1.0f : 0.8f, deep ? 1.0f : 1.25f);
+
+	TransformStore scene;
+	scene.Reserve(nodeCount);
+	std::vector<std::unique_ptr<PointerNode>> nodes;
+	std::vector<PointerNode*> roots;
+	std::vector<TransformStore::Handle> rootHandles;
+
+	for (size_t i = 0; i < nodeCount; i++)
+	{
+		// A handful of roots, everything else hangs under something earlier
+		const size_t rootCount = 64;
+		TransformStore::Handle parent = TransformStore::NoParent;
+		if (i >= rootCount)
+			parent = deep ? (TransformStore::Handle)(i - rootCount) : (TransformStore::Handle)(random() % i);
+
+		TransformStore::Handle h = scene.Create(parent);
+		nodes.push_back(std::make_unique<PointerNode>());
+		if (parent == TransformStore::NoParent)
+		{
+			roots.push_back(nodes.back().get());
+			rootHandles.push_back(h);
+		}
+		else
+			nodes[parent]->Children.push_back(nodes.back().get());
+
+		float p[3] = { positions(random), positions(random), positions(random) };
+		float r[3] = { angles(random), angles(random), angles(random) };
+		float s[3] = { scales(random), scales(random), scales(random) };
+		scene.SetPosition(h, p[0], p[1], p[2]);
+		scene.SetRotation(h, r[0], r[1], r[2]);
+		scene.SetScale(h, s[0], s[1], s[2]);
+		nodes.back()->Local.SetPosition(p[0], p[1], p[2]);
+		nodes.back()->Local.SetRotation(r[0], r[1], r[2]);
+		nodes.back()->Local.SetScale(s[0], s[1], s[2]);
+	}
+	scene.UpdateMatrices();
+
+	int repeats = (int)std::max<size_t>(1, 2000000 / nodeCount);
+
+	// Only the roots move, so every other local matrix stays cached
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < repeats; i++)
+	{
+		for (size_t r = 0; r < roots.size(); r++)
+			roots[r]->Local.Rotate(0, 0.01f, 0);
+		for (PointerNode* root : roots)
+			UpdatePointerNode(root, XMMatrixIdentity(), XMMatrixIdentity());
+	}
+	double pointerTime = SecondsSince(start) / repeats;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < repeats; i++)
+	{
+		for (TransformStore::Handle h : rootHandles)
+			scene.Rotate(h, 0, 0.01f, 0);
+		scene.UpdateMatrices();
+	}
+	double flatTime = SecondsSince(start) / repeats;
+
+	float maxDifference = 0.0f;
+	float maxMagnitude = 0.0f;
+	for (size_t i = 0; i < nodeCount; i++)
+	{
+		maxDifference = std::max(maxDifference, MaxDifference(nodes[i]->World, scene.GetWorldMatrix((TransformStore::Handle)i)));
+		maxDifference = std::max(maxDifference, MaxDifference(nodes[i]->WorldInvTranspose, scene.GetWorldInverseTransposeMatrix((TransformStore::Handle)i)));
+		for (int c = 0; c < 3; c++)
+			maxMagnitude = std::max(maxMagnitude, std::fabs(nodes[i]->World.m[3][c]));
+	}
+
+	printf("%zu nodes (%s):\n", nodeCount, deep ? "chains" : "random parents");
+	printf("  recursive pointer walk: %10.3f ms\n", pointerTime * 1000.0);
+	printf("  flat ordered pass:      %10.3f ms (%.2fx)\n", flatTime * 1000.0, pointerTime / flatTime);
+	printf("  max difference %g (translations up to %g)\n", maxDifference, maxMagnitude);
+
+	// Differences grow with depth, so compare relative to the scene's size
+	if (maxDifference > 1e-4f * std::max(1.0f, maxMagnitude))
+	{
+		printf("Flat hierarchy doesn't match the recursive walk\n");
+		return 1;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------
+// Checks the SIMD frustum test against a box-at-a-time one,
+// plus a few boxes whose answer is known, then times it
+// - Uses the same camera as Game
+// --------------------------------------------------------
+static int RunCullingCheck(size_t boxCount)
+{
+	Camera camera(0.0f, 10.0f, -55.0f, 16.0f / 9.0f, 5.0f, 5.0f, XM_PI / 3, 0.01f, 150.0f, true);
+	FrustumCuller culler;
+	XMFLOAT3 unitCenter(0, 0, 0);
+	XMFLOAT3 unitExtents(1, 1, 1);
+
+	// In front, behind, past the far plane, off to the side, around the camera
+	struct KnownBox { XMFLOAT3 Position; float Scale; bool Visible; };
+	const KnownBox known[] = {
+		{ XMFLOAT3(0, 10, 0), 1.0f, true },
+		{ XMFLOAT3(0, 10, -100), 1.0f, false },
+		{ XMFLOAT3(0, 10, 200), 1.0f, false },
+		{ XMFLOAT3(500, 10, 0), 1.0f, false },
+		{ XMFLOAT3(0, 10, -55), 5.0f, true },
+	};
+	culler.Begin(camera.GetView(), camera.GetProjection());
+	for (const KnownBox& box : known)
+	{
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, XMMatrixScaling(box.Scale, box.Scale, box.Scale) * XMMatrixTranslation(box.Position.x, box.Position.y, box.Position.z));
+		culler.Add(unitCenter, unitExtents, world);
+	}
+	culler.Cull();
+	for (size_t i = 0; i < sizeof(known) / sizeof(known[0]); i++)
+	{
+		if (culler.IsVisible(i) != known[i].Visible)
+		{
+			printf("Known box %zu should be %s\n", i, known[i].Visible ? "visible" : "culled");
+			return 1;
+		}
+	}
+
+	// Random rotated, scaled boxes scattered around the camera
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> positions(-200.0f, 200.0f);
+	std::uniform_real_distribution<float> angles(-XM_PI, XM_PI);
+	std::uniform_real_distribution<float> scales(0.5f, 5.0f);
+	std::vector<XMFLOAT4X4> worlds(boxCount);
+	for (XMFLOAT4X4& world : worlds)
+	{
+		XMMATRIX m =
+			XMMatrixScaling(scales(random), scales(random), scales(random)) *
+			XMMatrixRotationRollPitchYaw(angles(random), angles(random), angles(random)) *
+			XMMatrixTranslation(positions(random), positions(random), positions(random));
+		XMStoreFloat4x4(&world, m);
+	}
+
+	culler.Begin(camera.GetView(), camera.GetProjection());
+	for (const XMFLOAT4X4& world : worlds)
+		culler.Add(unitCenter, unitExtents, world);
+	culler.Cull();
+
+	for (size_t i = 0; i < boxCount; i++)
+	{
+		// The world box should be exactly the bounds of the moved corners
+		XMMATRIX world = XMLoadFloat4x4(&worlds[i]);
+		XMVECTOR lo = XMVectorReplicate(FLT_MAX);
+		XMVECTOR hi = XMVectorReplicate(-FLT_MAX);
+		for (int corner = 0; corner < 8; corner++)
+		{
+			XMVECTOR p = XMVector3TransformCoord(XMVectorSet(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, corner & 4 ? 1.0f : -1.0f, 1.0f), world);
+			lo = XMVectorMin(lo, p);
+			hi = XMVectorMax(hi, p);
+		}
+		XMFLOAT3 expectedCenter, expectedExtents, center, extents;
+		XMStoreFloat3(&expectedCenter, (lo + hi) * 0.5f);
+		XMStoreFloat3(&expectedExtents, (hi - lo) * 0.5f);
+		culler.GetWorldBox(i, center, extents);
+
+		float difference = std::max({
+			std::fabs(center.x - expectedCenter.x), std::fabs(center.y - expectedCenter.y), std::fabs(center.z - expectedCenter.z),
+			std::fabs(extents.x - expectedExtents.x), std::fabs(extents.y - expectedExtents.y), std::fabs(extents.z - expectedExtents.z) });
+		if (difference > 1e-3f)
+		{
+			printf("Box %zu: world bounds are off by %g\n", i, difference);
+			return 1;
+		}
+
+		if (culler.IsVisible(i) != culler.IsBoxVisible(center, extents))
+		{
+			printf("Box %zu: SIMD and scalar tests disagree\n", i);
+			return 1;
+		}
+	}
+
+	int repeats = (int)std::max<size_t>(1, 10000000 / boxCount);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeats; r++)
+	{
+		culler.Begin(camera.GetView(), camera.GetProjection());
+		for (const XMFLOAT4X4& world : worlds)
+			culler.Add(unitCenter, unitExtents, world);
+	}
+	double addTime = SecondsSince(start) / repeats;
+
+	size_t scalarVisible = 0;
+	start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeats; r++)
+	{
+		scalarVisible = 0;
+		for (size_t i = 0; i < boxCount; i++)
+		{
+			XMFLOAT3 center, extents;
+			culler.GetWorldBox(i, center, extents);
+			scalarVisible += culler.IsBoxVisible(center, extents);
+		}
+	}
+	double scalarTime = SecondsSince(start) / repeats;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeats; r++)
+		culler.Cull();
+	double cullTime = SecondsSince(start) / repeats;
+
+	printf("%zu boxes: %zu visible, %zu culled\n", boxCount, culler.GetVisibleCount(), culler.GetCulledCount());
+	printf("  transform bounds:      %10.3f ms\n", addTime * 1000.0);
+	printf("  box-at-a-time test:    %10.3f ms\n", scalarTime * 1000.0);
+	printf("  SIMD test (4 at once): %10.3f ms (%.2fx)\n", cullTime * 1000.0, scalarTime / cullTime);
+	return scalarVisible == culler.GetVisibleCount() ? 0 : 1;
+}
+
+// --------------------------------------------------------
+// Times BVH build, refit and queries over random boxes, and
+// checks every query against a test of every box
+// --------------------------------------------------------
+static int RunBVHBenchmark(size_t boxCount)
+{
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> positions(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> sizes(0.5f, 5.0f);
+	std::uniform_real_distribution<float> nudges(-2.0f, 2.0f);
+	std::vector<XMFLOAT3> centers(boxCount), extents(boxCount);
+	for (size_t i = 0; i < boxCount; i++)
+	{
+		centers[i] = XMFLOAT3(positions(random), positions(random), positions(random));
+		extents[i] = XMFLOAT3(sizes(random), sizes(random), sizes(random));
+	}
+
+	BVH bvh;
+	bvh.Resize(boxCount);
+	for (size_t i = 0; i < boxCount; i++)
+		bvh.SetBounds((BVH::Item)i, centers[i], extents[i]);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	bvh.Build();
+	double buildTime = SecondsSince(start);
+
+	// Every box moves a little, like a frame of animation
+	for (size_t i = 0; i < boxCount; i++)
+	{
+		centers[i].x += nudges(random);
+		centers[i].y += nudges(random);
+		centers[i].z += nudges(random);
+	}
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < boxCount; i++)
+		bvh.SetBounds((BVH::Item)i, centers[i], extents[i]);
+	bvh.Refit();
+	double refitTime = SecondsSince(start);
+
+	// Frustum: the BVH against the flat SIMD culler
+	Camera camera(0.0f, 0.0f, -600.0f, 16.0f / 9.0f, 5.0f, 5.0f, XM_PI / 3, 0.01f, 1000.0f, true);
+	FrustumCuller culler;
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	start = std::chrono::high_resolution_clock::now();
+	culler.Begin(camera.GetView(), camera.GetProjection());
+	for (size_t i = 0; i < boxCount; i++)
+		culler.Add(centers[i], extents[i], identity);
+	culler.Cull();
+	double linearFrustumTime = SecondsSince(start);
+
+	std::vector<BVH::Item> results;
+	start = std::chrono::high_resolution_clock::now();
+	bvh.QueryFrustum(culler.GetPlanes(), results);
+	double frustumTime = SecondsSince(start);
+
+	std::vector<uint8_t> found(boxCount, 0);
+	for (BVH::Item item : results)
+		found[item]++;
+	for (size_t i = 0; i < boxCount; i++)
+	{
+		if (found[i] != (culler.IsVisible(i) ? 1 : 0))
+		{
+			printf("Frustum query disagrees with the culler on box %zu\n", i);
+			return 1;
+		}
+	}
+
+	// Rays from around the camera into the scene, and overlap boxes
+	const int queryCount = 1000;
+	std::vector<XMFLOAT3> origins(queryCount), directions(queryCount), queryMin(queryCount), queryMax(queryCount);
+	for (int q = 0; q < queryCount; q++)
+	{
+		origins[q] = XMFLOAT3(positions(random), positions(random), -600.0f);
+		XMStoreFloat3(&directions[q], XMVector3Normalize(XMVectorSet(nudges(random) * 0.1f, nudges(random) * 0.1f, 1.0f, 0.0f)));
+		XMFLOAT3 c(positions(random), positions(random), positions(random));
+		queryMin[q] = XMFLOAT3(c.x - 20.0f, c.y - 20.0f, c.z - 20.0f);
+		queryMax[q] = XMFLOAT3(c.x + 20.0f, c.y + 20.0f, c.z + 20.0f);
+	}
+
+	std::vector<float> hitDistances(queryCount);
+	int hits = 0;
+	start = std::chrono::high_resolution_clock::now();
+	for (int q = 0; q < queryCount; q++)
+	{
+		BVH::Item hit;
+		hits += bvh.Raycast(origins[q], directions[q], hit, hitDistances[q]);
+	}
+	double rayTime = SecondsSince(start) / queryCount;
+
+	size_t overlapCount = 0;
+	start = std::chrono::high_resolution_clock::now();
+	for (int q = 0; q < queryCount; q++)
+	{
+		results.clear();
+		bvh.QueryOverlap(queryMin[q], queryMax[q], results);
+		overlapCount += results.size();
+	}
+	double overlapTime = SecondsSince(start) / queryCount;
+
+	// The same queries against every box
+	start = std::chrono::high_resolution_clock::now();
+	for (int q = 0; q < queryCount; q++)
+	{
+		float closest = FLT_MAX;
+		for (size_t i = 0; i < boxCount; i++)
+		{
+			float near = 0.0f, far = FLT_MAX;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float o = (&origins[q].x)[axis];
+				float inv = 1.0f / (&directions[q].x)[axis];
+				float t0 = ((&centers[i].x)[axis] - (&extents[i].x)[axis] - o) * inv;
+				float t1 = ((&centers[i].x)[axis] + (&extents[i].x)[axis] - o) * inv;
+				near = std::max(near, std::min(t0, t1));
+				far = std::min(far, std::max(t0, t1));
+			}
+			if (near <= far)
+				closest = std::min(closest, near);
+		}
+		if (closest != hitDistances[q])
+		{
+			printf("Ray %d: BVH hit at %g, every box says %g\n", q, hitDistances[q], closest);
+			return 1;
+		}
+	}
+	double linearRayTime = SecondsSince(start) / queryCount;
+
+	size_t linearOverlapCount = 0;
+	start = std::chrono::high_resolution_clock::now();
+	for (int q = 0; q < queryCount; q++)
+	{
+		for (size_t i = 0; i < boxCount; i++)
+		{
+			linearOverlapCount +=
+				centers[i].x - extents[i].x <= queryMax[q].x && centers[i].x + extents[i].x >= queryMin[q].x &&
+				centers[i].y - extents[i].y <= queryMax[q].y && centers[i].y + extents[i].y >= queryMin[q].y &&
+				centers[i].z - extents[i].z <= queryMax[q].z && centers[i].z + extents[i].z >= queryMin[q].z;
+		}
+	}
+	double linearOverlapTime = SecondsSince(start) / queryCount;
+	if (linearOverlapCount != overlapCount)
+	{
+		printf("Overlap queries found %zu boxes, every box says %zu\n", overlapCount, linearOverlapCount);
+		return 1;
+	}
+
+	// Picking through the middle of the screen hits a box placed there
+	Camera pickCamera(0.0f, 10.0f, -55.0f, 16.0f / 9.0f, 5.0f, 5.0f, XM_PI / 3, 0.01f, 150.0f, true);
+	BVH pickTarget;
+	pickTarget.Resize(2);
+	pickTarget.SetBounds(0, XMFLOAT3(30, 10, 0), XMFLOAT3(1, 1, 1));
+	pickTarget.SetBounds(1, XMFLOAT3(0, 10, 0), XMFLOAT3(1, 1, 1));
+	pickTarget.Build();
+	XMFLOAT3 origin, direction;
+	pickCamera.GetPickRay(640, 360, 1280, 720, origin, direction);
+	BVH::Item picked;
+	float pickDistance;
+	if (!pickTarget.Raycast(origin, direction, picked, pickDistance) || picked != 1)
+	{
+		printf("Picking through the middle of the screen missed\n");
+		return 1;
+	}
+
+	printf("%zu boxes, %zu nodes:\n", boxCount, bvh.GetNodeCount());
+	printf("  build:                %10.3f ms\n", buildTime * 1000.0);
+	printf("  refit (all moved):    %10.3f ms\n", refitTime * 1000.0);
+	printf("  frustum (%zu in):  %10.3f ms (every box, SIMD: %.3f ms)\n", culler.GetVisibleCount(), frustumTime * 1000.0, linearFrustumTime * 1000.0);
+	printf("  ray (%d of %d hit): %10.3f us (every box: %.3f us)\n", hits, queryCount, rayTime * 1e6, linearRayTime * 1e6);
+	printf("  overlap (%.1f each): %10.3f us (every box: %.3f us)\n", (double)overlapCount / queryCount, overlapTime * 1e6, linearOverlapTime * 1e6);
+	return 0;
+}
+
+// --------------------------------------------------------
+// Queues draws of a made-up scene in random order, checks
+// the bound state is right at every draw once redundant
+// binds are skipped, and counts how many were skipped
+// - Objects are just addresses here, like Game's pointers
+// --------------------------------------------------------
+static int RunRenderQueueCheck(size_t drawCount)
+{
+	const int vertexShaderCount = 2, pixelShaderCount = 3, materialCount = 40, meshCount = 25;
+	std::vector<char> objects(vertexShaderCount + pixelShaderCount + materialCount + meshCount);
+	const char* vertexShaders = &objects[0];
+	const char* pixelShaders = vertexShaders + vertexShaderCount;
+	const char* materials = pixelShaders + pixelShaderCount;
+	const char* meshes = materials + materialCount;
+
+	// Each material always uses the same pair of shaders
+	struct TestDraw { const void* VertexShader; const void* PixelShader; const void* Material; const void* Mesh; float Depth; };
+	std::mt19937 random(1234);
+	std::vector<TestDraw> testDraws(drawCount);
+	for (TestDraw& d : testDraws)
+	{
+		int material = (int)(random() % materialCount);
+		d.VertexShader = vertexShaders + material % vertexShaderCount;
+		d.PixelShader = pixelShaders + material % pixelShaderCount;
+		d.Material = materials + material;
+		d.Mesh = meshes + random() % meshCount;
+		d.Depth = (float)(random() % 10000) * 0.01f;
+	}
+
+	RenderQueue queue;
+	int repeats = (int)std::max<size_t>(1, 1000000 / drawCount);
+	double queueTime = 0.0;
+	double submitTime = 0.0;
+	for (int r = 0; r < repeats; r++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		queue.Clear();
+		for (size_t i = 0; i < drawCount; i++)
+		{
+			const TestDraw& d = testDraws[i];
+			queue.Add((uint32_t)i, d.VertexShader, d.PixelShader, d.Material, d.Mesh, d.Depth);
+		}
+		queue.Sort();
+		queueTime += SecondsSince(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		queue.Submit([](uint32_t) {}, [](uint32_t) {}, [](uint32_t) {}, [](uint32_t) {});
+		submitTime += SecondsSince(start);
+	}
+
+	// Replay with a fake device that remembers what's bound
+	const void* boundShaders[2] = {};
+	const void* boundMaterial = 0;
+	const void* boundMesh = 0;
+	std::vector<uint8_t> drawn(drawCount, 0);
+	bool wrongState = false;
+	queue.Submit(
+		[&](uint32_t i) { boundShaders[0] = testDraws[i].VertexShader; boundShaders[1] = testDraws[i].PixelShader; boundMaterial = 0; },
+		[&](uint32_t i) { boundMaterial = testDraws[i].Material; },
+		[&](uint32_t i) { boundMesh = testDraws[i].Mesh; },
+		[&](uint32_t i) {
+			const TestDraw& d = testDraws[i];
+			wrongState = wrongState ||
+				boundShaders[0] != d.VertexShader || boundShaders[1] != d.PixelShader ||
+				boundMaterial != d.Material || boundMesh != d.Mesh;
+			drawn[i]++;
+		});
+
+	for (size_t i = 1; i < queue.GetCount(); i++)
+	{
+		if (queue.GetKey(i) < queue.GetKey(i - 1))
+		{
+			printf("Draws aren't sorted by key\n");
+			return 1;
+		}
+	}
+	if (wrongState || std::count(drawn.begin(), drawn.end(), 1) != (long)drawCount)
+	{
+		printf("Submitted draws had the wrong state bound, or weren't each drawn once\n");
+		return 1;
+	}
+
+	const RenderQueue::Stats& stats = queue.GetStats();
+	printf("%zu draws (%d shader pairs, %d materials, %d meshes):\n", drawCount, vertexShaderCount * pixelShaderCount, materialCount, meshCount);
+	printf("  shader binds:   %8zu (%zu skipped)\n", stats.ShaderBinds, stats.ShaderBindsSkipped);
+	printf("  material binds: %8zu (%zu skipped)\n", stats.MaterialBinds, stats.MaterialBindsSkipped);
+	printf("  mesh binds:     %8zu (%zu skipped)\n", stats.MeshBinds, stats.MeshBindsSkipped);
+	printf("  unsorted, every draw binds everything: %zu binds of each\n", drawCount);
+	printf("  queue + sort: %.3f ms, submit: %.3f ms\n", queueTime / repeats * 1000.0, submitTime / repeats * 1000.0);
+	return 0;
+}
+
+// --------------------------------------------------------
+// The CPU side of drawing an asteroid field through the
+// instancing path, frame after frame: spin the belt, cull,
+// queue and sort, then gather each batch's instance data
+// - Checks every visible rock lands in exactly one batch
+//   with its own matrices
+// --------------------------------------------------------
+static int RunInstancingBenchmark(size_t rockCount)
+{
+	// Stand-ins for the shaders, materials and meshes
+	const int materialCount = 3, meshCount = 2;
+	char vertexShader = 0, pixelShader = 0, materials[materialCount] = {}, meshes[meshCount] = {};
+	XMFLOAT3 boundsCenter(0, 0, 0);
+	XMFLOAT3 boundsExtents(1, 1, 1);
+
+	// Rocks hang off a few spinning rings
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> radii(60.0f, 120.0f);
+	std::uniform_real_distribution<float> angles(-XM_PI, XM_PI);
+	std::uniform_real_distribution<float> heights(-4.0f, 4.0f);
+	std::uniform_real_distribution<float> sizes(0.2f, 1.0f);
+	TransformStore scene;
+	scene.Reserve(rockCount + 8);
+	std::vector<TransformStore::Handle> rings;
+	for (int r = 0; r < 8; r++)
+		rings.push_back(scene.Create());
+
+	std::vector<TransformStore::Handle> rocks(rockCount);
+	for (size_t i = 0; i < rockCount; i++)
+	{
+		rocks[i] = scene.Create(rings[i % rings.size()]);
+		float angle = angles(random), radius = radii(random), size = sizes(random);
+		scene.SetPosition(rocks[i], cosf(angle) * radius, heights(random), sinf(angle) * radius);
+		scene.SetRotation(rocks[i], angles(random), angles(random), angles(random));
+		scene.SetScale(rocks[i], size, size, size);
+	}
+
+	Camera camera(0.0f, 40.0f, -180.0f, 16.0f / 9.0f, 5.0f, 5.0f, XM_PI / 3, 0.01f, 400.0f, true);
+	FrustumCuller culler;
+	RenderQueue queue;
+	std::vector<InstanceData> instanceData(rockCount);
+	std::vector<uint8_t> drawn(rockCount);
+	const int frameCount = 20;
+	double updateTime = 0.0, cullTime = 0.0, queueTime = 0.0, gatherTime = 0.0;
+	bool wrongInstance = false;
+	size_t drawnCount = 0;
+
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t r = 0; r < rings.size(); r++)
+			scene.Rotate(rings[r], 0, 0.01f * (r + 1), 0);
+		scene.UpdateMatrices();
+		updateTime += SecondsSince(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		culler.Begin(camera.GetView(), camera.GetProjection());
+		for (size_t i = 0; i < rockCount; i++)
+			culler.Add(boundsCenter, boundsExtents, scene.GetWorldMatrix(rocks[i]));
+		culler.Cull();
+		cullTime += SecondsSince(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		queue.Clear();
+		for (size_t i = 0; i < rockCount; i++)
+		{
+			if (culler.IsVisible(i))
+				queue.Add((uint32_t)i, &vertexShader, &pixelShader, &materials[i % materialCount], &meshes[i % meshCount], 0.0f);
+		}
+		queue.Sort();
+		queueTime += SecondsSince(start);
+
+		// Each batch writes into the next stretch, like a mapped buffer
+		start = std::chrono::high_resolution_clock::now();
+		size_t written = 0;
+		queue.SubmitBatches([](uint32_t) {}, [](uint32_t) {}, [](uint32_t) {},
+			[&](const uint32_t* indices, size_t count) {
+				InstanceData* instances = &instanceData[written];
+				for (size_t n = 0; n < count; n++)
+				{
+					instances[n].World = scene.GetWorldMatrix(rocks[indices[n]]);
+					instances[n].WorldInvTranspose = scene.GetWorldInverseTransposeMatrix(rocks[indices[n]]);
+				}
+				written += count;
+			});
+		gatherTime += SecondsSince(start);
+
+		// Check the last frame
+		if (frame == frameCount - 1)
+		{
+			size_t n = 0;
+			queue.SubmitBatches([](uint32_t) {}, [](uint32_t) {}, [](uint32_t) {},
+				[&](const uint32_t* indices, size_t count) {
+					for (size_t k = 0; k < count; k++, n++)
+					{
+						drawn[indices[k]]++;
+						wrongInstance = wrongInstance ||
+							MaxDifference(instanceData[n].World, scene.GetWorldMatrix(rocks[indices[k]])) != 0.0f ||
+							MaxDifference(instanceData[n].WorldInvTranspose, scene.GetWorldInverseTransposeMatrix(rocks[indices[k]])) != 0.0f;
+					}
+				});
+			drawnCount = n;
+		}
+	}
+
+	for (size_t i = 0; i < rockCount; i++)
+	{
+		if (drawn[i] != (culler.IsVisible(i) ? 1 : 0))
+			wrongInstance = true;
+	}
+	if (wrongInstance || drawnCount != culler.GetVisibleCount())
+	{
+		printf("Instance data doesn't match the visible rocks\n");
+		return 1;
+	}
+
+	const RenderQueue::Stats& stats = queue.GetStats();
+	printf("%zu rocks, %zu visible, drawn in %zu instanced batches:\n", rockCount, stats.Draws, stats.Batches);
+	printf("  update transforms:     %8.3f ms\n", updateTime / frameCount * 1000.0);
+	printf("  frustum cull:          %8.3f ms\n", cullTime / frameCount * 1000.0);
+	printf("  queue + sort:          %8.3f ms\n", queueTime / frameCount * 1000.0);
+	printf("  gather instance data:  %8.3f ms (%.1f MB)\n", gatherTime / frameCount * 1000.0, stats.Draws * sizeof(InstanceData) / (1024.0 * 1024.0));
+	return 0;
+}
+
+// --------------------------------------------------------
+// Loads a handful of small files through an AssetCache the
+// way Game loads textures (prefetched on the loader, then
+// fetched on this thread), with a byte-copying "decoder"
+// - Checks each distinct file content is decoded and created
+//   once, however many paths or spellings lead to it, and a
+//   missing file fails once and then stays failed
+// --------------------------------------------------------
+static int RunTextureCacheCheck()
+{
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "HeadlessTextureCache";
+	std::filesystem::create_directories(directory / "sub");
+	auto writeFile = [&](const char* name, const char* contents) {
+		std::ofstream(directory / name, std::ios::binary) << contents;
+		return (directory / name).wstring();
+	};
+	std::wstring rampFile = writeFile("ramp.png", "ramp pixels");
+	std::wstring specFile = writeFile("spec.png", "spec pixels");
+	std::wstring copyFile = writeFile("sub/ramp-copy.png", "ramp pixels");
+	std::wstring badFile = writeFile("bad.png", "");
+	std::wstring otherSpelling = (directory / "sub" / ".." / "ramp.png").wstring();
+	std::wstring missingFile = (directory / "missing.png").wstring();
+
+	// Empty files stand in for undecodable ones
+	std::atomic<int> decodes(0);
+	int creates = 0;
+	AssetCache<std::string, std::shared_ptr<std::string>> cache(
+		[&](const char* data, size_t size, std::string& decoded) {
+			decodes++;
+			decoded.assign(data, size);
+			return size > 0;
+		},
+		[&](const std::string& decoded) {
+			creates++;
+			return std::make_shared<std::string>(decoded);
+		});
+
+	std::shared_ptr<std::string> ramp, spec, copy, ramp2, bad, missing;
+	{
+		// One worker runs jobs in order, so ramp.png always claims its content before the copy
+		AssetLoader loader(1);
+		for (const std::wstring& file : { rampFile, specFile, copyFile, rampFile, badFile, missingFile })
+			cache.Prefetch(file, loader);
+
+		// Fetching the copy first creates ramp.png too, so the other spelling is a hit
+		copy = cache.Get(copyFile);
+		ramp = cache.Get(otherSpelling);
+		spec = cache.Get(specFile);
+		bad = cache.Get(badFile);
+		missing = cache.Get(missingFile);
+	}
+	ramp2 = cache.Get(rampFile);
+	cache.Get(missingFile);
+	cache.Get(badFile);
+
+	std::error_code error;
+	std::filesystem::remove_all(directory, error);
+
+	const AssetCache<std::string, std::shared_ptr<std::string>>::Stats& stats = cache.GetStats();
+	if (!ramp || *ramp != "ramp pixels" || !spec || *spec != "spec pixels" || bad || missing)
+	{
+		printf("Cached values don't match their files\n");
+		return 1;
+	}
+	if (ramp != copy || ramp != ramp2 || ramp == spec)
+	{
+		printf("Identical files weren't shared, or different ones were\n");
+		return 1;
+	}
+	if (decodes != 3 || creates != 2 || stats.Misses != 2 || stats.ContentHits != 1 || stats.Failures != 2 || stats.Hits != 4)
+	{
+		printf("Expected 3 decodes, 2 creates, 2 misses, 1 content hit, 2 failures and 4 hits\n");
+		printf("Got %d decodes, %d creates, %zu misses, %zu content hits, %zu failures and %zu hits\n",
+			decodes.load(), creates, stats.Misses, stats.ContentHits, stats.Failures, stats.Hits);
+		return 1;
+	}
+
+	// Steady state: every lookup is a hit
+	const int lookups = 100000;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < lookups; i++)
+		cache.Get(rampFile);
+	double lookupTime = SecondsSince(start);
+
+	printf("%zu files, %d decodes, %d creates\n", cache.GetCount(), decodes.load(), creates);
+	printf("  hits: %zu, content hits: %zu, misses: %zu, failures: %zu\n", stats.Hits, stats.ContentHits, stats.Misses, stats.Failures);
+	printf("  hit lookup: %.3f us\n", lookupTime / lookups * 1e6);
+	return 0;
+}
+
+// --------------------------------------------------------
+// Replays Game's constant buffer traffic for a scene of
+// objects through DirtyRange, the way SimpleShader tracks
+// its buffers: per-frame data (camera moving every other
+// frame, fixed lights), per-material data at each material
+// change and per-object matrices at every draw, with a
+// tenth of the objects moving each frame
+// - A stand-in "GPU" copy of each buffer is only written
+//   on upload, and must match the CPU copy at every draw
+// --------------------------------------------------------
+static int RunConstantUploadCheck(size_t objectCount)
+{
+	struct TestBuffer
+	{
+		std::vector<unsigned char> Local;
+		std::vector<unsigned char> Gpu;
+		DirtyRange Dirty;
+	};
+	const unsigned int frameSize = 368, materialSize = 48, objectSize = 128;
+	TestBuffer buffers[3];
+	unsigned int sizes[3] = { frameSize, materialSize, objectSize };
+	for (int b = 0; b < 3; b++)
+	{
+		buffers[b].Local.assign(sizes[b], 0);
+		buffers[b].Gpu.assign(sizes[b], 0xCD);
+		buffers[b].Dirty.Add(0, sizes[b]);
+	}
+
+	size_t uploads = 0, skipped = 0, bytesUploaded = 0, bytesChanged = 0, copies = 0;
+	bool mismatch = false;
+	auto copy = [&](TestBuffer& buffer) {
+		copies++;
+		if (buffer.Dirty.IsDirty())
+		{
+			buffer.Gpu = buffer.Local;
+			uploads++;
+			bytesUploaded += buffer.Local.size();
+			bytesChanged += buffer.Dirty.GetSize();
+			buffer.Dirty.Clear();
+		}
+		else
+			skipped++;
+		mismatch = mismatch || buffer.Gpu != buffer.Local;
+	};
+
+	// Objects are drawn grouped by material, like the render queue sorts them
+	const int materialCount = 5, frameCount = 100;
+	std::mt19937 random(99);
+	std::vector<XMFLOAT4X4> worlds(objectCount);
+	for (XMFLOAT4X4& w : worlds)
+		XMStoreFloat4x4(&w, XMMatrixTranslation((float)(random() % 100), 0.0f, 0.0f));
+	float lights[64] = {};
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int f = 0; f < frameCount; f++)
+	{
+		XMFLOAT4X4 view;
+		XMStoreFloat4x4(&view, XMMatrixTranslation(0.0f, 0.0f, (float)(f / 2)));
+		buffers[0].Dirty.Write(buffers[0].Local.data(), 0, &view, sizeof(view));
+		buffers[0].Dirty.Write(buffers[0].Local.data(), 64, lights, sizeof(lights));
+		copy(buffers[0]);
+
+		for (size_t i = 0; i < objectCount / 10; i++)
+			worlds[random() % objectCount]._41 += 1.0f;
+
+		for (size_t i = 0; i < objectCount; i++)
+		{
+			int material = (int)(i * materialCount / objectCount);
+			if (i == 0 || material != (int)((i - 1) * materialCount / objectCount))
+			{
+				float tint[4] = { (float)material, 1.0f, 1.0f, 1.0f };
+				buffers[1].Dirty.Write(buffers[1].Local.data(), 0, tint, sizeof(tint));
+				copy(buffers[1]);
+			}
+
+			buffers[2].Dirty.Write(buffers[2].Local.data(), 0, &worlds[i], sizeof(XMFLOAT4X4));
+			buffers[2].Dirty.Write(buffers[2].Local.data(), 64, &worlds[i], sizeof(XMFLOAT4X4));
+			copy(buffers[2]);
+		}
+	}
+	double time = SecondsSince(start);
+
+	if (mismatch)
+	{
+		printf("A skipped upload left the GPU copy out of date\n");
+		return 1;
+	}
+
+	size_t everyCopyBytes = (size_t)frameCount * (frameSize + materialCount * materialSize + objectCount * objectSize);
+	printf("%zu objects, %d frames, %zu copy requests:\n", objectCount, frameCount, copies);
+	printf("  uploads: %zu (%zu skipped as unchanged)\n", uploads, skipped);
+	printf("  bytes uploaded: %zu of %zu when every copy uploads (%zu bytes changed)\n", bytesUploaded, everyCopyBytes, bytesChanged);
+	printf("  tracking: %.3f ms per frame\n", time / frameCount * 1000.0);
+	return 0;
+}
+
+// --------------------------------------------------------
+// Builds reflections captured from the compiled pixel and
+// instanced vertex shaders (what D3DReflect() reports for
+// CelShadingPixel.cso and InstancedVS.cso), then checks
+// they survive the cache format
+// - Every name is found after a round trip, with the same
+//   offsets, sizes and bind points
+// - Stale, truncated or corrupted caches are rejected
+// --------------------------------------------------------
+static void BuildPixelShaderFixture(ShaderReflection& reflection)
+{
+	// Bound resources come out samplers first, then textures
+	reflection.AddResource("Sampler", ShaderReflection::Sampler, 0);
+	reflection.AddResource("Clamp", ShaderReflection::Sampler, 1);
+	reflection.AddResource("Albedo", ShaderReflection::Texture, 0);
+	reflection.AddResource("NormalMap", ShaderReflection::Texture, 1);
+	reflection.AddResource("RoughnessMap", ShaderReflection::Texture, 2);
+	reflection.AddResource("CelRamp", ShaderReflection::Texture, 3);
+	reflection.AddResource("CelRampSpec", ShaderReflection::Texture, 4);
+	reflection.AddResource("Lights", ShaderReflection::Texture, 8);
+	reflection.AddResource("LightClusters", ShaderReflection::Texture, 9);
+	reflection.AddResource("LightIndices", ShaderReflection::Texture, 10);
+
+	reflection.AddBuffer("PerFrame", 0, 0, 64);
+	reflection.AddVariable("cameraPosition", 0, 12);
+	reflection.AddVariable("clusterDepthScale", 12, 4);
+	reflection.AddVariable("ambient", 16, 12);
+	reflection.AddVariable("clusterDepthBias", 28, 4);
+	reflection.AddVariable("clusterTileScale", 32, 8);
+	reflection.AddVariable("globalLightCount", 40, 4);
+	reflection.AddVariable("clusterCounts", 48, 12);
+	reflection.AddBuffer("PerMaterial", 0, 1, 32);
+	reflection.AddVariable("colorTint", 0, 12);
+	reflection.AddVariable("roughness", 12, 4);
+	reflection.AddVariable("uvScale", 16, 8);
+	reflection.AddVariable("uvOffset", 24, 8);
+	reflection.Finish();
+}
+
+static const uint32_t float2Format = 16, float3Format = 6, float4Format = 2; // DXGI_FORMAT_R32G32(B32(A32))_FLOAT
+
+static void AddVertexInputs(ShaderReflection& reflection)
+{
+	reflection.AddInputElement("POSITION", 0, float3Format, false);
+	reflection.AddInputElement("TEXCOORD", 0, float2Format, false);
+	reflection.AddInputElement("NORMAL", 0, float3Format, false);
+	reflection.AddInputElement("TANGENT", 0, float3Format, false);
+}
+
+// InstancedVS: no constant buffers, every matrix per instance
+static void BuildVertexShaderFixture(ShaderReflection& reflection)
+{
+	AddVertexInputs(reflection);
+	for (uint32_t i = 0; i < 4; i++)
+		reflection.AddInputElement("WORLD_PER_INSTANCE", i, float4Format, true);
+	for (uint32_t i = 0; i < 4; i++)
+		reflection.AddInputElement("WORLD_INV_TRANSPOSE_PER_INSTANCE", i, float4Format, true);
+	for (uint32_t i = 0; i < 4; i++)
+		reflection.AddInputElement("WORLD_VIEW_PROJECTION_PER_INSTANCE", i, float4Format, true);
+	reflection.Finish();
+}
+
+// VertexShader: the same matrices as one PerObject buffer
+static void BuildObjectVertexShaderFixture(ShaderReflection& reflection)
+{
+	reflection.AddBuffer("PerObject", 0, 2, 192);
+	reflection.AddVariable("worldViewProjection", 0, 64);
+	reflection.AddVariable("world", 64, 64);
+	reflection.AddVariable("worldInvTranspose", 128, 64);
+
+	AddVertexInputs(reflection);
+	reflection.Finish();
+}
+
+// Whether every record and name lookup in a matches b
+static bool SameReflection(const ShaderReflection& a, const ShaderReflection& b)
+{
+	if (a.GetBufferCount() != b.GetBufferCount() ||
+		a.GetVariableCount() != b.GetVariableCount() ||
+		a.GetResourceCount() != b.GetResourceCount() ||
+		a.GetInputElementCount() != b.GetInputElementCount())
+		return false;
+
+	for (size_t i = 0; i < a.GetBufferCount(); i++)
+	{
+		const ShaderReflection::Buffer& x = a.GetBuffer(i);
+		const ShaderReflection::Buffer& y = b.GetBuffer(i);
+		const char* name = a.GetString(x.Name);
+		if (strcmp(name, b.GetString(y.Name)) != 0 || x.Type != y.Type || x.BindIndex != y.BindIndex || x.Size != y.Size ||
+			x.FirstVariable != y.FirstVariable || x.VariableCount != y.VariableCount ||
+			b.FindBuffer(ShaderReflection::HashName(name), name) != i)
+			return false;
+	}
+	for (size_t i = 0; i < a.GetVariableCount(); i++)
+	{
+		const ShaderReflection::Variable& x = a.GetVariable(i);
+		const ShaderReflection::Variable& y = b.GetVariable(i);
+		const char* name = a.GetString(x.Name);
+		if (strcmp(name, b.GetString(y.Name)) != 0 || x.Buffer != y.Buffer || x.ByteOffset != y.ByteOffset || x.Size != y.Size ||
+			b.FindVariable(ShaderReflection::HashName(name), name) != i)
+			return false;
+	}
+	for (size_t i = 0; i < a.GetResourceCount(); i++)
+	{
+		const ShaderReflection::Resource& x = a.GetResource(i);
+		const ShaderReflection::Resource& y = b.GetResource(i);
+		const char* name = a.GetString(x.Name);
+		if (strcmp(name, b.GetString(y.Name)) != 0 || x.Type != y.Type || x.BindIndex != y.BindIndex || x.Index != y.Index ||
+			b.FindResource((ShaderReflection::ResourceType)x.Type, ShaderReflection::HashName(name), name) != i)
+			return false;
+	}
+	for (size_t i = 0; i < a.GetInputElementCount(); i++)
+	{
+		const ShaderReflection::InputElement& x = a.GetInputElement(i);
+		const ShaderReflection::InputElement& y = b.GetInputElement(i);
+		if (strcmp(a.GetString(x.SemanticName), b.GetString(y.SemanticName)) != 0 ||
+			x.SemanticIndex != y.SemanticIndex || x.Format != y.Format || x.PerInstance != y.PerInstance)
+			return false;
+	}
+	return true;
+}
+
+static int RunShaderReflectionCheck()
+{
+	ShaderReflection pixel, vertex;
+	BuildPixelShaderFixture(pixel);
+	BuildVertexShaderFixture(vertex);
+
+	// Stand-ins for the bytecode the cache is keyed by
+	const char pixelCode[] = "CelShadingPixel.cso";
+	const char vertexCode[] = "InstancedVS.cso";
+	uint64_t pixelHash = HashBytes(pixelCode, sizeof(pixelCode));
+	uint64_t vertexHash = HashBytes(vertexCode, sizeof(vertexCode));
+
+	std::vector<char> pixelData, vertexData;
+	pixel.Write(pixelData, pixelHash, sizeof(pixelCode));
+	vertex.Write(vertexData, vertexHash, sizeof(vertexCode));
+
+	ShaderReflection loaded;
+	if (!loaded.Read(pixelData.data(), pixelData.size(), pixelHash, sizeof(pixelCode)) || !SameReflection(pixel, loaded))
+	{
+		printf("Pixel shader reflection didn't survive a round trip\n");
+		return 1;
+	}
+
+	// Misses, including a name of the wrong resource type
+	uint32_t notFound = ShaderReflection::NotFound;
+	if (loaded.FindVariable(ShaderReflection::HashName("view"), "view") != notFound ||
+		loaded.FindBuffer(ShaderReflection::HashName("PerObject"), "PerObject") != notFound ||
+		loaded.FindResource(ShaderReflection::Sampler, ShaderReflection::HashName("Albedo"), "Albedo") != notFound ||
+		loaded.GetResource(loaded.FindResource(ShaderReflection::Texture, ShaderReflection::HashName("CelRamp"), "CelRamp")).Index != 3)
+	{
+		printf("Pixel shader lookups found the wrong things\n");
+		return 1;
+	}
+
+	if (!loaded.Read(vertexData.data(), vertexData.size(), vertexHash, sizeof(vertexCode)) || !SameReflection(vertex, loaded))
+	{
+		printf("Vertex shader reflection didn't survive a round trip\n");
+		return 1;
+	}
+
+	// Anything that doesn't match exactly has to be rejected, and leave nothing behind
+	std::vector<char> corrupt = pixelData;
+	size_t stringOffset = sizeof(ShaderReflectionHeader);
+	uint32_t badOffset = 0xFFFF;
+	memcpy(&corrupt[stringOffset], &badOffset, sizeof(badOffset)); // The first buffer's name
+	struct { const char* What; bool Accepted; } rejections[] = {
+		{ "a different shader's hash", loaded.Read(pixelData.data(), pixelData.size(), vertexHash, sizeof(pixelCode)) },
+		{ "a different bytecode size", loaded.Read(pixelData.data(), pixelData.size(), pixelHash, sizeof(pixelCode) + 1) },
+		{ "a truncated file", loaded.Read(pixelData.data(), pixelData.size() - 1, pixelHash, sizeof(pixelCode)) },
+		{ "just a header", loaded.Read(pixelData.data(), sizeof(ShaderReflectionHeader), pixelHash, sizeof(pixelCode)) },
+		{ "a corrupted name offset", loaded.Read(corrupt.data(), corrupt.size(), pixelHash, sizeof(pixelCode)) },
+	};
+	for (auto& rejection : rejections)
+	{
+		if (rejection.Accepted)
+		{
+			printf("Accepted a cache with %s\n", rejection.What);
+			return 1;
+		}
+	}
+	if (loaded.GetBufferCount() != 0 || loaded.GetVariableCount() != 0)
+	{
+		printf("A rejected cache left data behind\n");
+		return 1;
+	}
+
+	// Through a real file, like SimpleShader does
+	std::wstring cacheFile = ShaderReflection::GetCachePath((std::filesystem::temp_directory_path() / "HeadlessPixelShader.cso").wstring());
+	if (!pixel.Save(cacheFile, pixelHash, sizeof(pixelCode)) ||
+		!loaded.Load(cacheFile, pixelHash, sizeof(pixelCode)) ||
+		!SameReflection(pixel, loaded) ||
+		loaded.Load(cacheFile, vertexHash, sizeof(pixelCode)))
+	{
+		printf("Pixel shader reflection didn't survive a save and load\n");
+		return 1;
+	}
+
+	// Loading from memory vs building from scratch (which still skips D3DReflect() itself)
+	const int repeats = 10000;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < repeats; i++)
+		loaded.Read(pixelData.data(), pixelData.size(), pixelHash, sizeof(pixelCode));
+	double readTime = SecondsSince(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < repeats; i++)
+	{
+		loaded.Clear();
+		BuildPixelShaderFixture(loaded);
+	}
+	double buildTime = SecondsSince(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < repeats; i++)
+		loaded.Load(cacheFile, pixelHash, sizeof(pixelCode));
+	double loadTime = SecondsSince(start);
+	std::filesystem::remove(cacheFile);
+
+	printf("Reflection caches round trip: %zu byte pixel shader, %zu byte vertex shader\n", pixelData.size(), vertexData.size());
+	printf("  read from memory: %8.3f us\n", readTime / repeats * 1000000.0);
+	printf("  load from file:   %8.3f us\n", loadTime / repeats * 1000000.0);
+	printf("  build and sort:   %8.3f us\n", buildTime / repeats * 1000000.0);
+	return 0;
+}
+
+// --------------------------------------------------------
+// Checks the structs generated into ShaderConstants.h
+// against the reflection fixtures above, which are what
+// D3D itself reports: every variable at the same offset
+// and size, and every struct the size of its buffer
+// --------------------------------------------------------
+static int RunShaderConstantsCheck()
+{
+	struct Field { const char* Name; size_t Offset; size_t Size; };
+#define FIELD(type, member) { #member, offsetof(type, member), sizeof(type::member) }
+	const Field pixelFrame[] = {
+		FIELD(ClusteredLightingPerFrame, cameraPosition),
+		FIELD(ClusteredLightingPerFrame, clusterDepthScale),
+		FIELD(ClusteredLightingPerFrame, ambient),
+		FIELD(ClusteredLightingPerFrame, clusterDepthBias),
+		FIELD(ClusteredLightingPerFrame, clusterTileScale),
+		FIELD(ClusteredLightingPerFrame, globalLightCount),
+		FIELD(ClusteredLightingPerFrame, clusterCounts) };
+	const Field pixelMaterial[] = {
+		FIELD(CelShadingPixelPerMaterial, colorTint),
+		FIELD(CelShadingPixelPerMaterial, roughness),
+		FIELD(CelShadingPixelPerMaterial, uvScale),
+		FIELD(CelShadingPixelPerMaterial, uvOffset) };
+	const Field vertexObject[] = {
+		FIELD(VertexShaderPerObject, worldViewProjection),
+		FIELD(VertexShaderPerObject, world),
+		FIELD(VertexShaderPerObject, worldInvTranspose) };
+#undef FIELD
+
+	struct Buffer { const ShaderReflection* Reflection; const char* Name; size_t Size; const Field* Fields; size_t FieldCount; };
+	ShaderReflection pixel, vertex;
+	BuildPixelShaderFixture(pixel);
+	BuildObjectVertexShaderFixture(vertex);
+	const Buffer buffers[] = {
+		{ &pixel, ClusteredLightingPerFrame::BufferName, sizeof(ClusteredLightingPerFrame), pixelFrame, std::size(pixelFrame) },
+		{ &pixel, CelShadingPixelPerMaterial::BufferName, sizeof(CelShadingPixelPerMaterial), pixelMaterial, std::size(pixelMaterial) },
+		{ &vertex, VertexShaderPerObject::BufferName, sizeof(VertexShaderPerObject), vertexObject, std::size(vertexObject) },
+	};
+
+	for (const Buffer& buffer : buffers)
+	{
+		uint32_t b = buffer.Reflection->FindBuffer(ShaderReflection::HashName(buffer.Name), buffer.Name);
+		if (b == ShaderReflection::NotFound || buffer.Reflection->GetBuffer(b).Size != buffer.Size ||
+			buffer.Reflection->GetBuffer(b).VariableCount != buffer.FieldCount)
+		{
+			printf("Generated %s doesn't match the shader's buffer\n", buffer.Name);
+			return 1;
+		}
+
+		for (size_t f = 0; f < buffer.FieldCount; f++)
+		{
+			const Field& field = buffer.Fields[f];
+			uint32_t v = buffer.Reflection->FindVariable(ShaderReflection::HashName(field.Name), field.Name);
+			if (v == ShaderReflection::NotFound ||
+				buffer.Reflection->GetVariable(v).ByteOffset != field.Offset ||
+				buffer.Reflection->GetVariable(v).Size != field.Size)
+			{
+				printf("Generated %s.%s doesn't match the shader's variable\n", buffer.Name, field.Name);
+				return 1;
+			}
+		}
+	}
+
+	printf("ShaderConstants.h matches the reflected layouts of %zu buffers\n", std::size(buffers));
+	return 0;
+}
+
+// --------------------------------------------------------
+// Bins N point and spot lights, plus two directional ones,
+// into LightClusters from Game's camera, then checks:
+//  - the directional lights lead the index list, and the
+//    clusters' lists follow back to back, in light order
+//  - every light listed touches its cluster's box
+//  - a point anywhere in view finds, through its cluster,
+//    every light whose range reaches it
+// --------------------------------------------------------
+static int RunLightClusterCheck(size_t lightCount)
+{
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> spread(-120.0f, 120.0f);
+	std::uniform_real_distribution<float> heights(-10.0f, 30.0f);
+	std::uniform_real_distribution<float> ranges(2.0f, 12.0f);
+	std::vector<Light> lights(lightCount + 2);
+	size_t directional[2] = { 0, lights.size() / 2 };
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		Light& light = lights[i];
+		light.Type = i == directional[0] || i == directional[1] ? LIGHT_TYPE_DIRECTIONAL : (i % 4 == 0 ? LIGHT_TYPE_SPOT : LIGHT_TYPE_POINT);
+		light.Direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+		light.Position = XMFLOAT3(spread(random), heights(random), spread(random));
+		light.Range = ranges(random);
+		light.Intensity = 1.0f;
+	}
+
+	Camera camera(0.0f, 10.0f, -55.0f, 16.0f / 9.0f, 5.0f, 5.0f, XM_PI / 3, 0.01f, 150.0f, true);
+	XMFLOAT4X4 view = camera.GetView();
+	XMFLOAT4X4 projection = camera.GetProjection();
+	LightClusters clusters;
+	clusters.Build(view, projection, lights.data(), lights.size());
+
+	const LightCluster* cluster = clusters.GetClusters();
+	const uint32_t* indices = clusters.GetLightIndices();
+	if (clusters.GetGlobalLightCount() != 2 || indices[0] != directional[0] || indices[1] != directional[1])
+	{
+		printf("Directional lights aren't at the front of the index list\n");
+		return 1;
+	}
+
+	std::vector<XMFLOAT3> viewCenters(lights.size());
+	XMMATRIX viewMat = XMLoadFloat4x4(&view);
+	for (size_t i = 0; i < lights.size(); i++)
+		XMStoreFloat3(&viewCenters[i], XMVector3TransformCoord(XMLoadFloat3(&lights[i].Position), viewMat));
+
+	uint32_t offset = clusters.GetGlobalLightCount();
+	size_t maxPerCluster = 0, usedClusters = 0;
+	for (uint32_t c = 0; c < LightClusters::ClusterCount; c++)
+	{
+		if (cluster[c].Offset != offset)
+		{
+			printf("Cluster %u's list isn't straight after the one before\n", c);
+			return 1;
+		}
+		offset += cluster[c].Count;
+		maxPerCluster = std::max<size_t>(maxPerCluster, cluster[c].Count);
+		usedClusters += cluster[c].Count > 0;
+
+		XMFLOAT3 boundsMin, boundsMax;
+		clusters.GetClusterBounds(c, boundsMin, boundsMax);
+		for (uint32_t n = 0; n < cluster[c].Count; n++)
+		{
+			uint32_t l = indices[cluster[c].Offset + n];
+			const XMFLOAT3& center = viewCenters[l];
+			float dx = std::max(std::max(boundsMin.x - center.x, center.x - boundsMax.x), 0.0f);
+			float dy = std::max(std::max(boundsMin.y - center.y, center.y - boundsMax.y), 0.0f);
+			float dz = std::max(std::max(boundsMin.z - center.z, center.z - boundsMax.z), 0.0f);
+			if (lights[l].Type == LIGHT_TYPE_DIRECTIONAL ||
+				(n > 0 && l <= indices[cluster[c].Offset + n - 1]) ||
+				dx * dx + dy * dy + dz * dz > lights[l].Range * lights[l].Range * 1.0001f)
+			{
+				printf("Cluster %u lists light %u, which doesn't belong there\n", c, l);
+				return 1;
+			}
+		}
+	}
+	if (offset != clusters.GetLightIndexCount())
+	{
+		printf("The index list is %zu long, not %u\n", clusters.GetLightIndexCount(), offset);
+		return 1;
+	}
+
+	// Points spread through the view, evenly in screen space and in log depth like the slices.
+	// Lights that only just reach a point are skipped, as float noise could go either way.
+	const int sampleCount = 20000;
+	std::uniform_real_distribution<float> screen(0.0f, 1.0f);
+	std::uniform_real_distribution<float> logDepths(logf(0.01f), logf(150.0f));
+	size_t reached = 0;
+	for (int s = 0; s < sampleCount; s++)
+	{
+		float u = screen(random), v = screen(random), depth = expf(logDepths(random));
+		XMFLOAT3 point((u * 2.0f - 1.0f) * depth / projection._11, (1.0f - v * 2.0f) * depth / projection._22, depth);
+		const LightCluster& found = cluster[clusters.FindCluster(u, v, depth)];
+		const uint32_t* first = indices + found.Offset;
+		const uint32_t* last = first + found.Count;
+
+		for (size_t l = 0; l < lights.size(); l++)
+		{
+			if (lights[l].Type == LIGHT_TYPE_DIRECTIONAL)
+				continue;
+			float dx = point.x - viewCenters[l].x, dy = point.y - viewCenters[l].y, dz = point.z - viewCenters[l].z;
+			float range = lights[l].Range * 0.999f;
+			if (dx * dx + dy * dy + dz * dz >= range * range)
+				continue;
+
+			reached++;
+			if (!std::binary_search(first, last, (uint32_t)l))
+			{
+				printf("A point at (%f, %f) depth %f is missing light %zu\n", u, v, depth, l);
+				return 1;
+			}
+		}
+	}
+
+	// Enough repeats that small counts still take measurable time
+	int repeats = (int)std::max<size_t>(1, 200000 / lights.size());
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < repeats; i++)
+		clusters.Build(view, projection, lights.data(), lights.size());
+	double buildTime = SecondsSince(start) / repeats;
+
+	size_t binned = clusters.GetLightIndexCount() - clusters.GetGlobalLightCount();
+	printf("%zu lights in %u clusters:\n", lights.size(), LightClusters::ClusterCount);
+	printf("  build:    %10.3f ms\n", buildTime * 1000.0);
+	printf("  indices:  %10zu (%zu clusters lit, %.1f lights each on average, %zu at most)\n",
+		clusters.GetLightIndexCount(), usedClusters, usedClusters ? (double)binned / usedClusters : 0.0, maxPerCluster);
+	printf("  %d points checked, reached by %zu lights in all\n", sampleCount, reached);
+	return 0;
+}
+
+// --------------------------------------------------------
+// Times the per-frame world-view-projection pass over the
+// visible ones of N scattered objects: one multiply chain
+// per object the obvious way, against the batched pass
+// Game::Draw() uses, which has to give the same matrices
+// --------------------------------------------------------
+static int RunWorldViewProjectionBenchmark(size_t objectCount)
+{
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> positions(-150.0f, 150.0f);
+	std::uniform_real_distribution<float> angles(-XM_PI, XM_PI);
+	std::uniform_real_distribution<float> scales(0.5f, 4.0f);
+	TransformStore scene;
+	scene.Reserve(objectCount);
+	for (size_t i = 0; i < objectCount; i++)
+	{
+		TransformStore::Handle h = scene.Create();
+		scene.SetPosition(h, positions(random), positions(random), positions(random));
+		scene.SetRotation(h, angles(random), angles(random), angles(random));
+		scene.SetScale(h, scales(random), scales(random), scales(random));
+	}
+	scene.UpdateMatrices();
+
+	Camera camera(0.0f, 40.0f, -180.0f, 16.0f / 9.0f, 5.0f, 5.0f, XM_PI / 3, 0.01f, 400.0f, true);
+	XMFLOAT4X4 view = camera.GetView();
+	XMFLOAT4X4 projection = camera.GetProjection();
+	XMFLOAT3 boundsCenter(0, 0, 0);
+	XMFLOAT3 boundsExtents(1, 1, 1);
+
+	FrustumCuller culler;
+	culler.Begin(view, projection);
+	for (size_t i = 0; i < objectCount; i++)
+		culler.Add(boundsCenter, boundsExtents, scene.GetWorldMatrix((TransformStore::Handle)i));
+	culler.Cull();
+
+	std::vector<TransformStore::Handle> visible;
+	for (size_t i = 0; i < objectCount; i++)
+	{
+		if (culler.IsVisible(i))
+			visible.push_back((TransformStore::Handle)i);
+	}
+	size_t visibleCount = visible.size();
+	std::vector<XMFLOAT4X4> chained(visibleCount), batched(visibleCount);
+
+	// Enough repeats that small counts still take measurable time
+	int repeats = (int)std::max<size_t>(1, 2000000 / std::max<size_t>(1, visibleCount));
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeats; r++)
+	{
+		for (size_t n = 0; n < visibleCount; n++)
+		{
+			XMMATRIX world = XMLoadFloat4x4(&scene.GetWorldMatrix(visible[n]));
+			XMStoreFloat4x4(&chained[n], XMMatrixMultiply(world, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection))));
+		}
+	}
+	double chainedTime = SecondsSince(start) / repeats;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeats; r++)
+	{
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+		ComputeWorldViewProjections(viewProjection, scene.GetWorldMatrices(), visible.data(), visibleCount, batched.data());
+	}
+	double batchedTime = SecondsSince(start) / repeats;
+
+	float maxDifference = 0.0f;
+	for (size_t n = 0; n < visibleCount; n++)
+		maxDifference = std::max(maxDifference, MaxDifference(chained[n], batched[n]));
+
+	printf("World-view-projection for %zu of %zu objects:\n", visibleCount, objectCount);
+	printf("  chained per object: %10.3f ms\n", chainedTime * 1000.0);
+	printf("  batched:            %10.3f ms (%.2fx)\n", batchedTime * 1000.0, chainedTime / std::max(batchedTime, 1e-9));
+	printf("  uploaded:           %10.1f MB per frame (%zu bytes per object, no per-frame vertex buffer)\n",
+		visibleCount * sizeof(VertexShaderPerObject) / (1024.0 * 1024.0), sizeof(VertexShaderPerObject));
+	printf("  max difference %g\n", maxDifference);
+
+	// Same products in a different order, so only float noise apart
+	if (maxDifference > 1e-3f)
+	{
+		printf("Batched world-view-projections don't match\n");
+		return 1;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------
+// Stress tests the job system with nested jobs, RunAfter()
+// chains and ParallelFor(), then times a frame's transform
+// flush, culling and world-view-projection pass over N
+// objects with 1, 2, 4... threads (up to --threads, or one
+// per core), checking every run matches one thread's
+// --------------------------------------------------------
+static int RunJobSystemCheck(size_t objectCount, unsigned int maxThreads)
+{
+	if (maxThreads == 0)
+		maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	// At least a few threads, so stealing happens even on one core
+	{
+		JobSystem jobs(std::max(maxThreads, 4u));
+		static const size_t Parents = 64;
+		static const size_t Children = 32;
+		static const size_t ChainLength = 8;
+		std::vector<std::atomic<int>> runs(Parents * (Children + 1));
+		int failures = 0;
+
+		for (int round = 0; round < 200; round++)
+		{
+			for (auto& r : runs)
+				r.store(0);
+
+			// Parents queue their children from inside a job, on the same counter
+			JobCounter spawned;
+			for (size_t p = 0; p < Parents; p++)
+			{
+				jobs.Run([&, p]() {
+					runs[p * (Children + 1)]++;
+					for (size_t c = 1; c <= Children; c++)
+						jobs.Run([&runs, p, c]() { runs[p * (Children + 1) + c]++; }, &spawned);
+				}, &spawned);
+			}
+
+			// These can only start once every parent and child has run
+			std::atomic<int> early(0);
+			JobCounter followers;
+			for (size_t p = 0; p < Parents; p++)
+			{
+				jobs.RunAfter(spawned, [&]() {
+					for (auto& r : runs)
+					{
+						if (r.load() != 1)
+							early++;
+					}
+				}, &followers);
+			}
+
+			// Each link of the chain checks the one before it ran first
+			std::atomic<size_t> step(0);
+			std::atomic<int> outOfOrder(0);
+			std::vector<std::unique_ptr<JobCounter>> chain;
+			for (size_t i = 0; i < ChainLength; i++)
+			{
+				chain.push_back(std::make_unique<JobCounter>());
+				auto link = [&step, &outOfOrder, i]() {
+					if (step.fetch_add(1) != i)
+						outOfOrder++;
+				};
+				if (i == 0)
+					jobs.Run(link, chain[i].get());
+				else
+					jobs.RunAfter(*chain[i - 1], link, chain[i].get());
+			}
+
+			jobs.Wait(followers);
+			jobs.Wait(*chain.back());
+
+			size_t wrongCounts = 0;
+			for (auto& r : runs)
+				wrongCounts += r.load() != 1;
+			if (wrongCounts > 0 || early.load() > 0 || outOfOrder.load() > 0 || step.load() != ChainLength)
+			{
+				printf("Round %d: %zu jobs didn't run exactly once, %d ran before their dependency, %d chain links out of order\n",
+					round, wrongCounts, early.load(), outOfOrder.load());
+				failures++;
+			}
+		}
+
+		std::vector<uint32_t> values(1000003);
+		for (size_t i = 0; i < values.size(); i++)
+			values[i] = (uint32_t)(i * 2654435761u);
+		std::vector<uint8_t> visits(values.size(), 0);
+		std::atomic<uint64_t> sum(0);
+		jobs.ParallelFor(values.size(), 1000, [&](size_t begin, size_t end) {
+			uint64_t partial = 0;
+			for (size_t i = begin; i < end; i++)
+			{
+				partial += values[i];
+				visits[i]++;
+			}
+			sum += partial;
+		});
+		uint64_t expected = 0;
+		for (uint32_t v : values)
+			expected += v;
+		bool visitedOnce = std::all_of(visits.begin(), visits.end(), [](uint8_t v) { return v == 1; });
+		if (sum.load() != expected || !visitedOnce)
+		{
+			printf("ParallelFor didn't cover the range exactly once\n");
+			failures++;
+		}
+
+		printf("Job system (%zu threads): %zu jobs per round over 200 rounds, %zu steals, %s\n",
+			jobs.GetThreadCount(), Parents * (Children + 2) + ChainLength, jobs.GetStealCount(),
+			failures == 0 ? "all ran once and in order" : "FAILED");
+		if (failures > 0)
+			return 1;
+	}
+
+	// Jobs still queued when the system goes away run first
+	for (unsigned int threads : { 1u, std::max(maxThreads, 2u) })
+	{
+		std::atomic<int> ran(0);
+		{
+			JobSystem jobs(threads);
+			for (int i = 0; i < 1000; i++)
+				jobs.Run([&ran]() { ran++; });
+		}
+		if (ran.load() != 1000)
+		{
+			printf("Only %d of 1000 queued jobs ran before shutdown (%u threads)\n", ran.load(), threads);
+			return 1;
+		}
+	}
+
+	Camera camera(0.0f, 40.0f, -180.0f, 16.0f / 9.0f, 5.0f, 5.0f, XM_PI / 3, 0.01f, 400.0f, true);
+	XMFLOAT4X4 view = camera.GetView();
+	XMFLOAT4X4 projection = camera.GetProjection();
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+	XMFLOAT3 boundsCenter(0, 0, 0);
+	XMFLOAT3 boundsExtents(1, 1, 1);
+	const int Frames = 20;
+
+	std::vector<XMFLOAT4X4> referenceWorlds, referenceResults;
+	std::vector<bool> referenceVisible;
+	double serialTime = 0.0;
+
+	printf("Frame work for %zu objects:\n", objectCount);
+	for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> positions(-150.0f, 150.0f);
+		std::uniform_real_distribution<float> angles(-XM_PI, XM_PI);
+		TransformStore scene;
+		scene.Reserve(objectCount);
+		for (size_t i = 0; i < objectCount; i++)
+		{
+			TransformStore::Handle h = scene.Create();
+			scene.SetPosition(h, positions(random), positions(random), positions(random));
+			scene.SetRotation(h, angles(random), angles(random), angles(random));
+		}
+
+		JobSystem jobs(threads);
+		FrustumCuller culler;
+		std::vector<TransformStore::Handle> visible;
+		std::vector<XMFLOAT4X4> results;
+		double updateTime = 0.0, cullTime = 0.0, wvpTime = 0.0;
+
+		for (int frame = 0; frame < Frames; frame++)
+		{
+			// Everything moves each frame
+			for (size_t i = 0; i < objectCount; i++)
+				scene.Rotate((TransformStore::Handle)i, 0.01f, 0.02f, 0.0f);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			scene.UpdateMatrices(&jobs);
+			updateTime += SecondsSince(start);
+
+			culler.Begin(view, projection);
+			for (size_t i = 0; i < objectCount; i++)
+				culler.Add(boundsCenter, boundsExtents, scene.GetWorldMatrix((TransformStore::Handle)i));
+			start = std::chrono::high_resolution_clock::now();
+			culler.Cull(&jobs);
+			cullTime += SecondsSince(start);
+
+			visible.clear();
+			for (size_t i = 0; i < objectCount; i++)
+			{
+				if (culler.IsVisible(i))
+					visible.push_back((TransformStore::Handle)i);
+			}
+			results.resize(visible.size());
+			start = std::chrono::high_resolution_clock::now();
+			jobs.ParallelFor(visible.size(), 1024, [&](size_t begin, size_t end) {
+				ComputeWorldViewProjections(viewProjection, scene.GetWorldMatrices(), visible.data() + begin, end - begin, results.data() + begin);
+			});
+			wvpTime += SecondsSince(start);
+		}
+
+		std::vector<XMFLOAT4X4> worlds(scene.GetWorldMatrices(), scene.GetWorldMatrices() + objectCount);
+		std::vector<bool> visibleFlags(objectCount);
+		for (size_t i = 0; i < objectCount; i++)
+			visibleFlags[i] = culler.IsVisible(i);
+
+		double total = (updateTime + cullTime + wvpTime) / Frames;
+		bool identical = true;
+		if (threads == 1)
+		{
+			referenceWorlds = worlds;
+			referenceResults = results;
+			referenceVisible = visibleFlags;
+			serialTime = total;
+		}
+		else
+		{
+			identical =
+				visibleFlags == referenceVisible &&
+				results.size() == referenceResults.size() &&
+				memcmp(worlds.data(), referenceWorlds.data(), sizeof(XMFLOAT4X4) * objectCount) == 0 &&
+				memcmp(results.data(), referenceResults.data(), sizeof(XMFLOAT4X4) * results.size()) == 0;
+		}
+
+		printf("%2u threads: update %7.3f ms, cull %7.3f ms, wvp %7.3f ms, total %7.3f ms (%.2fx), %zu steals%s\n",
+			threads, updateTime * 1000.0 / Frames, cullTime * 1000.0 / Frames, wvpTime * 1000.0 / Frames,
+			total * 1000.0, serialTime / std::max(total, 1e-9), jobs.GetStealCount(),
+			identical ? "" : " - OUTPUT DIFFERS");
+		if (!identical)
+			return 1;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------
+// Runs N objects on 64 orbits through a frame's update and
+// render work, first one after the other on one thread as
+// DXCore::Run() does, then pipelined through FramePipeline
+// with rendering on its own thread, as Game does
+// - Update: orbits and spins, the transform flush, and the
+//   render snapshot
+// - Render: light clusters, culling, the sorted draw queue
+//   and world-view-projections, all from the snapshot
+// - Checks both runs draw the same frames, in order, and
+//   measures how much of each frame's drawing overlapped
+//   the next frame's update
+// - Then leaves a pipeline idle and checks the render
+//   thread sleeps through it instead of spinning
+// --------------------------------------------------------
+static int RunPipelineBenchmark(size_t objectCount)
+{
+	const int Frames = 200;
+	const size_t LightCount = 500;
+	const size_t OrbitCount = 64;
+	const float deltaTime = 1.0f / 60.0f;
+
+	struct Simulation
+	{
+		TransformStore Scene;
+		OrbitSystem Orbits;
+		std::vector<TransformStore::Handle> Nodes;
+		std::vector<PixelShaderPerMaterial> Materials;
+		std::vector<Light> Lights;
+		Camera Eye = Camera(0.0f, 40.0f, -180.0f, 16.0f / 9.0f, 5.0f, 5.0f, XM_PI / 3, 0.01f, 400.0f, true);
+	};
+	auto createSimulation = [&](Simulation& sim) {
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> offsets(-20.0f, 20.0f);
+		std::uniform_real_distribution<float> radii(10.0f, 150.0f);
+		std::uniform_real_distribution<float> speeds(5.0f, 60.0f);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		TransformStore::Handle root = sim.Scene.Create();
+		std::vector<TransformStore::Handle> orbits;
+		for (size_t o = 0; o < OrbitCount; o++)
+			orbits.push_back(sim.Orbits.AddOrbit(sim.Scene, root, radii(random), speeds(random)));
+
+		sim.Scene.Reserve(objectCount + OrbitCount + 1);
+		for (size_t i = 0; i < objectCount; i++)
+		{
+			TransformStore::Handle h = sim.Scene.Create(orbits[i % OrbitCount]);
+			sim.Scene.SetPosition(h, offsets(random), offsets(random), offsets(random));
+			sim.Nodes.push_back(h);
+
+			PixelShaderPerMaterial material = {};
+			material.colorTint = XMFLOAT3(unit(random), unit(random), unit(random));
+			material.roughness = unit(random);
+			material.uvScale = XMFLOAT2(1, 1);
+			sim.Materials.push_back(material);
+		}
+
+		sim.Lights.resize(LightCount);
+		for (size_t i = 0; i < LightCount; i++)
+		{
+			Light& light = sim.Lights[i];
+			light.Type = i == 0 ? LIGHT_TYPE_DIRECTIONAL : LIGHT_TYPE_POINT;
+			light.Direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+			light.Position = XMFLOAT3(offsets(random) * 7.0f, offsets(random), offsets(random) * 7.0f);
+			light.Range = 4.0f + unit(random) * 8.0f;
+			light.Intensity = 1.0f;
+		}
+	};
+	auto simulate = [&](Simulation& sim) {
+		sim.Orbits.Update(sim.Scene, deltaTime);
+		for (TransformStore::Handle h : sim.Nodes)
+			sim.Scene.Rotate(h, 0.0f, deltaTime, 0.0f);
+		sim.Scene.UpdateMatrices();
+		sim.Eye.UpdateViewMatrix();
+	};
+	auto capture = [&](Simulation& sim, int frame, RenderSnapshot& snapshot) {
+		snapshot.Frame = (uint64_t)frame;
+		snapshot.DeltaTime = deltaTime;
+		snapshot.TotalTime = frame * deltaTime;
+		snapshot.View = sim.Eye.GetView();
+		snapshot.Projection = sim.Eye.GetProjection();
+		snapshot.CameraPosition = sim.Eye.GetTransform()->GetPosition();
+		CaptureTransforms(sim.Scene, sim.Nodes.data(), sim.Nodes.size(), snapshot);
+		snapshot.Materials = sim.Materials;
+		snapshot.Lights = sim.Lights;
+	};
+
+	// Stand-ins for shaders, materials and meshes, as RenderQueue only compares addresses
+	const int materialCount = 40, meshCount = 25;
+	std::vector<char> objects(2 + 3 + materialCount + meshCount);
+	struct Renderer
+	{
+		LightClusters Clusters;
+		FrustumCuller Culler;
+		RenderQueue Queue;
+		std::vector<uint32_t> Visible;
+		std::vector<XMFLOAT4X4> WorldViewProjections;
+	};
+	XMFLOAT3 boundsCenter(0, 0, 0);
+	XMFLOAT3 boundsExtents(1, 1, 1);
+
+	// Returns a hash of everything the frame would upload, so runs can be compared
+	auto render = [&](Renderer& r, const RenderSnapshot& snapshot) {
+		r.Clusters.Build(snapshot.View, snapshot.Projection, snapshot.Lights.data(), snapshot.Lights.size());
+
+		r.Culler.Begin(snapshot.View, snapshot.Projection);
+		for (const XMFLOAT4X4& world : snapshot.Worlds)
+			r.Culler.Add(boundsCenter, boundsExtents, world);
+		r.Culler.Cull();
+
+		XMMATRIX viewMat = XMLoadFloat4x4(&snapshot.View);
+		r.Queue.Clear();
+		r.Visible.clear();
+		for (size_t i = 0; i < snapshot.Worlds.size(); i++)
+		{
+			if (!r.Culler.IsVisible(i))
+				continue;
+
+			const XMFLOAT4X4& world = snapshot.Worlds[i];
+			float depth = XMVectorGetZ(XMVector3TransformCoord(XMVectorSet(world._41, world._42, world._43, 1.0f), viewMat));
+			size_t material = i % materialCount;
+			r.Queue.Add((uint32_t)i, &objects[material % 2], &objects[2 + material % 3], &objects[5 + material], &objects[5 + materialCount + i % meshCount], depth);
+			r.Visible.push_back((uint32_t)i);
+		}
+		r.Queue.Sort();
+
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(viewMat, XMLoadFloat4x4(&snapshot.Projection)));
+		r.WorldViewProjections.resize(r.Visible.size());
+		ComputeWorldViewProjections(viewProjection, snapshot.Worlds.data(), r.Visible.data(), r.Visible.size(), r.WorldViewProjections.data());
+
+		uint64_t hash = 14695981039346656037ull;
+		auto hashBytes = [&hash](const void* data, size_t size) {
+			for (size_t b = 0; b < size; b++)
+				hash = (hash ^ static_cast<const uint8_t*>(data)[b]) * 1099511628211ull;
+		};
+		hashBytes(r.WorldViewProjections.data(), r.WorldViewProjections.size() * sizeof(XMFLOAT4X4));
+		hashBytes(r.Clusters.GetLightIndices(), r.Clusters.GetLightIndexCount() * sizeof(uint32_t));
+		r.Queue.SubmitBatches(
+			[](uint32_t) {},
+			[&](uint32_t i) { hashBytes(&snapshot.Materials[i], sizeof(PixelShaderPerMaterial)); },
+			[](uint32_t) {},
+			[&](const uint32_t* indices, size_t count) {
+				for (size_t n = 0; n < count; n++)
+					hashBytes(&snapshot.WorldInvTransposes[indices[n]], sizeof(XMFLOAT4X4));
+			});
+		return hash;
+	};
+
+	// One after the other, as DXCore::Run() calls Update() and Draw()
+	std::vector<uint64_t> serialHashes(Frames);
+	double updateTime = 0.0, renderTime = 0.0;
+	double serialTime;
+	{
+		Simulation sim;
+		createSimulation(sim);
+		Renderer renderer;
+		RenderSnapshot snapshot;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < Frames; frame++)
+		{
+			auto updateStart = std::chrono::high_resolution_clock::now();
+			simulate(sim);
+			capture(sim, frame, snapshot);
+			updateTime += SecondsSince(updateStart);
+
+			auto renderStart = std::chrono::high_resolution_clock::now();
+			serialHashes[frame] = render(renderer, snapshot);
+			renderTime += SecondsSince(renderStart);
+		}
+		serialTime = SecondsSince(start);
+	}
+
+	// Pipelined, with each stage's time span per frame
+	std::vector<uint64_t> pipelinedHashes(Frames);
+	std::vector<double> updateBegin(Frames), updateEnd(Frames), renderBegin(Frames), renderEnd(Frames);
+	size_t outOfOrder = 0;
+	size_t updateStalls, renderStalls;
+	double pipelinedTime;
+	{
+		Simulation sim;
+		createSimulation(sim);
+		Renderer renderer;
+		FramePipeline<RenderSnapshot> pipeline;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		std::thread renderThread([&]() {
+			uint64_t expected = 0;
+			while (RenderSnapshot* snapshot = pipeline.BeginRender())
+			{
+				size_t frame = (size_t)snapshot->Frame;
+				outOfOrder += snapshot->Frame != expected++;
+				renderBegin[frame] = SecondsSince(start);
+				pipelinedHashes[frame] = render(renderer, *snapshot);
+				renderEnd[frame] = SecondsSince(start);
+				pipeline.EndRender(snapshot);
+			}
+		});
+
+		for (int frame = 0; frame < Frames; frame++)
+		{
+			updateBegin[frame] = SecondsSince(start);
+			simulate(sim);
+			RenderSnapshot* snapshot = pipeline.BeginUpdate();
+			capture(sim, frame, *snapshot);
+			pipeline.EndUpdate(snapshot);
+			updateEnd[frame] = SecondsSince(start);
+		}
+		pipeline.Close();
+		renderThread.join();
+		pipelinedTime = SecondsSince(start);
+		updateStalls = pipeline.GetUpdateStalls();
+		renderStalls = pipeline.GetRenderStalls();
+	}
+
+	// How much of drawing frame f ran while frame f + 1 was updated
+	double overlapTime = 0.0, pipelinedRenderTime = 0.0;
+	size_t overlappedFrames = 0;
+	for (int frame = 0; frame < Frames; frame++)
+	{
+		pipelinedRenderTime += renderEnd[frame] - renderBegin[frame];
+		if (frame + 1 == Frames)
+			break;
+
+		double overlap = std::min(renderEnd[frame], updateEnd[frame + 1]) - std::max(renderBegin[frame], updateBegin[frame + 1]);
+		if (overlap > 0.0)
+		{
+			overlapTime += overlap;
+			overlappedFrames++;
+		}
+	}
+	bool identical = pipelinedHashes == serialHashes;
+
+	printf("Pipelined frames for %zu objects and %zu lights, %d frames:\n", objectCount, LightCount, Frames);
+	printf("  serial:    %8.3f ms per frame (update %.3f ms + render %.3f ms)\n",
+		serialTime * 1000.0 / Frames, updateTime * 1000.0 / Frames, renderTime * 1000.0 / Frames);
+	printf("  pipelined: %8.3f ms per frame (%.2fx, %.2fx at best)\n",
+		pipelinedTime * 1000.0 / Frames, serialTime / pipelinedTime, (updateTime + renderTime) / std::max(updateTime, renderTime));
+	printf("  %zu of %d frames drawn alongside the next update, overlapping %.1f%% of drawing\n",
+		overlappedFrames, Frames - 1, 100.0 * overlapTime / std::max(pipelinedRenderTime, 1e-9));
+	printf("  update waited for a free snapshot %zu times, render waited for a new one %zu times\n", updateStalls, renderStalls);
+
+	if (!identical || outOfOrder > 0)
+	{
+		printf("Pipelined frames don't match the serial ones (%zu out of order)\n", outOfOrder);
+		return 1;
+	}
+
+	// On one core the threads only take turns, so there's nothing to prove
+	if (std::thread::hardware_concurrency() > 1 && overlappedFrames == 0)
+	{
+		printf("Update and render never overlapped\n");
+		return 1;
+	}
+
+	// With nothing published for a while, the render thread has to go to
+	// sleep rather than spin, and still wake for the next frame and Close()
+	{
+		FramePipeline<RenderSnapshot> pipeline;
+		size_t drawn = 0;
+		std::thread renderThread([&]() {
+			while (RenderSnapshot* snapshot = pipeline.BeginRender())
+			{
+				drawn++;
+				pipeline.EndRender(snapshot);
+			}
+		});
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		RenderSnapshot* snapshot = pipeline.BeginUpdate();
+		pipeline.EndUpdate(snapshot);
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		pipeline.Close();
+		renderThread.join();
+
+		printf("  idle pipeline: render slept %zu times, drew %zu frame\n", pipeline.GetSleeps(), drawn);
+		if (pipeline.GetSleeps() < 2 || drawn != 1)
+		{
+			printf("The render thread didn't sleep through an idle pipeline\n");
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	int frameCount = 10000;
+	unsigned int threadCount = 0;
+	std::vector<std::string> objFiles;
+	std::string scalingFile;
+	std::string tangentFile;
+	std::vector<size_t> transformCounts;
+	size_t microCount = 0;
+	size_t hierarchyCount = 0;
+	bool deep = false;
+	size_t cullingCount = 0;
+	size_t bvhCount = 0;
+	size_t renderQueueCount = 0;
+	size_t instancingCount = 0;
+	bool textureCache = false;
+	size_t constantUploadCount = 0;
+	bool shaderReflection = false;
+	bool shaderConstants = false;
+	size_t worldViewProjectionCount = 0;
+	size_t lightClusterCount = 0;
+	size_t jobCount = 0;
+	size_t pipelineCount = 0;
+	bool cached = false;
+	bool async = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			frameCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threadCount = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--obj") == 0 && i + 1 < argc)
+			objFiles.push_back(argv[++i]);
+		else if (strcmp(argv[i], "--cached") == 0)
+			cached = true;
+		else if (strcmp(argv[i], "--async") == 0)
+			async = true;
+		else if (strcmp(argv[i], "--obj-scaling") == 0 && i + 1 < argc)
+			scalingFile = argv[++i];
+		else if (strcmp(argv[i], "--tangents") == 0 && i + 1 < argc)
+			tangentFile = argv[++i];
+		else if (strcmp(argv[i], "--transforms") == 0 && i + 1 < argc)
+			transformCounts.push_back((size_t)atoll(argv[++i]));
+		else if (strcmp(argv[i], "--transform-micro") == 0 && i + 1 < argc)
+			microCount = (size_t)atoll(argv[++i]);
+		else if (strcmp(argv[i], "--hierarchy") == 0 && i + 1 < argc)
+			hierarchyCount = (size_t)atoll(argv[++i]);
+		else if (strcmp(argv[i], "--deep") == 0)
+			deep = true;
+		else if (strcmp(argv[i], "--culling") == 0 && i + 1 < argc)
+			cullingCount = (size_t)atoll(argv[++i]);
+		else if (strcmp(argv[i], "--bvh") == 0 && i + 1 < argc)
+			bvhCount = (size_t)atoll(argv[++i]);
+		else if (strcmp(argv[i], "--render-queue") == 0 && i + 1 < argc)
+			renderQueueCount = (size_t)atoll(argv[++i]);
+		else if (strcmp(argv[i], "--instancing") == 0 && i + 1 < argc)
+			instancingCount = (size_t)atoll(argv[++i]);
+		else if (strcmp(argv[i], "--texture-cache") == 0)
+			textureCache = true;
+		else if (strcmp(argv[i], "--constant-uploads") == 0 && i + 1 < argc)
+			constantUploadCount = (size_t)atoll(argv[++i]);
+		else if (strcmp(argv[i], "--shader-reflection") == 0)
+			shaderReflection = true;
+		else if (strcmp(argv[i], "--shader-constants") == 0)
+			shaderConstants = true;
+		else if (strcmp(argv[i], "--wvp") == 0 && i + 1 < argc)
+			worldViewProjectionCount = (size_t)atoll(argv[++i]);
+		else if (strcmp(argv[i], "--light-clusters") == 0 && i + 1 < argc)
+			lightClusterCount = (size_t)atoll(argv[++i]);
+		else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+			jobCount = (size_t)atoll(argv[++i]);
+		else if (strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc)
+			pipelineCount = (size_t)atoll(argv[++i]);
+		else
+		{
+			printf("Usage: %s [--frames N] [--threads N] [--cached | --async] [--obj file.obj ...] [--obj-scaling file.obj] [--tangents file.obj] [--transforms N ...] [--transform-micro N] [--hierarchy N [--deep]] [--culling N] [--bvh N] [--render-queue N] [--instancing N] [--texture-cache] [--constant-uploads N] [--shader-reflection] [--shader-constants] [--wvp N] [--light-clusters N] [--jobs N] [--pipeline N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (!scalingFile.empty())
+		return RunObjScaling(scalingFile, threadCount);
+
+	if (!tangentFile.empty())
+		return RunTangentCheck(tangentFile, threadCount);
+
+	if (microCount > 0)
+		return RunTransformMicroBenchmark(microCount);
+
+	if (hierarchyCount > 0)
+		return RunHierarchyBenchmark(hierarchyCount, deep);
+
+	if (cullingCount > 0)
+		return RunCullingCheck(cullingCount);
+
+	if (bvhCount > 0)
+		return RunBVHBenchmark(bvhCount);
+
+	if (renderQueueCount > 0)
+		return RunRenderQueueCheck(renderQueueCount);
+
+	if (instancingCount > 0)
+		return RunInstancingBenchmark(instancingCount);
+
+	if (textureCache)
+		return RunTextureCacheCheck();
+
+	if (constantUploadCount > 0)
+		return RunConstantUploadCheck(constantUploadCount);
+
+	if (shaderReflection)
+		return RunShaderReflectionCheck();
+
+	if (shaderConstants)
+		return RunShaderConstantsCheck();
+
+	if (worldViewProjectionCount > 0)
+		return RunWorldViewProjectionBenchmark(worldViewProjectionCount);
+
+	if (lightClusterCount > 0)
+		return RunLightClusterCheck(lightClusterCount);
+
+	if (jobCount > 0)
+		return RunJobSystemCheck(jobCount, threadCount);
+
+	if (pipelineCount > 0)
+		return RunPipelineBenchmark(pipelineCount);
+
+	if (!transformCounts.empty())
+	{
+		for (size_t transformCount : transformCounts)
+		{
+			if (transformCount == 0 || RunTransformBenchmark(transformCount) != 0)
+				return 1;
+		}
+		return 0;
+	}
+
+	if (!objFiles.empty() && async)
+		return RunAsyncMeshLoads(objFiles, threadCount);
+
+	if (!objFiles.empty() && cached)
+		return RunCachedMeshLoads(objFiles);
+
+	if (!objFiles.empty())
+		return RunMeshLoads(objFiles, threadCount);
+
+	return RunUpdateLoop(frameCount);
+}
@@ -1,5 +1,11 @@
 
+#if defined(_WIN32)
 #include <Windows.h>
+#else
+#include <unistd.h>
+#include <climits>
+#include <cstring>
+#endif
 #include <codecvt>
 #include <locale>
 
@@ -21,6 +27,7 @@
 //    version control packages by default.  Meaning: the option must be
 //    changed on every PC.  Ugh.  So instead, here's a helper.
 // --------------------------------------------------------------------------
+#if defined(_WIN32)
 std::wstring GetExePath()
 {
 	// Assume the path is just the "current directory" for now
@@ -47,6 +54,23 @@ std::wstring GetExePath()
 	// Toss back whatever we've found
 	return path;
 }
+#else
+std::wstring GetExePath()
+{
+	// Same idea as above, but the executable's path comes from procfs
+	char currentDir[PATH_MAX] = {};
+	ssize_t length = readlink("/proc/self/exe", currentDir, sizeof(currentDir) - 1);
+	if (length <= 0)
+		return L".";
+
+	// Chop off the exe's file name
+	char* lastSlash = strrchr(currentDir, '/');
+	if (lastSlash)
+		*lastSlash = 0;
+
+	return NarrowToWide(currentDir);
+}
+#endif
 
 
 // ----------------------------------------------------
@@ -62,7 +86,11 @@ std::wstring GetExePath()
 // ----------------------------------------------------
 std::wstring FixPath(const std::wstring& relativeFilePath)
 {
+#if defined(_WIN32)
 	return GetExePath() + L"\\" + relativeFilePath;
+#else
+	return GetExePath() + L"/" + relativeFilePath;
+#endif
 }
 
 
@@ -86,3 +114,20 @@ std::wstring NarrowToWide(const std::string& str)
 	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
 	return converter.from_bytes(str);
 }
+
+
+// ----------------------------------------------------
+//  FNV-1a over every byte.  Not cryptographic, but
+//  plenty to tell asset files apart
+// ----------------------------------------------------
+uint64_t HashBytes(const void* data, size_t size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
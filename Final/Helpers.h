@@ -1,9 +1,14 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 // Helpers for determining the actual path to the executable
 std::wstring GetExePath();
 std::wstring FixPath(const std::wstring& relativeFilePath);
 std::string WideToNarrow(const std::wstring& str);
-std::wstring NarrowToWide(const std::string& str);
\ No newline at end of file
+std::wstring NarrowToWide(const std::string& str);
+
+// 64-bit FNV-1a hash of a block of bytes, e.g. a file's contents
+uint64_t HashBytes(const void* data, size_t size);
\ No newline at end of file
@@ -0,0 +1,25 @@
+#include "InstanceBuffer.h"
+
+InstanceBuffer::InstanceBuffer() :
+	buffer(D3D11_BIND_VERTEX_BUFFER, sizeof(InstanceData))
+{
+}
+
+InstanceData* InstanceBuffer::Map(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, size_t count)
+{
+	if (!buffer.Reserve(device, count))
+		return 0;
+	return static_cast<InstanceData*>(buffer.Map(context));
+}
+
+void InstanceBuffer::Unmap(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	buffer.Unmap(context);
+}
+
+void InstanceBuffer::Bind(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	UINT stride = sizeof(InstanceData);
+	UINT offset = 0;
+	context->IASetVertexBuffers(1, 1, buffer.GetAddressOf(), &stride, &offset);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "DynamicBuffer.h"
+#include "InstanceData.h"
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <cstddef>
+
+// --------------------------------------------------------
+// A dynamic vertex buffer of InstanceData, rewritten every
+// time it's mapped
+// - Sized like any DynamicBuffer
+// - Bound to input slot 1, which is where SimpleVertexShader
+//   puts *_PER_INSTANCE elements
+// --------------------------------------------------------
+class InstanceBuffer
+{
+private:
+	DynamicBuffer buffer;
+
+public:
+	InstanceBuffer();
+
+	// Returns space for count instances, or null if the buffer couldn't be made
+	InstanceData* Map(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, size_t count);
+	void Unmap(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	void Bind(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// Per-instance vertex data for instanced draws, matching
+// VertexShaderInputInstanced in Lighting.hlsli
+// - The matrices are stored as-is, and read back a row at
+//   a time through *_PER_INSTANCE semantics
+// - WorldViewProjection comes from ComputeWorldViewProjections()
+// --------------------------------------------------------
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 World;
+	DirectX::XMFLOAT4X4 WorldInvTranspose;
+	DirectX::XMFLOAT4X4 WorldViewProjection;
+};
@@ -0,0 +1,26 @@
+#include "Lighting.hlsli"
+
+// No constant buffers: every matrix, world-view-projection
+// included, comes from the instance buffer
+
+
+
+// Main
+VertexToPixel main(VertexShaderInputInstanced input)
+{
+	VertexToPixel output;
+
+	// Instance matrices are rebuilt from their rows, so vectors multiply on the left
+	float4x4 world = float4x4(input.world0, input.world1, input.world2, input.world3);
+	float4x4 worldInvTranspose = float4x4(input.worldInvTranspose0, input.worldInvTranspose1, input.worldInvTranspose2, input.worldInvTranspose3);
+	float4x4 worldViewProjection = float4x4(input.worldViewProjection0, input.worldViewProjection1, input.worldViewProjection2, input.worldViewProjection3);
+
+	float4 worldPosition = mul(float4(input.localPosition, 1.0f), world);
+	output.screenPosition = mul(float4(input.localPosition, 1.0f), worldViewProjection);
+	output.uv = input.uv;
+	output.normal = mul(input.normal, (float3x3)worldInvTranspose);
+	output.tangent = mul(input.tangent, (float3x3)world);
+	output.worldPosition = worldPosition.xyz;
+
+	return output;
+}
@@ -0,0 +1,189 @@
+#include "JobSystem.h"
+
+// Which system's worker this thread is, if any
+static thread_local const JobSystem* currentSystem = 0;
+static thread_local size_t currentQueue = 0;
+
+JobSystem::JobSystem(unsigned int threadCount) :
+	queuedJobs(0),
+	steals(0),
+	stopping(false)
+{
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	for (unsigned int i = 0; i < threadCount; i++)
+		queues.push_back(std::make_unique<Queue>());
+
+	for (unsigned int i = 0; i + 1 < threadCount; i++)
+		workers.emplace_back(&JobSystem::WorkerLoop, this, (size_t)i);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepLock);
+		stopping = true;
+	}
+	jobQueued.notify_all();
+
+	for (auto& worker : workers)
+		worker.join();
+
+	// Without workers, nothing else will run what's left
+	while (TryRunJob(queues.size() - 1))
+		;
+}
+
+size_t JobSystem::GetQueueIndex() const
+{
+	return currentSystem == this ? currentQueue : queues.size() - 1;
+}
+
+// --------------------------------------------------------
+// Queues a job on the calling thread's own deque, then
+// wakes a sleeping worker
+// - queuedJobs goes up before the job is visible, so it
+//   never counts fewer than are queued, and before the
+//   sleep lock is taken, so a worker can't check it and
+//   then miss the notify
+// --------------------------------------------------------
+void JobSystem::Push(Job job)
+{
+	queuedJobs.fetch_add(1);
+	Queue& queue = *queues[GetQueueIndex()];
+	{
+		std::lock_guard<std::mutex> lock(queue.Lock);
+		queue.Jobs.push_back(std::move(job));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(sleepLock);
+	}
+	jobQueued.notify_one();
+}
+
+void JobSystem::Run(std::function<void()> work, JobCounter* counter)
+{
+	if (counter)
+		counter->pending.fetch_add(1);
+	Push({ std::move(work), counter });
+}
+
+// --------------------------------------------------------
+// Holds the job on the dependency until it's done, or runs
+// it now if it already is
+// - The check and the hand-over both happen under the
+//   dependency's lock, so a job can't be left behind by a
+//   dependency finishing in between
+// --------------------------------------------------------
+void JobSystem::RunAfter(JobCounter& dependency, std::function<void()> work, JobCounter* counter)
+{
+	if (counter)
+		counter->pending.fetch_add(1);
+
+	{
+		std::lock_guard<std::mutex> lock(dependency.continuationLock);
+		if (!dependency.IsDone())
+		{
+			dependency.continuations.push_back({ std::move(work), counter });
+			return;
+		}
+	}
+	Push({ std::move(work), counter });
+}
+
+// --------------------------------------------------------
+// Takes the job's count off, releasing whatever waits on it
+// - The count drops under the counter's lock, and Wait()
+//   takes the lock before returning, so the counter isn't
+//   gone while this still holds it
+// --------------------------------------------------------
+void JobSystem::Finish(JobCounter* counter)
+{
+	if (!counter)
+		return;
+
+	std::vector<JobCounter::Continuation> released;
+	{
+		std::lock_guard<std::mutex> lock(counter->continuationLock);
+		if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			return;
+		released.swap(counter->continuations);
+	}
+	for (auto& continuation : released)
+		Push({ std::move(continuation.Work), continuation.Counter });
+}
+
+// --------------------------------------------------------
+// Runs one job: the newest from this thread's deque, or
+// else the oldest from another's, trying each in turn from
+// the next one along
+// --------------------------------------------------------
+bool JobSystem::TryRunJob(size_t queueIndex)
+{
+	Job job;
+	bool found = false;
+	for (size_t n = 0; n < queues.size() && !found; n++)
+	{
+		Queue& queue = *queues[(queueIndex + n) % queues.size()];
+		std::lock_guard<std::mutex> lock(queue.Lock);
+		if (queue.Jobs.empty())
+			continue;
+
+		if (n == 0)
+		{
+			job = std::move(queue.Jobs.back());
+			queue.Jobs.pop_back();
+		}
+		else
+		{
+			job = std::move(queue.Jobs.front());
+			queue.Jobs.pop_front();
+			steals.fetch_add(1, std::memory_order_relaxed);
+		}
+		found = true;
+	}
+	if (!found)
+		return false;
+
+	queuedJobs.fetch_sub(1);
+	job.Work();
+	Finish(job.Counter);
+	return true;
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	size_t queueIndex = GetQueueIndex();
+	while (!counter.IsDone())
+	{
+		// Whatever's left is running on other threads
+		if (!TryRunJob(queueIndex))
+			std::this_thread::yield();
+	}
+
+	// The last job to finish may still be releasing continuations
+	std::lock_guard<std::mutex> lock(counter.continuationLock);
+}
+
+// --------------------------------------------------------
+// Runs jobs until there are none, then sleeps until one is
+// queued; exits once stopping and everything's run
+// --------------------------------------------------------
+void JobSystem::WorkerLoop(size_t index)
+{
+	currentSystem = this;
+	currentQueue = index;
+
+	while (true)
+	{
+		if (TryRunJob(index))
+			continue;
+
+		std::unique_lock<std::mutex> lock(sleepLock);
+		jobQueued.wait(lock, [this]() { return stopping || queuedJobs.load() > 0; });
+		if (stopping && queuedJobs.load() == 0)
+			return;
+	}
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// --------------------------------------------------------
+// Counts a group of jobs that haven't finished yet
+//
+// - JobSystem::Run() adds to it, and each job takes its
+//   count back off once it's done
+// - Jobs queued with RunAfter() wait for it to reach zero
+// - A counter can be reused once it's done, but has to
+//   outlive everything counted on it; Wait() on it before
+//   it goes away, rather than just checking IsDone()
+// --------------------------------------------------------
+class JobCounter
+{
+private:
+	friend class JobSystem;
+
+	struct Continuation
+	{
+		std::function<void()> Work;
+		JobCounter* Counter;
+	};
+
+	std::atomic<int> pending;
+	std::mutex continuationLock;
+	std::vector<Continuation> continuations;
+
+public:
+	JobCounter() : pending(0) {}
+	JobCounter(JobCounter const&) = delete;
+	void operator=(JobCounter const&) = delete;
+
+	bool IsDone() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+// --------------------------------------------------------
+// Work-stealing job scheduler for splitting a frame's work
+// across threads
+//
+// - Each worker has its own deque: it pushes and pops jobs
+//   at the back, so it works on what it queued last, while
+//   idle workers steal from the front of the others'
+// - Threads that aren't workers (the main thread) share one
+//   more deque, and Wait() runs jobs rather than blocking,
+//   so the waiting thread is never idle either
+// - ParallelFor() splits a range into batches and waits for
+//   them, which is what most callers need
+// - Dependencies are counters: RunAfter() holds a job back
+//   until another counter is done
+// - Idle workers sleep until something is queued, and run
+//   everything still queued before the destructor returns
+// --------------------------------------------------------
+class JobSystem
+{
+private:
+	struct Job
+	{
+		std::function<void()> Work;
+		JobCounter* Counter;
+	};
+
+	struct Queue
+	{
+		std::mutex Lock;
+		std::deque<Job> Jobs;
+	};
+
+	// One per worker, then the shared one for other threads
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+
+	std::atomic<size_t> queuedJobs;
+	std::atomic<size_t> steals;
+	std::mutex sleepLock;
+	std::condition_variable jobQueued;
+	bool stopping;
+
+	size_t GetQueueIndex() const;
+	void Push(Job job);
+	bool TryRunJob(size_t queueIndex);
+	void Finish(JobCounter* counter);
+	void WorkerLoop(size_t index);
+
+public:
+	// Threads, counting whichever calls Wait(); 0 means one per hardware
+	// thread.  With one, jobs only run inside Wait().
+	JobSystem(unsigned int threadCount = 0);
+	~JobSystem();
+
+	JobSystem(JobSystem const&) = delete;
+	void operator=(JobSystem const&) = delete;
+
+	void Run(std::function<void()> work, JobCounter* counter = 0);
+	void RunAfter(JobCounter& dependency, std::function<void()> work, JobCounter* counter = 0);
+
+	// Runs queued jobs until the counter is done
+	void Wait(JobCounter& counter);
+
+	// --------------------------------------------------------
+	// Calls work(begin, end) over [0, count) in batches of
+	// about minBatch or more, a few per thread so faster
+	// threads can take more, and returns when they're all done
+	// --------------------------------------------------------
+	template<typename Work>
+	void ParallelFor(size_t count, size_t minBatch, Work work)
+	{
+		size_t batchSize = std::max<size_t>(minBatch, 1);
+		size_t batches = std::min((count + batchSize - 1) / batchSize, GetThreadCount() * 4);
+		if (batches <= 1 || workers.empty())
+		{
+			if (count > 0)
+				work((size_t)0, count);
+			return;
+		}
+
+		JobCounter counter;
+		for (size_t b = 0; b < batches; b++)
+		{
+			size_t begin = count * b / batches;
+			size_t end = count * (b + 1) / batches;
+			Run([&work, begin, end]() { work(begin, end); }, &counter);
+		}
+		Wait(counter);
+	}
+
+	size_t GetThreadCount() const { return workers.size() + 1; }
+
+	// Jobs taken from another thread's deque, since this was made
+	size_t GetStealCount() const { return steals.load(); }
+};
@@ -0,0 +1,206 @@
+#include "LightClusters.h"
+#include "Light.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+LightClusters::LightClusters() :
+	xScale(0.0f),
+	yScale(0.0f),
+	nearZ(0.0f),
+	farZ(0.0f),
+	depthScale(0.0f),
+	depthBias(0.0f),
+	clusters(ClusterCount),
+	globalLightCount(0)
+{
+}
+
+// --------------------------------------------------------
+// Bins every light, then groups the results by cluster:
+// counts, then offsets, then each cluster's indices in
+// light order
+// --------------------------------------------------------
+void LightClusters::Build(const XMFLOAT4X4& view, const XMFLOAT4X4& projection, const Light* lights, size_t lightCount)
+{
+	// A perspective projection's near and far planes, from its z column
+	float newNear = -projection._43 / projection._33;
+	float newFar = projection._33 * newNear / (projection._33 - 1.0f);
+	if (projection._11 != xScale || projection._22 != yScale || newNear != nearZ || newFar != farZ)
+	{
+		xScale = projection._11;
+		yScale = projection._22;
+		nearZ = newNear;
+		farZ = newFar;
+		BuildBounds();
+	}
+
+	lightIndices.clear();
+	for (size_t i = 0; i < lightCount; i++)
+	{
+		if (lights[i].Type == LIGHT_TYPE_DIRECTIONAL)
+			lightIndices.push_back((uint32_t)i);
+	}
+	globalLightCount = (uint32_t)lightIndices.size();
+
+	assignedClusters.clear();
+	assignedLights.clear();
+	XMMATRIX viewMat = XMLoadFloat4x4(&view);
+	for (size_t i = 0; i < lightCount; i++)
+	{
+		if (lights[i].Type != LIGHT_TYPE_DIRECTIONAL && lights[i].Range > 0.0f)
+			BinLight((uint32_t)i, XMVector3TransformCoord(XMLoadFloat3(&lights[i].Position), viewMat), lights[i].Range);
+	}
+
+	for (LightCluster& cluster : clusters)
+		cluster.Count = 0;
+	for (uint32_t c : assignedClusters)
+		clusters[c].Count++;
+
+	uint32_t offset = globalLightCount;
+	for (LightCluster& cluster : clusters)
+	{
+		cluster.Offset = offset;
+		offset += cluster.Count;
+		cluster.Count = 0;
+	}
+
+	lightIndices.resize(offset);
+	for (size_t n = 0; n < assignedClusters.size(); n++)
+	{
+		LightCluster& cluster = clusters[assignedClusters[n]];
+		lightIndices[cluster.Offset + cluster.Count++] = assignedLights[n];
+	}
+}
+
+// --------------------------------------------------------
+// Each cluster's box surrounds its piece of the frustum:
+// the tile's edges at both of the slice's depths
+// - Slice k starts at near * (far / near)^(k / Slices), so
+//   each is the same fraction deeper than the last
+// --------------------------------------------------------
+void LightClusters::BuildBounds()
+{
+	depthScale = Slices / logf(farZ / nearZ);
+	depthBias = -logf(nearZ) * depthScale;
+
+	for (auto* component : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+		component->assign(ClusterCount + 3, 0.0f);
+
+	for (uint32_t k = 0; k < Slices; k++)
+	{
+		float z0 = nearZ * powf(farZ / nearZ, (float)k / Slices);
+		float z1 = k + 1 == Slices ? farZ : nearZ * powf(farZ / nearZ, (float)(k + 1) / Slices);
+		for (uint32_t y = 0; y < TilesY; y++)
+		{
+			float top = 1.0f - 2.0f * y / TilesY;
+			float bottom = 1.0f - 2.0f * (y + 1) / TilesY;
+			for (uint32_t x = 0; x < TilesX; x++)
+			{
+				float left = -1.0f + 2.0f * x / TilesX;
+				float right = -1.0f + 2.0f * (x + 1) / TilesX;
+
+				size_t i = x + TilesX * (y + TilesY * k);
+				minX[i] = std::min(left * z0, left * z1) / xScale;
+				maxX[i] = std::max(right * z0, right * z1) / xScale;
+				minY[i] = std::min(bottom * z0, bottom * z1) / yScale;
+				maxY[i] = std::max(top * z0, top * z1) / yScale;
+				minZ[i] = z0;
+				maxZ[i] = z1;
+			}
+		}
+	}
+}
+
+uint32_t LightClusters::GetSlice(float depth) const
+{
+	float slice = floorf(logf(std::max(depth, nearZ)) * depthScale + depthBias);
+	return (uint32_t)std::min(std::max(slice, 0.0f), (float)(Slices - 1));
+}
+
+// --------------------------------------------------------
+// Finds the range of tiles and slices the light's sphere
+// could reach, then tests it against those clusters' boxes
+// a row of four at a time:
+// distance^2 = sum of max(min - center, center - max, 0)^2
+// --------------------------------------------------------
+void LightClusters::BinLight(uint32_t light, FXMVECTOR viewCenter, float range)
+{
+	float cx = XMVectorGetX(viewCenter);
+	float cy = XMVectorGetY(viewCenter);
+	float cz = XMVectorGetZ(viewCenter);
+	float zNear = std::max(cz - range, nearZ);
+	float zFar = std::min(cz + range, farZ);
+	if (zNear > zFar)
+		return;
+
+	// The sphere's box projected over the depths it spans: an edge's
+	// extreme is at the nearest depth if it's off-axis, else the farthest
+	float left = xScale * (cx - range < 0.0f ? (cx - range) / zNear : (cx - range) / zFar);
+	float right = xScale * (cx + range > 0.0f ? (cx + range) / zNear : (cx + range) / zFar);
+	float bottom = yScale * (cy - range < 0.0f ? (cy - range) / zNear : (cy - range) / zFar);
+	float top = yScale * (cy + range > 0.0f ? (cy + range) / zNear : (cy + range) / zFar);
+	if (left > 1.0f || right < -1.0f || bottom > 1.0f || top < -1.0f)
+		return;
+
+	auto tile = [](float t, uint32_t count) { return (uint32_t)std::min(std::max(t * count, 0.0f), (float)(count - 1)); };
+	uint32_t x0 = tile((left + 1.0f) * 0.5f, TilesX);
+	uint32_t x1 = tile((right + 1.0f) * 0.5f, TilesX);
+	uint32_t y0 = tile((1.0f - top) * 0.5f, TilesY);
+	uint32_t y1 = tile((1.0f - bottom) * 0.5f, TilesY);
+	uint32_t k0 = GetSlice(zNear);
+	uint32_t k1 = GetSlice(zFar);
+
+	XMVECTOR centerX = XMVectorReplicate(cx);
+	XMVECTOR centerY = XMVectorReplicate(cy);
+	XMVECTOR centerZ = XMVectorReplicate(cz);
+	XMVECTOR rangeSquared = XMVectorReplicate(range * range);
+	XMVECTOR zero = XMVectorZero();
+	for (uint32_t k = k0; k <= k1; k++)
+	{
+		for (uint32_t y = y0; y <= y1; y++)
+		{
+			size_t row = TilesX * (y + TilesY * k);
+			for (uint32_t x = x0; x <= x1; x += 4)
+			{
+				size_t i = row + x;
+				XMVECTOR dx = XMVectorMax(XMVectorMax(
+					XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&minX[i])) - centerX,
+					centerX - XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&maxX[i]))), zero);
+				XMVECTOR dy = XMVectorMax(XMVectorMax(
+					XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&minY[i])) - centerY,
+					centerY - XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&maxY[i]))), zero);
+				XMVECTOR dz = XMVectorMax(XMVectorMax(
+					XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&minZ[i])) - centerZ,
+					centerZ - XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&maxZ[i]))), zero);
+				XMVECTOR touches = XMVectorLessOrEqual(dx * dx + dy * dy + dz * dz, rangeSquared);
+
+				// The batch may run past the row's last tile, which is ignored
+				uint32_t masks[4];
+				XMStoreInt4(masks, touches);
+				for (uint32_t j = 0; j < 4 && x + j <= x1; j++)
+				{
+					if (masks[j] != 0)
+					{
+						assignedClusters.push_back((uint32_t)(i + j));
+						assignedLights.push_back(light);
+					}
+				}
+			}
+		}
+	}
+}
+
+uint32_t LightClusters::FindCluster(float u, float v, float depth) const
+{
+	uint32_t x = (uint32_t)std::min(std::max(u * TilesX, 0.0f), (float)(TilesX - 1));
+	uint32_t y = (uint32_t)std::min(std::max(v * TilesY, 0.0f), (float)(TilesY - 1));
+	return x + TilesX * (y + TilesY * GetSlice(depth));
+}
+
+void LightClusters::GetClusterBounds(uint32_t cluster, XMFLOAT3& boundsMin, XMFLOAT3& boundsMax) const
+{
+	boundsMin = XMFLOAT3(minX[cluster], minY[cluster], minZ[cluster]);
+	boundsMax = XMFLOAT3(maxX[cluster], maxY[cluster], maxZ[cluster]);
+}
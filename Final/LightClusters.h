@@ -0,0 +1,82 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// struct Light and LightCluster are generated from the shaders
+#include "ShaderConstants.h"
+
+// --------------------------------------------------------
+// Bins lights into a grid of clusters ("froxels"): the
+// camera's view split into screen tiles, and each tile
+// into depth slices that get deeper with distance, so a
+// pixel only loops over the lights near it
+//
+// Each frame, Build() with the camera's view and projection
+// and every light, then upload:
+//  - the lights themselves, as they were given
+//  - GetLightIndices(): the directional lights first (they
+//    reach everywhere, so every pixel uses the first
+//    GetGlobalLightCount() of them), then each cluster's
+//    point and spot lights
+//  - GetClusters(): where each cluster's list is, by
+//    x + TilesX * (y + TilesY * slice), tiles from the top
+//    left
+//
+// - A light goes in every cluster its Range sphere touches.
+//   Cluster bounds are view-space boxes, an array per
+//   component, so a light is tested against four clusters
+//   of a row at a time
+// - Perspective projections only, as Camera makes
+// --------------------------------------------------------
+class LightClusters
+{
+public:
+	static constexpr uint32_t TilesX = 16;
+	static constexpr uint32_t TilesY = 9;
+	static constexpr uint32_t Slices = 24;
+	static constexpr uint32_t ClusterCount = TilesX * TilesY * Slices;
+
+private:
+	// What the cluster bounds were built for, so they're only rebuilt when it changes
+	float xScale, yScale;
+	float nearZ, farZ;
+	float depthScale, depthBias;
+
+	// View-space cluster bounds, padded so a row's last batch of four stays in range
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+
+	std::vector<LightCluster> clusters;
+	std::vector<uint32_t> lightIndices;
+	uint32_t globalLightCount;
+
+	// Which light each cluster gets, in light order, before they're grouped by cluster
+	std::vector<uint32_t> assignedClusters;
+	std::vector<uint32_t> assignedLights;
+
+	void BuildBounds();
+	void BinLight(uint32_t light, DirectX::FXMVECTOR viewCenter, float range);
+	uint32_t GetSlice(float depth) const;
+
+public:
+	LightClusters();
+
+	void Build(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection, const Light* lights, size_t lightCount);
+
+	const LightCluster* GetClusters() const { return clusters.data(); }
+	const uint32_t* GetLightIndices() const { return lightIndices.data(); }
+	size_t GetLightIndexCount() const { return lightIndices.size(); }
+	uint32_t GetGlobalLightCount() const { return globalLightCount; }
+
+	// The shader's slice is floor(log(depth) * scale + bias)
+	float GetDepthScale() const { return depthScale; }
+	float GetDepthBias() const { return depthBias; }
+
+	// The cluster holding a point, the way the shader finds it: screen u and
+	// v from 0 to 1 (from the top left) and view depth
+	uint32_t FindCluster(float u, float v, float depth) const;
+	void GetClusterBounds(uint32_t cluster, DirectX::XMFLOAT3& boundsMin, DirectX::XMFLOAT3& boundsMax) const;
+};
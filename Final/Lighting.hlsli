@@ -45,6 +45,29 @@ struct VertexShaderInput
 	float3 tangent			: TANGENT; // Tangent for normal mapping
 };
 
+// Same vertex, plus per-instance matrices from input slot 1
+// - Matrices come in as explicit rows, since matrix inputs
+//   would follow the packing order
+struct VertexShaderInputInstanced
+{
+	float3 localPosition	: POSITION;
+	float2 uv				: TEXCOORD;
+	float3 normal			: NORMAL;
+	float3 tangent			: TANGENT;
+	float4 world0			: WORLD_PER_INSTANCE0;
+	float4 world1			: WORLD_PER_INSTANCE1;
+	float4 world2			: WORLD_PER_INSTANCE2;
+	float4 world3			: WORLD_PER_INSTANCE3;
+	float4 worldInvTranspose0	: WORLD_INV_TRANSPOSE_PER_INSTANCE0;
+	float4 worldInvTranspose1	: WORLD_INV_TRANSPOSE_PER_INSTANCE1;
+	float4 worldInvTranspose2	: WORLD_INV_TRANSPOSE_PER_INSTANCE2;
+	float4 worldInvTranspose3	: WORLD_INV_TRANSPOSE_PER_INSTANCE3;
+	float4 worldViewProjection0	: WORLD_VIEW_PROJECTION_PER_INSTANCE0;
+	float4 worldViewProjection1	: WORLD_VIEW_PROJECTION_PER_INSTANCE1;
+	float4 worldViewProjection2	: WORLD_VIEW_PROJECTION_PER_INSTANCE2;
+	float4 worldViewProjection3	: WORLD_VIEW_PROJECTION_PER_INSTANCE3;
+};
+
 // Taking info from vertex shader
 // Including lighting so I don't forget to add it later
 struct VertexToPixel
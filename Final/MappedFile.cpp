@@ -0,0 +1,120 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include "Helpers.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ctor
+MappedFile::MappedFile() :
+	data(0),
+	size(0),
+	isOpen(false),
+#if defined(_WIN32)
+	fileHandle(INVALID_HANDLE_VALUE),
+	mappingHandle(0)
+#else
+	fileDescriptor(-1)
+#endif
+{}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+// --------------------------------------------------------
+// Maps the whole file into memory, read-only
+// - Empty files open successfully with a null data pointer
+// --------------------------------------------------------
+bool MappedFile::Open(const std::wstring& path)
+{
+	Close();
+
+#if defined(_WIN32)
+	fileHandle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(fileHandle, &fileSize))
+	{
+		Close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+
+	if (size > 0)
+	{
+		mappingHandle = CreateFileMappingW(fileHandle, 0, PAGE_READONLY, 0, 0, 0);
+		if (!mappingHandle)
+		{
+			Close();
+			return false;
+		}
+
+		data = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+		if (!data)
+		{
+			Close();
+			return false;
+		}
+	}
+#else
+	fileDescriptor = open(WideToNarrow(path).c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+		return false;
+
+	struct stat fileInfo = {};
+	if (fstat(fileDescriptor, &fileInfo) != 0)
+	{
+		Close();
+		return false;
+	}
+	size = (size_t)fileInfo.st_size;
+
+	if (size > 0)
+	{
+		void* mapping = mmap(0, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+		if (mapping == MAP_FAILED)
+		{
+			Close();
+			return false;
+		}
+
+		// We read front to back exactly once
+		madvise(mapping, size, MADV_SEQUENTIAL);
+		data = (const char*)mapping;
+	}
+#endif
+
+	isOpen = true;
+	return true;
+}
+
+// --------------------------------------------------------
+// Unmaps the file and releases the OS handles
+// --------------------------------------------------------
+void MappedFile::Close()
+{
+#if defined(_WIN32)
+	if (data) UnmapViewOfFile(data);
+	if (mappingHandle) CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+	mappingHandle = 0;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (data) munmap((void*)data, size);
+	if (fileDescriptor >= 0) close(fileDescriptor);
+	fileDescriptor = -1;
+#endif
+
+	data = 0;
+	size = 0;
+	isOpen = false;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// --------------------------------------------------------
+// Read-only memory mapping of an entire file
+//
+// - The file's bytes are available through GetData() for
+//   as long as the MappedFile is open
+// - Not copyable, since it owns the OS-level handles
+// --------------------------------------------------------
+class MappedFile
+{
+private:
+	const char* data;
+	size_t size;
+	bool isOpen;
+
+#if defined(_WIN32)
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(MappedFile const&) = delete;
+	void operator=(MappedFile const&) = delete;
+
+	bool Open(const std::wstring& path);
+	void Close();
+
+	bool IsOpen() { return isOpen; }
+	const char* GetData() { return data; }
+	size_t GetSize() { return size; }
+};
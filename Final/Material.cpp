@@ -12,8 +12,31 @@ Material::Material(DirectX::XMFLOAT3 colorTint,
 	vertexShader(vertexShader),
 	roughness(roughness),
 	uvScale(uvScale),
-	uvOffset(uvOffset)
-{}
+	uvOffset(uvOffset),
+	bindTableDirty(true)
+{
+	FindPixelShaderHandles();
+	FindVertexShaderHandles();
+}
+
+void Material::FindPixelShaderHandles()
+{
+	perMaterialBuffer = pixelShader->GetBufferHandle(PixelShaderPerMaterial::BufferName);
+}
+
+void Material::FindVertexShaderHandles()
+{
+	perObjectBuffer = vertexShader->GetBufferHandle(VertexShaderPerObject::BufferName);
+}
+
+// Resources the pixel shader doesn't have are left out
+void Material::BuildBindTable()
+{
+	bindTable.Clear();
+	for (auto& t : textureSRVs) { pixelShader->AddToBindTable(bindTable, t.first, t.second.Get()); }
+	for (auto& s : samplers) { pixelShader->AddToBindTable(bindTable, s.first, s.second.Get()); }
+	bindTableDirty = false;
+}
 
 // getters
 DirectX::XMFLOAT3 Material::GetColor() {
@@ -25,6 +48,9 @@ shared_ptr<SimplePixelShader> Material::GetPixelShader() {
 shared_ptr<SimpleVertexShader> Material::GetVertexShader() {
 	return vertexShader;
 }
+shared_ptr<SimpleVertexShader> Material::GetInstancedVertexShader() {
+	return instancedVertexShader;
+}
 
 Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Material::GetTextureSRV(std::string name)
 {
@@ -45,48 +71,85 @@ void Material::SetColor(DirectX::XMFLOAT3 clr) {
 }
 void Material::SetPixelShader(shared_ptr<SimplePixelShader> pxShader) {
 	pixelShader = pxShader;
+	FindPixelShaderHandles();
+	bindTableDirty = true;
 }
 void Material::SetVertexShader(shared_ptr<SimpleVertexShader> vtShader) {
 	vertexShader = vtShader;
+	FindVertexShaderHandles();
+}
+void Material::SetInstancedVertexShader(shared_ptr<SimpleVertexShader> vtShader) {
+	instancedVertexShader = vtShader;
 }
 void Material::AddTextureSRV(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
 	textureSRVs.insert({ name, srv });
+	bindTableDirty = true;
 }
 void Material::AddSampler(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler)
 {
 	samplers.insert({ name, sampler });
+	bindTableDirty = true;
 }
 void Material::RemoveTextureSRV(std::string name)
 {
 	textureSRVs.erase(name);
+	bindTableDirty = true;
 }
 void Material::RemoveSampler(std::string name)
 {
 	samplers.erase(name);
+	bindTableDirty = true;
 }
 
-// Configure the shaders
-void Material::SetUpShaders(Transform* transform, std::shared_ptr<Camera> camera)
+// Activation
+void Material::SetShaders()
 {
-	// Activation
 	vertexShader->SetShader();
 	pixelShader->SetShader();
-	
-	// Sending data to the shaders and updating buffers via simpleshader
-	vertexShader->SetMatrix4x4("world", transform->GetWorldMatrix());
-	vertexShader->SetMatrix4x4("view", camera->GetView());
-	vertexShader->SetMatrix4x4("projection", camera->GetProjection());
-	vertexShader->SetMatrix4x4("worldInvTranspose", transform->GetWorldInverseTransposeMatrix());
-	vertexShader->CopyAllBufferData();
-	
-	pixelShader->SetFloat("roughness", roughness);
-	pixelShader->SetFloat3("colorTint", colorTint);
-	pixelShader->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
-	pixelShader->SetFloat2("uvScale", uvScale);
-	pixelShader->SetFloat2("uvOffset", uvOffset);
-	pixelShader->CopyAllBufferData();
-	
-	for (auto& t : textureSRVs) { pixelShader->SetShaderResourceView(t.first.c_str(), t.second.Get()); }
-	for (auto& s : samplers) { pixelShader->SetSamplerState(s.first.c_str(), s.second.Get()); }
+}
+
+PixelShaderPerMaterial Material::GetMaterialData()
+{
+	PixelShaderPerMaterial constants = {};
+	constants.colorTint = colorTint;
+	constants.roughness = roughness;
+	constants.uvScale = uvScale;
+	constants.uvOffset = uvOffset;
+	return constants;
+}
+
+// Everything in the pixel shader that belongs to this material
+void Material::SetMaterialData()
+{
+	SetMaterialData(GetMaterialData());
+}
+
+// The same, with constants captured earlier in place of the current ones
+void Material::SetMaterialData(const PixelShaderPerMaterial& constants)
+{
+	pixelShader->SetBufferData(perMaterialBuffer, constants);
+	pixelShader->CopyBufferData(perMaterialBuffer);
+
+	if (bindTableDirty)
+		BuildBindTable();
+	pixelShader->SetBindTable(bindTable);
+}
+
+// Sending the object's matrices to the vertex shader and updating just that buffer
+void Material::SetObjectData(const DirectX::XMFLOAT4X4& worldViewProjection, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInvTranspose)
+{
+	VertexShaderPerObject constants;
+	constants.worldViewProjection = worldViewProjection;
+	constants.world = world;
+	constants.worldInvTranspose = worldInvTranspose;
+	vertexShader->SetBufferData(perObjectBuffer, constants);
+	vertexShader->CopyBufferData(perObjectBuffer);
+}
+
+// Matrices come from the instance data, so nothing to upload
+void Material::SetInstancedShaders()
+{
+	instancedVertexShader->SetShader();
+	pixelShader->SetShader();
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include "DXCore.h"
 #include "SimpleShader.h"
+#include "ShaderConstants.h"
 #include "Transform.h"
 #include "Camera.h"
 #include <DirectXMath.h>
@@ -15,12 +16,28 @@ private:
 	DirectX::XMFLOAT3 colorTint;
 	shared_ptr<SimplePixelShader> pixelShader;
 	shared_ptr<SimpleVertexShader> vertexShader;
+	shared_ptr<SimpleVertexShader> instancedVertexShader;
 	float roughness;
 
 	DirectX::XMFLOAT2 uvOffset;
 	DirectX::XMFLOAT2 uvScale;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureSRVs;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>> samplers;
+
+	// Buffers resolved when the shaders are set, so per-draw setting
+	// doesn't look anything up by name, and writes each whole buffer
+	// from its ShaderConstants.h struct
+	SimpleShaderHandle perMaterialBuffer;
+	SimpleShaderHandle perObjectBuffer;
+
+	// The textures and samplers above, by pixel shader register,
+	// rebuilt when either they or the pixel shader change
+	SimpleBindTable bindTable;
+	bool bindTableDirty;
+
+	void FindPixelShaderHandles();
+	void FindVertexShaderHandles();
+	void BuildBindTable();
 public:
 	Material(DirectX::XMFLOAT3 colorTint,
 		shared_ptr<SimplePixelShader> pixelShader,
@@ -34,14 +51,33 @@ public:
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetTextureSRV(std::string name);
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> GetSampler(std::string name);
 	void SetColor(DirectX::XMFLOAT3 clr);
+
+	// The PerMaterial constants as they are now, for a render snapshot
+	PixelShaderPerMaterial GetMaterialData();
 	void SetPixelShader(shared_ptr<SimplePixelShader> pxShader);
 	void SetVertexShader(shared_ptr<SimpleVertexShader> vtShader);
 
+	// An optional stand-in for the vertex shader that reads world matrices
+	// from per-instance data, so draws with this material can be instanced
+	shared_ptr<SimpleVertexShader> GetInstancedVertexShader();
+	void SetInstancedVertexShader(shared_ptr<SimpleVertexShader> vtShader);
+
 	void AddTextureSRV(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	void AddSampler(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler);
 	void RemoveTextureSRV(std::string name);
 	void RemoveSampler(std::string name);
 
-	void SetUpShaders(Transform* transform, std::shared_ptr<Camera> camera);
+	// Constants are split by how often they change, each its own buffer:
+	// PerFrame (camera, lights) is set by Game once a frame for each
+	// shader, so these only upload PerMaterial and PerObject.  The
+	// world-view-projection comes from ComputeWorldViewProjections()
+	// - Set separately, so a render queue can skip the ones that haven't changed
+	void SetShaders();
+	void SetMaterialData();
+	void SetMaterialData(const PixelShaderPerMaterial& constants);
+	void SetObjectData(const DirectX::XMFLOAT4X4& worldViewProjection, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInvTranspose);
+
+	// The instanced version of SetShaders(); there's no object data to set
+	void SetInstancedShaders();
 };
 
@@ -2,6 +2,7 @@
 
 #include "DXCore.h"
 #include "Vertex.h"
+#include "MeshCache.h"
 #include <DirectXMath.h>
 #include <d3d11.h>
 #include <wrl/client.h>
@@ -19,6 +20,14 @@ private:
 	// Index count
 	unsigned int indexCount;
 
+	// Local-space bounding box, for culling
+	DirectX::XMFLOAT3 boundsCenter;
+	DirectX::XMFLOAT3 boundsExtents;
+	void SetBounds(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax);
+
+	// Creates the buffers from finished vertices (tangents included)
+	void UploadBuffers(const Vertex* vertArray, size_t numVerts, const unsigned int* indexArray, size_t numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
+
 public:
 	// Ctor
 	Mesh(
@@ -29,16 +38,24 @@ public:
 		Microsoft::WRL::ComPtr<ID3D11Device> device // Creates buffers
 	);
 	Mesh(const std::wstring& objFile, Microsoft::WRL::ComPtr<ID3D11Device> device);
+	Mesh(MeshCache& cache, Microsoft::WRL::ComPtr<ID3D11Device> device);
 	~Mesh();
 	
 	// Get methods
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
 	unsigned int GetIndexCount();
+	DirectX::XMFLOAT3 GetBoundsCenter();
+	DirectX::XMFLOAT3 GetBoundsExtents();
 	
 	// Handles drawing the mesh
 	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
 
+	// Draw() in two halves, so consecutive draws of this mesh can bind once
+	void SetBuffers(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	void DrawIndexed(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	void DrawIndexedInstanced(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, unsigned int instanceCount);
+
 	// Sets up buffers
 	void CreateBuffers(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
 
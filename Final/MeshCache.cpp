@@ -0,0 +1,157 @@
+#include "MeshCache.h"
+#include "Helpers.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+using namespace DirectX;
+
+static_assert(sizeof(MeshCacheHeader) == 64, "MeshCacheHeader must stay tightly packed");
+
+// Fills in everything but the magic number and version
+static void DescribeMesh(MeshCacheHeader& header, const MeshData& meshData, uint64_t sourceSize, int64_t sourceTime)
+{
+	header.VertexSize = sizeof(Vertex);
+	header.VertexCount = (uint32_t)meshData.Vertices.size();
+	header.IndexCount = (uint32_t)meshData.Indices.size();
+	header.SourceSize = sourceSize;
+	header.SourceTime = sourceTime;
+
+	CalculateBounds(meshData.Vertices.data(), meshData.Vertices.size(), header.BoundsMin, header.BoundsMax);
+}
+
+// ctor
+MeshCache::MeshCache() :
+	header(0),
+	vertices(0),
+	indices(0),
+	rebuilt(false),
+	fallbackHeader()
+{}
+
+// The cache sits right next to the .obj it was built from
+std::wstring MeshCache::GetCachePath(const std::wstring& objFile)
+{
+	return objFile + L".meshcache";
+}
+
+// --------------------------------------------------------
+// Maps a cache file and checks it against the source .obj
+// - Returns false if it is missing, stale or truncated
+// --------------------------------------------------------
+bool MeshCache::OpenCacheFile(const std::wstring& cacheFile, uint64_t sourceSize, int64_t sourceTime)
+{
+	if (!file.Open(cacheFile) || file.GetSize() < sizeof(MeshCacheHeader))
+		return false;
+
+	const MeshCacheHeader* candidate = (const MeshCacheHeader*)file.GetData();
+	if (candidate->Magic != Magic ||
+		candidate->Version != Version ||
+		candidate->VertexSize != sizeof(Vertex) ||
+		candidate->SourceSize != sourceSize ||
+		candidate->SourceTime != sourceTime)
+		return false;
+
+	size_t expectedSize =
+		sizeof(MeshCacheHeader) +
+		sizeof(Vertex) * (size_t)candidate->VertexCount +
+		sizeof(unsigned int) * (size_t)candidate->IndexCount;
+	if (file.GetSize() != expectedSize)
+		return false;
+
+	header = candidate;
+	vertices = (const Vertex*)(file.GetData() + sizeof(MeshCacheHeader));
+	indices = (const unsigned int*)(vertices + candidate->VertexCount);
+	return true;
+}
+
+// --------------------------------------------------------
+// Loads the mesh for an .obj file through its cache
+// - Returns false only if the .obj itself can't be loaded
+// --------------------------------------------------------
+bool MeshCache::Load(const std::wstring& objFile)
+{
+	file.Close();
+	header = 0;
+	vertices = 0;
+	indices = 0;
+	rebuilt = false;
+
+	// Identify the exact version of the source file
+	std::error_code error;
+	std::filesystem::path sourcePath(objFile);
+	uint64_t sourceSize = (uint64_t)std::filesystem::file_size(sourcePath, error);
+	if (error)
+		return false;
+	int64_t sourceTime = (int64_t)std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count();
+	if (error)
+		return false;
+
+	std::wstring cacheFile = GetCachePath(objFile);
+	if (OpenCacheFile(cacheFile, sourceSize, sourceTime))
+		return true;
+
+	// Missing or stale, so do it the slow way once
+	file.Close();
+	rebuilt = true;
+	fallback = MeshData();
+	if (!LoadOBJ(objFile, fallback) || fallback.Indices.empty())
+		return false;
+
+	CalculateTangents(fallback.Vertices.data(), (int)fallback.Vertices.size(), fallback.Indices.data(), (int)fallback.Indices.size());
+
+	if (Write(cacheFile, fallback, sourceSize, sourceTime) && OpenCacheFile(cacheFile, sourceSize, sourceTime))
+	{
+		fallback = MeshData();
+		return true;
+	}
+
+	// Couldn't write the cache (read-only folder, etc.), so serve from memory
+	file.Close();
+	fallbackHeader = MeshCacheHeader();
+	DescribeMesh(fallbackHeader, fallback, sourceSize, sourceTime);
+	header = &fallbackHeader;
+	vertices = fallback.Vertices.data();
+	indices = fallback.Indices.data();
+	return true;
+}
+
+// --------------------------------------------------------
+// Writes mesh data (with tangents already calculated) to
+// a cache file
+// - Writes to a temporary file first so a half-written
+//   cache is never picked up
+// --------------------------------------------------------
+bool MeshCache::Write(const std::wstring& cacheFile, const MeshData& meshData, uint64_t sourceSize, int64_t sourceTime)
+{
+	MeshCacheHeader newHeader = {};
+	newHeader.Magic = Magic;
+	newHeader.Version = Version;
+	DescribeMesh(newHeader, meshData, sourceSize, sourceTime);
+
+	std::wstring tempFile = cacheFile + L".tmp";
+	{
+#if defined(_WIN32)
+		std::ofstream out(tempFile, std::ios::binary | std::ios::trunc);
+#else
+		std::ofstream out(WideToNarrow(tempFile), std::ios::binary | std::ios::trunc);
+#endif
+		if (!out.is_open())
+			return false;
+
+		out.write((const char*)&newHeader, sizeof(newHeader));
+		out.write((const char*)meshData.Vertices.data(), sizeof(Vertex) * meshData.Vertices.size());
+		out.write((const char*)meshData.Indices.data(), sizeof(unsigned int) * meshData.Indices.size());
+		if (!out.good())
+			return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempFile, cacheFile, error);
+	if (error)
+	{
+		std::filesystem::remove(tempFile, error);
+		return false;
+	}
+	return true;
+}
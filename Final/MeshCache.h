@@ -0,0 +1,74 @@
+#pragma once
+
+#include "MeshData.h"
+#include "MappedFile.h"
+#include <DirectXMath.h>
+#include <cstdint>
+#include <string>
+
+// --------------------------------------------------------
+// Header at the start of a binary mesh cache file
+//
+// - Followed by VertexCount tightly packed Vertex structs
+//   (tangents already calculated), then IndexCount indices
+// - SourceSize/SourceTime identify the .obj it was built
+//   from, so edits to the .obj invalidate the cache
+// --------------------------------------------------------
+struct MeshCacheHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t VertexSize;
+	uint32_t VertexCount;
+	uint32_t IndexCount;
+	uint32_t Padding;
+	uint64_t SourceSize;
+	int64_t SourceTime;
+	DirectX::XMFLOAT3 BoundsMin;
+	DirectX::XMFLOAT3 BoundsMax;
+};
+
+// --------------------------------------------------------
+// A mesh loaded through its binary cache
+//
+// - Load() maps "<file>.obj.meshcache" if it is up to date,
+//   otherwise parses the .obj and writes the cache first
+// - Vertex and index pointers point straight into the
+//   mapped file, so they're only valid while this is alive
+// --------------------------------------------------------
+class MeshCache
+{
+private:
+	MappedFile file;
+	const MeshCacheHeader* header;
+	const Vertex* vertices;
+	const unsigned int* indices;
+	bool rebuilt;
+
+	// Used instead of the mapping if the cache can't be written
+	MeshData fallback;
+	MeshCacheHeader fallbackHeader;
+
+	bool OpenCacheFile(const std::wstring& cacheFile, uint64_t sourceSize, int64_t sourceTime);
+
+public:
+	static const uint32_t Magic = 0x4853454D; // "MESH"
+	static const uint32_t Version = 1;
+
+	MeshCache();
+
+	bool Load(const std::wstring& objFile);
+
+	static std::wstring GetCachePath(const std::wstring& objFile);
+	static bool Write(const std::wstring& cacheFile, const MeshData& meshData, uint64_t sourceSize, int64_t sourceTime);
+
+	const Vertex* GetVertices() { return vertices; }
+	const unsigned int* GetIndices() { return indices; }
+	unsigned int GetVertexCount() { return header ? header->VertexCount : 0; }
+	unsigned int GetIndexCount() { return header ? header->IndexCount : 0; }
+	DirectX::XMFLOAT3 GetBoundsMin() { return header ? header->BoundsMin : DirectX::XMFLOAT3(0, 0, 0); }
+	DirectX::XMFLOAT3 GetBoundsMax() { return header ? header->BoundsMax : DirectX::XMFLOAT3(0, 0, 0); }
+
+	// True if the last Load() had to parse the .obj
+	bool WasRebuilt() { return rebuilt; }
+};
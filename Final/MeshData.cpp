@@ -0,0 +1,369 @@
+#include "MeshData.h"
+#include "MappedFile.h"
+#include "ObjParser.h"
+#include "Parallel.h"
+#include <DirectXMath.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Maps the file and hands its bytes straight to the parser
+// - Nothing is copied or read line-by-line
+// --------------------------------------------------------
+bool LoadOBJ(const std::wstring& objFile, MeshData& meshData, unsigned int threadCount)
+{
+	MappedFile file;
+	if (!file.Open(objFile))
+		return false;
+
+	return ParseOBJ(file.GetData(), file.GetSize(), meshData, threadCount);
+}
+
+// --------------------------------------------------------
+// Author: Chris Cascioli
+// Purpose: Calculates the tangents of the vertices in a mesh
+// 
+// - You are allowed to directly copy/paste this into your code base
+//   for assignments, given that you clearly cite that this is not
+//   code of your own design.
+//
+// - Code originally adapted from: http://www.terathon.com/code/tangent.html
+//   - Updated version now found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
+//   - See listing 7.4 in section 7.5 (page 9 of the PDF)
+//
+// - Note: For this code to work, your Vertex format must
+//         contain an XMFLOAT3 called Tangent
+//
+// - Be sure to call this BEFORE creating your D3D vertex/index buffers
+// --------------------------------------------------------
+void CalculateTangentsScalar(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+{
+	// Reset tangents
+	for (int i = 0; i < numVerts; i++)
+	{
+		verts[i].Tangent = XMFLOAT3(0, 0, 0);
+	}
+
+	// Calculate tangents one whole triangle at a time
+	for (int i = 0; i < numIndices;)
+	{
+		// Grab indices and vertices of first triangle
+		unsigned int i1 = indices[i++];
+		unsigned int i2 = indices[i++];
+		unsigned int i3 = indices[i++];
+		Vertex* v1 = &verts[i1];
+		Vertex* v2 = &verts[i2];
+		Vertex* v3 = &verts[i3];
+
+		// Calculate vectors relative to triangle positions
+		float x1 = v2->Position.x - v1->Position.x;
+		float y1 = v2->Position.y - v1->Position.y;
+		float z1 = v2->Position.z - v1->Position.z;
+
+		float x2 = v3->Position.x - v1->Position.x;
+		float y2 = v3->Position.y - v1->Position.y;
+		float z2 = v3->Position.z - v1->Position.z;
+
+		// Do the same for vectors relative to triangle uv's
+		float s1 = v2->UV.x - v1->UV.x;
+		float t1 = v2->UV.y - v1->UV.y;
+
+		float s2 = v3->UV.x - v1->UV.x;
+		float t2 = v3->UV.y - v1->UV.y;
+
+		// Create vectors for tangent calculation
+		float r = 1.0f / (s1 * t2 - s2 * t1);
+
+		float tx = (t2 * x1 - t1 * x2) * r;
+		float ty = (t2 * y1 - t1 * y2) * r;
+		float tz = (t2 * z1 - t1 * z2) * r;
+
+		// Adjust tangents of each vert of the triangle
+		v1->Tangent.x += tx;
+		v1->Tangent.y += ty;
+		v1->Tangent.z += tz;
+
+		v2->Tangent.x += tx;
+		v2->Tangent.y += ty;
+		v2->Tangent.z += tz;
+
+		v3->Tangent.x += tx;
+		v3->Tangent.y += ty;
+		v3->Tangent.z += tz;
+	}
+
+	// Ensure all of the tangents are orthogonal to the normals
+	for (int i = 0; i < numVerts; i++)
+	{
+		// Grab the two vectors
+		XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
+		XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
+
+		// Use Gram-Schmidt orthonormalize to ensure
+		// the normal and tangent are exactly 90 degrees apart
+		tangent = XMVector3Normalize(
+			tangent - normal * XMVector3Dot(normal, tangent));
+
+		// Store the tangent
+		XMStoreFloat3(&verts[i].Tangent, tangent);
+	}
+}
+
+namespace
+{
+	// Smaller meshes aren't worth splitting across threads
+	const size_t MinVerticesPerThread = 64 * 1024;
+
+	// The (unnormalized) tangent of triangle t, the same way
+	// CalculateTangentsScalar() calculates it, so results match exactly
+	XMFLOAT3 CalculateTriangleTangent(const Vertex* verts, const unsigned int* indices, size_t t)
+	{
+		const Vertex* v1 = &verts[indices[t * 3]];
+		const Vertex* v2 = &verts[indices[t * 3 + 1]];
+		const Vertex* v3 = &verts[indices[t * 3 + 2]];
+
+		float x1 = v2->Position.x - v1->Position.x;
+		float y1 = v2->Position.y - v1->Position.y;
+		float z1 = v2->Position.z - v1->Position.z;
+		float x2 = v3->Position.x - v1->Position.x;
+		float y2 = v3->Position.y - v1->Position.y;
+		float z2 = v3->Position.z - v1->Position.z;
+
+		float s1 = v2->UV.x - v1->UV.x;
+		float t1 = v2->UV.y - v1->UV.y;
+		float s2 = v3->UV.x - v1->UV.x;
+		float t2 = v3->UV.y - v1->UV.y;
+
+		float r = 1.0f / (s1 * t2 - s2 * t1);
+		return XMFLOAT3((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r, (t2 * z1 - t1 * z2) * r);
+	}
+
+	// One corner's position and u, which sit together in Vertex
+	XMVECTOR LoadPositionU(const Vertex& v)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&v.Position));
+	}
+
+	// --------------------------------------------------------
+	// The tangents of triangles [first, first + 4), as their
+	// x, y and z in one vector each
+	// - Transposes the four triangles' corners into x, y, z
+	//   and u vectors (v is gathered on its own), then runs
+	//   CalculateTriangleTangent()'s math once for all four,
+	//   in the same order, so each lane matches it exactly
+	// --------------------------------------------------------
+	void CalculateTriangleTangents(const Vertex* verts, const unsigned int* indices, size_t first, XMVECTOR& tx, XMVECTOR& ty, XMVECTOR& tz)
+	{
+		const unsigned int* corners = indices + first * 3;
+		XMVECTOR x[3], y[3], z[3], u[3], v[3];
+		for (int c = 0; c < 3; c++)
+		{
+			const Vertex& a = verts[corners[c]];
+			const Vertex& b = verts[corners[3 + c]];
+			const Vertex& d = verts[corners[6 + c]];
+			const Vertex& e = verts[corners[9 + c]];
+			XMMATRIX batch = XMMatrixTranspose(XMMATRIX(LoadPositionU(a), LoadPositionU(b), LoadPositionU(d), LoadPositionU(e)));
+			x[c] = batch.r[0];
+			y[c] = batch.r[1];
+			z[c] = batch.r[2];
+			u[c] = batch.r[3];
+			v[c] = XMVectorSet(a.UV.y, b.UV.y, d.UV.y, e.UV.y);
+		}
+
+		XMVECTOR x1 = x[1] - x[0];
+		XMVECTOR y1 = y[1] - y[0];
+		XMVECTOR z1 = z[1] - z[0];
+		XMVECTOR x2 = x[2] - x[0];
+		XMVECTOR y2 = y[2] - y[0];
+		XMVECTOR z2 = z[2] - z[0];
+
+		XMVECTOR s1 = u[1] - u[0];
+		XMVECTOR t1 = v[1] - v[0];
+		XMVECTOR s2 = u[2] - u[0];
+		XMVECTOR t2 = v[2] - v[0];
+
+		XMVECTOR r = XMVectorReciprocal(s1 * t2 - s2 * t1);
+		tx = (t2 * x1 - t1 * x2) * r;
+		ty = (t2 * y1 - t1 * y2) * r;
+		tz = (t2 * z1 - t1 * z2) * r;
+	}
+
+	// Triangle tangents for [begin, end), four at a time, then the leftovers
+	template<typename Use>
+	void ForEachTriangleTangent(const Vertex* verts, const unsigned int* indices, size_t begin, size_t end, Use use)
+	{
+		size_t t = begin;
+		for (; t + 4 <= end; t += 4)
+		{
+			XMVECTOR tx, ty, tz;
+			CalculateTriangleTangents(verts, indices, t, tx, ty, tz);
+
+			XMFLOAT4A x, y, z;
+			XMStoreFloat4A(&x, tx);
+			XMStoreFloat4A(&y, ty);
+			XMStoreFloat4A(&z, tz);
+			use(t, XMFLOAT3(x.x, y.x, z.x));
+			use(t + 1, XMFLOAT3(x.y, y.y, z.y));
+			use(t + 2, XMFLOAT3(x.z, y.z, z.z));
+			use(t + 3, XMFLOAT3(x.w, y.w, z.w));
+		}
+		for (; t < end; t++)
+			use(t, CalculateTriangleTangent(verts, indices, t));
+	}
+
+	void AddTangent(Vertex& v, const XMFLOAT3& tangent)
+	{
+		v.Tangent.x += tangent.x;
+		v.Tangent.y += tangent.y;
+		v.Tangent.z += tangent.z;
+	}
+
+	// Gram-Schmidt orthonormalizes [begin, end)'s tangents against their normals
+	void OrthonormalizeTangents(Vertex* verts, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
+			XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
+			tangent = XMVector3Normalize(
+				tangent - normal * XMVector3Dot(normal, tangent));
+			XMStoreFloat3(&verts[i].Tangent, tangent);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Calculates per-vertex tangents four triangles at a time,
+// splitting big meshes across threads
+//
+// - On one thread each batch's tangents are added straight
+//   into its corners, in triangle order, like the scalar
+//   version
+// - On more, scattering into shared vertices would race, so
+//   each thread owns a range of vertices:
+//    1. Triangle tangents are calculated in parallel into
+//       their own array, counting each thread's corners by
+//       the thread owning their vertex
+//    2. Each thread copies its corners into the owners'
+//       lists, placed after earlier threads' corners, so
+//       every list is in triangle order
+//    3. Each owner adds up just its own list
+//   No locks or atomics, each pass only visits a thread's
+//   share of the corners, and every vertex still sums its
+//   triangles in order, so results are identical
+// --------------------------------------------------------
+void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices, unsigned int threadCount)
+{
+	if (numVerts <= 0)
+		return;
+
+	size_t triangleCount = numIndices > 0 ? (size_t)numIndices / 3 : 0;
+	size_t threads = ChooseThreadCount((size_t)numVerts, MinVerticesPerThread, threadCount);
+	if (threads == 1)
+	{
+		for (int v = 0; v < numVerts; v++)
+			verts[v].Tangent = XMFLOAT3(0, 0, 0);
+
+		ForEachTriangleTangent(verts, indices, 0, triangleCount, [&](size_t t, const XMFLOAT3& tangent) {
+			AddTangent(verts[indices[t * 3]], tangent);
+			AddTangent(verts[indices[t * 3 + 1]], tangent);
+			AddTangent(verts[indices[t * 3 + 2]], tangent);
+		});
+
+		OrthonormalizeTangents(verts, 0, (size_t)numVerts);
+		return;
+	}
+
+	// Thread i owns vertices [vertexStarts[i], vertexStarts[i + 1])
+	std::vector<size_t> vertexStarts(threads + 1);
+	for (size_t i = 0; i <= threads; i++)
+		vertexStarts[i] = numVerts * i / threads;
+
+	// The thread owning vertex v, without a division per corner: scaling
+	// only estimates it, as the ranges are rounded, so the estimate can be
+	// one range off
+	double ownerScale = (double)threads / numVerts;
+	auto owner = [&](unsigned int v) {
+		size_t o = std::min((size_t)(v * ownerScale), threads - 1);
+		if (v < vertexStarts[o])
+			o--;
+		else if (v >= vertexStarts[o + 1])
+			o++;
+		return o;
+	};
+
+	// Left uninitialized, since every element gets written
+	std::unique_ptr<XMFLOAT3[]> triangleTangents(new XMFLOAT3[triangleCount]);
+	std::vector<size_t> cornerCounts(threads * threads, 0); // [thread * threads + owner]
+	RunInParallel(threads, [&](size_t i) {
+		size_t begin = triangleCount * i / threads;
+		size_t end = triangleCount * (i + 1) / threads;
+		ForEachTriangleTangent(verts, indices, begin, end, [&](size_t t, const XMFLOAT3& tangent) {
+			triangleTangents[t] = tangent;
+		});
+
+		size_t* counts = &cornerCounts[i * threads];
+		for (size_t c = begin * 3; c < end * 3; c++)
+			counts[owner(indices[c])]++;
+	});
+
+	// Each owner's list holds thread 0's corners, then thread 1's...
+	std::vector<size_t> listStarts(threads + 1, 0);
+	std::vector<size_t> cornerOffsets(threads * threads);
+	size_t offset = 0;
+	for (size_t o = 0; o < threads; o++)
+	{
+		listStarts[o] = offset;
+		for (size_t i = 0; i < threads; i++)
+		{
+			cornerOffsets[i * threads + o] = offset;
+			offset += cornerCounts[i * threads + o];
+		}
+	}
+	listStarts[threads] = offset;
+
+	// Corners by their place in the index list, which gives both vertex and triangle
+	std::unique_ptr<unsigned int[]> corners(new unsigned int[offset]);
+	RunInParallel(threads, [&](size_t i) {
+		size_t begin = triangleCount * i / threads;
+		size_t end = triangleCount * (i + 1) / threads;
+		size_t* offsets = &cornerOffsets[i * threads];
+		for (size_t c = begin * 3; c < end * 3; c++)
+			corners[offsets[owner(indices[c])]++] = (unsigned int)c;
+	});
+
+	RunInParallel(threads, [&](size_t o) {
+		size_t begin = vertexStarts[o];
+		size_t end = vertexStarts[o + 1];
+		for (size_t v = begin; v < end; v++)
+			verts[v].Tangent = XMFLOAT3(0, 0, 0);
+
+		for (size_t n = listStarts[o]; n < listStarts[o + 1]; n++)
+			AddTangent(verts[indices[corners[n]]], triangleTangents[corners[n] / 3]);
+
+		OrthonormalizeTangents(verts, begin, end);
+	});
+}
+
+void CalculateBounds(const Vertex* verts, size_t numVerts, XMFLOAT3& boundsMin, XMFLOAT3& boundsMax)
+{
+	if (numVerts == 0)
+	{
+		boundsMin = boundsMax = XMFLOAT3(0, 0, 0);
+		return;
+	}
+
+	XMVECTOR lo = XMLoadFloat3(&verts[0].Position);
+	XMVECTOR hi = lo;
+	for (size_t i = 1; i < numVerts; i++)
+	{
+		XMVECTOR position = XMLoadFloat3(&verts[i].Position);
+		lo = XMVectorMin(lo, position);
+		hi = XMVectorMax(hi, position);
+	}
+	XMStoreFloat3(&boundsMin, lo);
+	XMStoreFloat3(&boundsMax, hi);
+}
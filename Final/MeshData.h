@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Vertex.h"
+#include <DirectXMath.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// CPU-side geometry for a mesh, kept separate from the
+// D3D buffers so loading can run (and be measured)
+// without a device
+// --------------------------------------------------------
+struct MeshData
+{
+	std::vector<Vertex> Vertices;
+	std::vector<unsigned int> Indices;
+};
+
+// Loads an .obj file into CPU-side vertex and index data
+// - Duplicate corners are welded, so vertices are shared between faces
+// - Large files are parsed on up to threadCount threads (0 = one per core)
+// - Returns false if the file could not be opened
+bool LoadOBJ(const std::wstring& objFile, MeshData& meshData, unsigned int threadCount = 0);
+
+// Calculates per-vertex tangents from positions, uvs and normals
+// - Triangles go through SIMD four at a time, split across up to
+//   threadCount threads (0 = one per core)
+// - Results are the same as CalculateTangentsScalar()'s
+void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices, unsigned int threadCount = 0);
+
+// The original one-triangle-at-a-time version, kept as a reference
+void CalculateTangentsScalar(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+
+// Axis-aligned bounds of every vertex position (zero for no vertices)
+void CalculateBounds(const Vertex* verts, size_t numVerts, DirectX::XMFLOAT3& boundsMin, DirectX::XMFLOAT3& boundsMax);
@@ -0,0 +1,584 @@
+#include "ObjParser.h"
+#include "Parallel.h"
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// Every power of ten that is exact as a double
+	const double PowersOfTen[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	// Most significant digits kept before the rest only shift the exponent
+	const int MaxMantissaDigits = 19;
+
+	inline bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+	inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+	inline const char* SkipSpaces(const char* p, const char* end)
+	{
+		while (p < end && IsSpace(*p)) p++;
+		return p;
+	}
+
+	// Returns the start of the next line
+	inline const char* SkipLine(const char* p, const char* end)
+	{
+		const char* newline = (const char*)memchr(p, '\n', end - p);
+		return newline ? newline + 1 : end;
+	}
+
+	// --------------------------------------------------------
+	// Scans a decimal float like -1.25e-3 starting at p
+	// - Returns the position after the number, or null if
+	//   there wasn't one
+	// --------------------------------------------------------
+	const char* ParseFloat(const char* p, const char* end, float& value)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = (*p == '-');
+			p++;
+		}
+
+		uint64_t mantissa = 0;
+		int exponent = 0;
+		int digits = 0;
+		bool anyDigits = false;
+
+		// Whole part
+		for (; p < end && IsDigit(*p); p++)
+		{
+			anyDigits = true;
+			if (digits < MaxMantissaDigits)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0) digits++;
+			}
+			else exponent++;
+		}
+
+		// Fractional part
+		if (p < end && *p == '.')
+		{
+			for (p++; p < end && IsDigit(*p); p++)
+			{
+				anyDigits = true;
+				if (digits < MaxMantissaDigits)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					if (mantissa != 0) digits++;
+					exponent--;
+				}
+			}
+		}
+
+		if (!anyDigits)
+			return 0;
+
+		// Exponent
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char* e = p + 1;
+			bool negativeExponent = false;
+			if (e < end && (*e == '-' || *e == '+'))
+			{
+				negativeExponent = (*e == '-');
+				e++;
+			}
+
+			if (e < end && IsDigit(*e))
+			{
+				int explicitExponent = 0;
+				for (; e < end && IsDigit(*e); e++)
+				{
+					if (explicitExponent < 10000)
+						explicitExponent = explicitExponent * 10 + (*e - '0');
+				}
+				exponent += negativeExponent ? -explicitExponent : explicitExponent;
+				p = e;
+			}
+		}
+
+		// Scale by exact powers of ten so the common cases round correctly
+		double result = (double)mantissa;
+		if (mantissa != 0)
+		{
+			while (exponent > 22) { result *= 1e22; exponent -= 22; }
+			while (exponent < -22) { result /= 1e22; exponent += 22; }
+			if (exponent > 0) result *= PowersOfTen[exponent];
+			else if (exponent < 0) result /= PowersOfTen[-exponent];
+		}
+
+		value = (float)(negative ? -result : result);
+		return p;
+	}
+
+	// Scans a (possibly negative) integer starting at p
+	const char* ParseInt(const char* p, const char* end, long long& value)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = (*p == '-');
+			p++;
+		}
+
+		if (p >= end || !IsDigit(*p))
+			return 0;
+
+		long long result = 0;
+		for (; p < end && IsDigit(*p); p++)
+			result = result * 10 + (*p - '0');
+
+		value = negative ? -result : result;
+		return p;
+	}
+
+	// --------------------------------------------------------
+	// Turns a 1-based (or negative, relative) OBJ index into
+	// a 0-based one
+	// - Returns false if it points outside of the list
+	// --------------------------------------------------------
+	inline bool ResolveIndex(long long index, size_t count, size_t& resolved)
+	{
+		if (index > 0 && (size_t)index <= count)
+		{
+			resolved = (size_t)index - 1;
+			return true;
+		}
+		if (index < 0 && (size_t)-index <= count)
+		{
+			resolved = count - (size_t)-index;
+			return true;
+		}
+		return false;
+	}
+
+	// --------------------------------------------------------
+	// Identifies one face corner by the OBJ elements it uses
+	// - Position is 0-based, UV and Normal are 1-based with
+	//   0 meaning "not given"
+	// --------------------------------------------------------
+	struct CornerKey
+	{
+		uint32_t Position;
+		uint32_t UV;
+		uint32_t Normal;
+
+		bool operator==(const CornerKey& other) const
+		{
+			return Position == other.Position && UV == other.UV && Normal == other.Normal;
+		}
+	};
+
+	// Marks an unused slot in the welding table
+	const uint32_t EmptySlot = 0xFFFFFFFF;
+
+	// --------------------------------------------------------
+	// Open-addressing hash table from corner keys to the index
+	// of the vertex already built for that corner, so every
+	// unique position/uv/normal combination becomes exactly
+	// one vertex
+	// --------------------------------------------------------
+	class VertexWelder
+	{
+	private:
+		std::vector<uint32_t> slots;	// Vertex index, or EmptySlot
+		std::vector<CornerKey> keys;	// Key of each welded vertex
+		size_t mask;
+
+		static size_t Hash(const CornerKey& key)
+		{
+			uint64_t h = key.Position * 0x9E3779B97F4A7C15ull;
+			h ^= key.UV * 0xC2B2AE3D27D4EB4Full;
+			h ^= key.Normal * 0x165667B19E3779F9ull;
+			h ^= h >> 29;
+			return (size_t)h;
+		}
+
+		void Rehash(size_t slotCount)
+		{
+			slots.assign(slotCount, EmptySlot);
+			mask = slotCount - 1;
+			for (uint32_t i = 0; i < (uint32_t)keys.size(); i++)
+			{
+				size_t slot = Hash(keys[i]) & mask;
+				while (slots[slot] != EmptySlot)
+					slot = (slot + 1) & mask;
+				slots[slot] = i;
+			}
+		}
+
+	public:
+		VertexWelder() : mask(0) {}
+
+		// Sizes the table so expectedVertices fit without growing
+		void Reserve(size_t expectedVertices)
+		{
+			size_t slotCount = 16;
+			while (slotCount < expectedVertices * 2)
+				slotCount *= 2;
+			keys.reserve(expectedVertices);
+			Rehash(slotCount);
+		}
+
+		// --------------------------------------------------------
+		// Looks up the vertex for this corner
+		// - Returns true if it was newly added, in which case the
+		//   caller must build and append the vertex itself
+		// --------------------------------------------------------
+		bool FindOrAdd(const CornerKey& key, uint32_t& index)
+		{
+			// Keep the load factor at or below one half
+			if ((keys.size() + 1) * 2 > slots.size())
+				Rehash(slots.empty() ? 16 : slots.size() * 2);
+
+			size_t slot = Hash(key) & mask;
+			while (slots[slot] != EmptySlot)
+			{
+				if (keys[slots[slot]] == key)
+				{
+					index = slots[slot];
+					return false;
+				}
+				slot = (slot + 1) & mask;
+			}
+
+			index = (uint32_t)keys.size();
+			slots[slot] = index;
+			keys.push_back(key);
+			return true;
+		}
+	};
+
+	// Parses up to count floats separated by spaces
+	const char* ParseFloats(const char* p, const char* end, float* values, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			p = ParseFloat(SkipSpaces(p, end), end, values[i]);
+			if (!p) return 0;
+		}
+		return p;
+	}
+
+	// Number of each kind of element in (or before) a chunk
+	struct ElementCounts
+	{
+		size_t Positions;
+		size_t Normals;
+		size_t UVs;
+		size_t Faces;
+	};
+
+	// --------------------------------------------------------
+	// A run of whole lines parsed independently of the others
+	// - Offsets are where this chunk's elements start in the
+	//   file-wide arrays (a prefix sum of earlier chunks)
+	// - Corners holds three resolved keys per triangle, in
+	//   file order
+	// --------------------------------------------------------
+	struct Chunk
+	{
+		const char* Begin;
+		const char* End;
+		ElementCounts Counts;
+		ElementCounts Offsets;
+		std::vector<CornerKey> Corners;
+		bool Succeeded;
+	};
+
+	// Chunks smaller than this aren't worth a thread
+	const size_t MinChunkBytes = 1024 * 1024;
+
+	// --------------------------------------------------------
+	// Splits the text into at most chunkCount pieces, each
+	// ending right after a newline (or at the end of the text)
+	// --------------------------------------------------------
+	void SplitIntoChunks(const char* data, size_t size, size_t chunkCount, std::vector<Chunk>& chunks)
+	{
+		const char* end = data + size;
+		const char* p = data;
+		size_t chunkSize = size / chunkCount;
+
+		while (p < end)
+		{
+			const char* chunkEnd = end;
+			if (chunks.size() + 1 < chunkCount && (size_t)(end - p) > chunkSize)
+				chunkEnd = SkipLine(p + chunkSize, end);
+
+			Chunk chunk = {};
+			chunk.Begin = p;
+			chunk.End = chunkEnd;
+			chunks.push_back(std::move(chunk));
+			p = chunkEnd;
+		}
+	}
+
+	// Counts each kind of line, classifying them exactly like ParseChunk
+	void CountChunk(Chunk& chunk)
+	{
+		ElementCounts& counts = chunk.Counts;
+		const char* p = chunk.Begin;
+		const char* end = chunk.End;
+
+		while (p < end)
+		{
+			p = SkipSpaces(p, end);
+			if (p + 1 < end)
+			{
+				if (p[0] == 'v')
+				{
+					if (IsSpace(p[1])) counts.Positions++;
+					else if (p[1] == 'n') counts.Normals++;
+					else if (p[1] == 't') counts.UVs++;
+				}
+				else if (p[0] == 'f' && IsSpace(p[1])) counts.Faces++;
+			}
+			p = SkipLine(p, end);
+		}
+	}
+
+	// --------------------------------------------------------
+	// Parses one chunk's lines
+	// - Positions, normals and uvs go straight into the shared
+	//   arrays at this chunk's offsets
+	// - Face indices are resolved against the number of
+	//   elements seen so far in the whole file, so negative
+	//   (relative) indices work across chunk boundaries
+	// --------------------------------------------------------
+	bool ParseChunk(Chunk& chunk, XMFLOAT3* positions, XMFLOAT3* normals, XMFLOAT2* uvs)
+	{
+		size_t positionCount = chunk.Offsets.Positions;
+		size_t normalCount = chunk.Offsets.Normals;
+		size_t uvCount = chunk.Offsets.UVs;
+
+		std::vector<CornerKey> faceCorners;	// Corners of the current face
+		chunk.Corners.reserve(chunk.Counts.Faces * 6);
+
+		const char* p = chunk.Begin;
+		const char* end = chunk.End;
+
+		while (p < end)
+		{
+			p = SkipSpaces(p, end);
+			if (p >= end)
+				break;
+
+			char next = (p + 1 < end) ? p[1] : 0;
+
+			if (p[0] == 'v' && IsSpace(next))
+			{
+				if (!ParseFloats(p + 1, end, &positions[positionCount].x, 3))
+					return false;
+				positionCount++;
+			}
+			else if (p[0] == 'v' && next == 'n')
+			{
+				if (!ParseFloats(p + 2, end, &normals[normalCount].x, 3))
+					return false;
+				normalCount++;
+			}
+			else if (p[0] == 'v' && next == 't')
+			{
+				// The v coordinate is optional in the spec
+				XMFLOAT2 uv(0, 0);
+				const char* afterU = ParseFloat(SkipSpaces(p + 2, end), end, uv.x);
+				if (!afterU)
+					return false;
+				ParseFloat(SkipSpaces(afterU, end), end, uv.y);
+				uvs[uvCount++] = uv;
+			}
+			else if (p[0] == 'f' && IsSpace(next))
+			{
+				faceCorners.clear();
+				p = SkipSpaces(p + 1, end);
+
+				// Each corner is v, v/t, v//n or v/t/n
+				while (p < end && *p != '\n' && *p != '\r' && *p != '#')
+				{
+					long long posIndex = 0;
+					long long uvIndex = 0;
+					long long normalIndex = 0;
+
+					p = ParseInt(p, end, posIndex);
+					if (!p) return false;
+
+					if (p < end && *p == '/')
+					{
+						p++;
+						if (p < end && *p != '/')
+						{
+							p = ParseInt(p, end, uvIndex);
+							if (!p) return false;
+						}
+						if (p < end && *p == '/')
+						{
+							p = ParseInt(p + 1, end, normalIndex);
+							if (!p) return false;
+						}
+					}
+
+					// - OBJ indices are 1-based, or negative to count back
+					//    from the most recent entry
+					// - Missing uvs and normals are stored as 0
+					size_t resolvedPosition = 0;
+					size_t resolvedUV = 0;
+					size_t resolvedNormal = 0;
+					if (!ResolveIndex(posIndex, positionCount, resolvedPosition))
+						return false;
+					if (uvIndex != 0 && !ResolveIndex(uvIndex, uvCount, resolvedUV))
+						return false;
+					if (normalIndex != 0 && !ResolveIndex(normalIndex, normalCount, resolvedNormal))
+						return false;
+
+					CornerKey key;
+					key.Position = (uint32_t)resolvedPosition;
+					key.UV = uvIndex != 0 ? (uint32_t)resolvedUV + 1 : 0;
+					key.Normal = normalIndex != 0 ? (uint32_t)resolvedNormal + 1 : 0;
+					faceCorners.push_back(key);
+
+					p = SkipSpaces(p, end);
+				}
+
+				// Fan triangulate, flipping the winding order
+				// - Quads become (1,3,2) and (1,4,3), as before
+				for (size_t i = 2; i < faceCorners.size(); i++)
+				{
+					chunk.Corners.push_back(faceCorners[0]);
+					chunk.Corners.push_back(faceCorners[i]);
+					chunk.Corners.push_back(faceCorners[i - 1]);
+				}
+			}
+
+			// Anything else (comments, groups, materials) is ignored
+			p = SkipLine(p, end);
+		}
+
+		return true;
+	}
+
+	// Builds the final vertex for a welded corner
+	inline Vertex BuildVertex(const CornerKey& key, const XMFLOAT3* positions, const XMFLOAT3* normals, const XMFLOAT2* uvs)
+	{
+		// Missing uvs and normals fall back to zero
+		Vertex v = {};
+		v.Position = positions[key.Position];
+		if (key.UV) v.UV = uvs[key.UV - 1];
+		if (key.Normal) v.Normal = normals[key.Normal - 1];
+
+		// The model is most likely in a right-handed space,
+		// so convert to DirectX's left-handed space:
+		//  - Invert the Z position and the normal's Z
+		//  - Flip the UV's V, since DirectX puts (0,0) at the top left
+		//  - The winding order was already flipped when triangulating
+		v.UV.y = 1.0f - v.UV.y;
+		v.Position.z *= -1.0f;
+		v.Normal.z *= -1.0f;
+		return v;
+	}
+}
+
+// --------------------------------------------------------
+// Parses in four passes:
+//  1. Count each chunk's elements (parallel)
+//  2. Prefix-sum the counts into per-chunk offsets
+//  3. Parse each chunk at its offsets (parallel)
+//  4. Weld corners in file order, then build the unique
+//     vertices (parallel)
+// Welding in file order is what keeps the output identical
+// no matter how many threads were used
+// --------------------------------------------------------
+bool ParseOBJ(const char* data, size_t size, MeshData& meshData, unsigned int threadCount)
+{
+	std::vector<Vertex>& verts = meshData.Vertices;
+	std::vector<unsigned int>& indices = meshData.Indices;
+	verts.clear();
+	indices.clear();
+
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	size_t chunkCount = std::min((size_t)threadCount, size / MinChunkBytes + 1);
+	std::vector<Chunk> chunks;
+	SplitIntoChunks(data, size, chunkCount, chunks);
+	if (chunks.empty())
+		return true;
+
+	// Pass 1: count
+	RunInParallel(chunks.size(), [&](size_t i) { CountChunk(chunks[i]); });
+
+	// Pass 2: stitch the chunks together with prefix sums
+	ElementCounts totals = {};
+	for (auto& chunk : chunks)
+	{
+		chunk.Offsets = totals;
+		totals.Positions += chunk.Counts.Positions;
+		totals.Normals += chunk.Counts.Normals;
+		totals.UVs += chunk.Counts.UVs;
+		totals.Faces += chunk.Counts.Faces;
+	}
+
+	// Pass 3: parse
+	std::vector<XMFLOAT3> positions(totals.Positions);	// Positions from the file
+	std::vector<XMFLOAT3> normals(totals.Normals);		// Normals from the file
+	std::vector<XMFLOAT2> uvs(totals.UVs);				// UVs from the file
+
+	RunInParallel(chunks.size(), [&](size_t i) {
+		chunks[i].Succeeded = ParseChunk(chunks[i], positions.data(), normals.data(), uvs.data());
+	});
+
+	size_t cornerCount = 0;
+	for (auto& chunk : chunks)
+	{
+		if (!chunk.Succeeded)
+			return false;
+		cornerCount += chunk.Corners.size();
+	}
+
+	// Pass 4: weld, so every unique position/uv/normal combination
+	// becomes exactly one vertex
+	// - Welded meshes usually end up with about one vertex per position
+	VertexWelder welder;
+	std::vector<CornerKey> uniqueCorners;
+	welder.Reserve(totals.Positions);
+	uniqueCorners.reserve(totals.Positions);
+	indices.resize(cornerCount);
+
+	size_t nextIndex = 0;
+	for (auto& chunk : chunks)
+	{
+		for (const CornerKey& key : chunk.Corners)
+		{
+			uint32_t vertIndex = 0;
+			if (welder.FindOrAdd(key, vertIndex))
+				uniqueCorners.push_back(key);
+			indices[nextIndex++] = vertIndex;
+		}
+
+		// Free each chunk's corners as soon as we're done with them
+		std::vector<CornerKey>().swap(chunk.Corners);
+	}
+
+	verts.resize(uniqueCorners.size());
+	size_t vertsPerThread = (verts.size() + chunks.size() - 1) / chunks.size();
+	RunInParallel(chunks.size(), [&](size_t i) {
+		size_t first = i * vertsPerThread;
+		size_t last = std::min(verts.size(), first + vertsPerThread);
+		for (size_t v = first; v < last; v++)
+			verts[v] = BuildVertex(uniqueCorners[v], positions.data(), normals.data(), uvs.data());
+	});
+
+	return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "MeshData.h"
+#include <cstddef>
+
+// --------------------------------------------------------
+// Parses .obj text that is already in memory (usually a
+// MappedFile) into CPU-side mesh data
+//
+// - Supports positions, uvs, normals and faces with any
+//   number of corners in v, v/t, v//n or v/t/n form
+// - Numbers are scanned by hand: no locale, no per-line
+//   copies, no sscanf
+// - Corners that share a position, uv and normal are welded
+//   into a single vertex, so the output is genuinely indexed
+// - Large files are split at line boundaries and parsed on
+//   up to threadCount threads (0 = one per core); the output
+//   is identical for any thread count
+// - Returns false if the text is malformed
+// --------------------------------------------------------
+bool ParseOBJ(const char* data, size_t size, MeshData& meshData, unsigned int threadCount = 0);
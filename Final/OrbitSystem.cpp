@@ -0,0 +1,34 @@
+#include "OrbitSystem.h"
+#include <DirectXMath.h>
+
+using namespace DirectX;
+
+// ctor
+OrbitSystem::OrbitSystem()
+{}
+
+TransformStore::Handle OrbitSystem::AddOrbit(TransformStore& scene, TransformStore::Handle center, float radius, float degreesPerSecond) {
+	TransformStore::Handle pivot = scene.Create(center);
+	TransformStore::Handle anchor = scene.Create(pivot);
+
+	// Yaw carries +Z around to +X, same as the old sin/cos placement
+	scene.SetPosition(anchor, 0, 0, radius);
+
+	orbits.push_back({ pivot, anchor, degreesPerSecond, 0.0f });
+	return anchor;
+}
+
+float OrbitSystem::GetAngle(size_t orbit) {
+	return orbits[orbit].Angle;
+}
+
+// Only the pivots and anchors change; the hierarchy pass moves everything under them
+void OrbitSystem::Update(TransformStore& scene, float deltaTime) {
+	for (auto& orbit : orbits) {
+		orbit.Angle += orbit.DegreesPerSecond * deltaTime;
+		if (orbit.Angle >= 360.0f) orbit.Angle -= 360.0f;
+		float radians = XMConvertToRadians(orbit.Angle);
+		scene.SetRotation(orbit.Pivot, 0, radians, 0);
+		scene.SetRotation(orbit.Anchor, 0, -radians, 0);
+	}
+}
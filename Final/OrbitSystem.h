@@ -0,0 +1,40 @@
+#pragma once
+#include "TransformStore.h"
+#include <vector>
+
+// --------------------------------------------------------
+// Circular orbits built out of scene hierarchy nodes
+//
+// - Each orbit is a pivot node under its center that spins
+//   around Y, plus an unscaled anchor node out at the
+//   orbit's radius.  Bodies (and their own orbits, for
+//   moons) go under the anchor, so they follow it without
+//   inheriting the center's scale or any sin/cos math
+// - The anchor turns back by the pivot's angle, so bodies
+//   keep the center's orientation instead of turning with
+//   their orbit
+// - A body's own scale belongs on its own node under the
+//   anchor, so it doesn't reach the body's moons
+// --------------------------------------------------------
+class OrbitSystem
+{
+private:
+	struct Orbit
+	{
+		TransformStore::Handle Pivot;
+		TransformStore::Handle Anchor;
+		float DegreesPerSecond;
+		float Angle; // Degrees
+	};
+
+	std::vector<Orbit> orbits;
+
+public:
+	OrbitSystem();
+
+	// Returns the anchor node to parent the orbiting body to
+	TransformStore::Handle AddOrbit(TransformStore& scene, TransformStore::Handle center, float radius, float degreesPerSecond);
+	float GetAngle(size_t orbit);
+
+	void Update(TransformStore& scene, float deltaTime);
+};
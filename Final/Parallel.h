@@ -0,0 +1,37 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// Runs work(0) .. work(count - 1), each on its own thread
+// - The calling thread takes item 0 itself
+// --------------------------------------------------------
+template<typename Work>
+void RunInParallel(size_t count, Work work)
+{
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < count; i++)
+		threads.emplace_back(work, i);
+
+	if (count > 0)
+		work(0);
+
+	for (auto& t : threads)
+		t.join();
+}
+
+// --------------------------------------------------------
+// How many threads to split itemCount items across, given
+// the smallest batch worth its own thread
+// - threadCount 0 means one per hardware thread
+// --------------------------------------------------------
+inline size_t ChooseThreadCount(size_t itemCount, size_t minItemsPerThread, unsigned int threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	return std::max<size_t>(1, std::min<size_t>(threadCount, itemCount / minItemsPerThread));
+}
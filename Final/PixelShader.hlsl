@@ -1,17 +1,12 @@
-#include "Lighting.hlsli"
+#include "ClusteredLighting.hlsli"
 
-#define LIGHT_COUNT 5
-
-// Input for color
-cbuffer ExternalData : register(b0)
+// Input for color, set when the material changes
+cbuffer PerMaterial : register(b1)
 {
-	float roughness;
 	float3 colorTint;
-	float3 cameraPosition;
+	float roughness;
 	float2 uvScale;
 	float2 uvOffset;
-	float3 ambient;
-	Light lights[LIGHT_COUNT];
 }
 
 Texture2D Albedo			: register(t0);
@@ -45,12 +40,15 @@ float4 main(VertexToPixel input) : SV_TARGET
 
 	float3 finalColor = ambient * surfaceColor;
 
-	for (int i = 0; i < LIGHT_COUNT; i++) {
-		Light light = lights[i];
+	// Only the lights whose range reaches this pixel's cluster
+	LightCluster cluster = GetLightCluster(input.screenPosition);
+	uint clusterLightCount = GetClusterLightCount(cluster);
+	for (uint i = 0; i < clusterLightCount; i++) {
+		Light light = GetClusterLight(cluster, i);
 		light.Direction = normalize(light.Direction);
 
 		// Calculate lighting based on type of light, then add that light's effect to the final color
-		switch (lights[i].Type) {
+		switch (light.Type) {
 		case LIGHT_TYPE_DIRECTIONAL:
 			finalColor += CalculateDirectional(light, cameraPosition, input.worldPosition, input.normal, roughness, metalness, surfaceColor, specularColor);
 			break;
@@ -0,0 +1,100 @@
+#include "RenderQueue.h"
+#include <cstring>
+
+RenderQueue::RenderQueue() :
+	stats()
+{
+}
+
+void RenderQueue::Clear()
+{
+	draws.clear();
+	order.clear();
+}
+
+// New objects get the next id, up to maxId (which is then shared)
+uint32_t RenderQueue::GetId(IdTable& table, const void* object, uint32_t maxId)
+{
+	if (object == table.LastObject && !table.Ids.empty())
+		return table.LastId;
+
+	auto it = table.Ids.find(object);
+	uint32_t id;
+	if (it != table.Ids.end())
+		id = it->second;
+	else
+	{
+		id = std::min((uint32_t)table.Ids.size(), maxId);
+		table.Ids.insert({ object, id });
+	}
+
+	table.LastObject = object;
+	table.LastId = id;
+	return id;
+}
+
+void RenderQueue::Add(uint32_t index, const void* vertexShader, const void* pixelShader, const void* material, const void* mesh, float depth)
+{
+	// Non-negative floats sort the same as their bits, so the top
+	// 16 bits are a coarse depth that needs no near/far range
+	uint32_t depthBits;
+	depth = std::max(depth, 0.0f);
+	memcpy(&depthBits, &depth, sizeof(depthBits));
+
+	uint64_t key =
+		(uint64_t)GetId(vertexShaderIds, vertexShader, 0xFF) << 56 |
+		(uint64_t)GetId(pixelShaderIds, pixelShader, 0xFF) << 48 |
+		(uint64_t)GetId(materialIds, material, 0xFFFF) << 32 |
+		(uint64_t)GetId(meshIds, mesh, 0xFFFF) << 16 |
+		(uint64_t)(depthBits >> 16);
+
+	Draw d = {};
+	d.Index = index;
+	d.VertexShader = vertexShader;
+	d.PixelShader = pixelShader;
+	d.Material = material;
+	d.Mesh = mesh;
+	order.push_back({ key, (uint32_t)draws.size() });
+	draws.push_back(d);
+}
+
+// --------------------------------------------------------
+// Radix sorts the keys a byte at a time, lowest first
+// - Stable, so equal keys keep the order they were added in
+// - Bytes every key shares (e.g. when there's only one
+//   vertex shader) are skipped
+// --------------------------------------------------------
+void RenderQueue::Sort()
+{
+	if (order.empty())
+		return;
+
+	size_t count = order.size();
+	size_t histograms[8][256] = {};
+	for (const SortEntry& e : order)
+	{
+		for (int b = 0; b < 8; b++)
+			histograms[b][(e.Key >> (b * 8)) & 0xFF]++;
+	}
+
+	sortScratch.resize(count);
+	for (int b = 0; b < 8; b++)
+	{
+		size_t* histogram = histograms[b];
+		if (histogram[(order[0].Key >> (b * 8)) & 0xFF] == count)
+			continue;
+
+		// Counts become each byte value's first slot
+		size_t offset = 0;
+		for (int v = 0; v < 256; v++)
+		{
+			size_t n = histogram[v];
+			histogram[v] = offset;
+			offset += n;
+		}
+
+		for (const SortEntry& e : order)
+			sortScratch[histogram[(e.Key >> (b * 8)) & 0xFF]++] = e;
+		order.swap(sortScratch);
+	}
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// --------------------------------------------------------
+// Collects a frame's draws, sorts them by state, and
+// submits them so each piece of state is only bound when
+// it actually changes
+//
+// - Draws are added with the objects they use (shaders,
+//   material, mesh) and their view depth.  Those become a
+//   64-bit key, most expensive state change first:
+//     [vertex shader 8 | pixel shader 8 | material 16 |
+//      mesh 16 | depth 16]
+//   so sorting groups draws by shader, then material, then
+//   mesh, then front to back
+// - Objects get small ids the first time they're seen, and
+//   keep them, so keys (and draw order) are stable between
+//   frames
+// - Submit() compares the objects themselves, not ids, so
+//   even a truncated id never skips a bind it needed
+// - Nothing here touches D3D, so it runs (and is checked)
+//   headless; Game supplies the actual binds
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	struct Stats
+	{
+		size_t Draws;
+		size_t Batches;
+		size_t ShaderBinds;
+		size_t ShaderBindsSkipped;
+		size_t MaterialBinds;
+		size_t MaterialBindsSkipped;
+		size_t MeshBinds;
+		size_t MeshBindsSkipped;
+	};
+
+private:
+	struct Draw
+	{
+		uint32_t Index;
+		const void* VertexShader;
+		const void* PixelShader;
+		const void* Material;
+		const void* Mesh;
+	};
+
+	// Draws stay in the order they were added; sorting only moves these
+	struct SortEntry
+	{
+		uint64_t Key;
+		uint32_t Draw;
+	};
+
+	std::vector<Draw> draws;
+	std::vector<SortEntry> order;
+	std::vector<SortEntry> sortScratch;
+	std::vector<uint32_t> batchIndices;
+	Stats stats;
+
+	// Remembers the last lookup, since runs of draws tend to share objects
+	struct IdTable
+	{
+		std::unordered_map<const void*, uint32_t> Ids;
+		const void* LastObject = 0;
+		uint32_t LastId = 0;
+	};
+
+	IdTable vertexShaderIds;
+	IdTable pixelShaderIds;
+	IdTable materialIds;
+	IdTable meshIds;
+
+	uint32_t GetId(IdTable& table, const void* object, uint32_t maxId);
+
+public:
+	RenderQueue();
+
+	void Clear();
+
+	// index is handed back to the bind/draw callbacks, e.g. an entity index
+	// - Negative depths (behind the camera) sort as 0
+	void Add(uint32_t index, const void* vertexShader, const void* pixelShader, const void* material, const void* mesh, float depth);
+	void Sort();
+
+	// --------------------------------------------------------
+	// Walks the sorted draws, calling each bind only when its
+	// state differs from the previous draw's
+	// - A shader change also rebinds the material, since
+	//   material data lives in the shader's buffers
+	// - Draws sharing shaders, material and mesh form one
+	//   batch, handed to drawBatch as an array of indices so
+	//   it can instance them
+	// - Bind callbacks take the first draw's index
+	// --------------------------------------------------------
+	template<typename BindShaders, typename BindMaterial, typename BindMesh, typename DrawBatch>
+	void SubmitBatches(BindShaders bindShaders, BindMaterial bindMaterial, BindMesh bindMesh, DrawBatch drawBatch)
+	{
+		stats = Stats();
+		const Draw* previous = 0;
+		for (size_t i = 0; i < order.size();)
+		{
+			const Draw& d = draws[order[i].Draw];
+			bool shaderChanged = !previous || d.VertexShader != previous->VertexShader || d.PixelShader != previous->PixelShader;
+			bool materialChanged = shaderChanged || d.Material != previous->Material;
+			bool meshChanged = !previous || d.Mesh != previous->Mesh;
+
+			if (shaderChanged) { bindShaders(d.Index); stats.ShaderBinds++; }
+			if (materialChanged) { bindMaterial(d.Index); stats.MaterialBinds++; }
+			if (meshChanged) { bindMesh(d.Index); stats.MeshBinds++; }
+
+			// Gather the rest of the batch
+			batchIndices.clear();
+			for (; i < order.size(); i++)
+			{
+				const Draw& next = draws[order[i].Draw];
+				if (next.VertexShader != d.VertexShader || next.PixelShader != d.PixelShader || next.Material != d.Material || next.Mesh != d.Mesh)
+					break;
+				batchIndices.push_back(next.Index);
+			}
+
+			drawBatch(batchIndices.data(), batchIndices.size());
+			stats.Draws += batchIndices.size();
+			stats.Batches++;
+			previous = &d;
+		}
+
+		// Every draw after the first could have needed each bind
+		size_t possible = stats.Draws;
+		stats.ShaderBindsSkipped = possible - stats.ShaderBinds;
+		stats.MaterialBindsSkipped = possible - stats.MaterialBinds;
+		stats.MeshBindsSkipped = possible - stats.MeshBinds;
+	}
+
+	// One draw call per draw, for things that can't be instanced
+	template<typename BindShaders, typename BindMaterial, typename BindMesh, typename DrawItem>
+	void Submit(BindShaders bindShaders, BindMaterial bindMaterial, BindMesh bindMesh, DrawItem drawItem)
+	{
+		SubmitBatches(bindShaders, bindMaterial, bindMesh,
+			[&](const uint32_t* indices, size_t count) {
+				for (size_t i = 0; i < count; i++)
+					drawItem(indices[i]);
+			});
+	}
+
+	size_t GetCount() { return draws.size(); }
+	// In sorted order, once sorted
+	uint32_t GetIndex(size_t i) { return draws[order[i].Draw].Index; }
+	uint64_t GetKey(size_t i) { return order[i].Key; }
+
+	// Counts from the last Submit()
+	const Stats& GetStats() { return stats; }
+};
@@ -0,0 +1,17 @@
+#include "RenderSnapshot.h"
+
+using namespace DirectX;
+
+void CaptureTransforms(TransformStore& scene, const TransformStore::Handle* nodes, size_t count, RenderSnapshot& snapshot)
+{
+	snapshot.Worlds.resize(count);
+	snapshot.WorldInvTransposes.resize(count);
+
+	const XMFLOAT4X4* worlds = scene.GetWorldMatrices();
+	const XMFLOAT4X4* worldInvTransposes = scene.GetWorldInverseTransposeMatrices();
+	for (size_t i = 0; i < count; i++)
+	{
+		snapshot.Worlds[i] = worlds[nodes[i]];
+		snapshot.WorldInvTransposes[i] = worldInvTransposes[nodes[i]];
+	}
+}
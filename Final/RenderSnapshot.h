@@ -0,0 +1,42 @@
+#pragma once
+
+#include "TransformStore.h"
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// struct Light and PixelShaderPerMaterial are generated from the shaders
+#include "ShaderConstants.h"
+
+// --------------------------------------------------------
+// Everything drawing a frame reads from the simulation,
+// copied once the update is done so the render thread
+// never touches live game state (see FramePipeline)
+//
+// - Per-object arrays are by entity index: each entity's
+//   world matrices and its material's constants
+// - Meshes, shaders and textures are fixed after loading,
+//   so draws still reach those through the entities
+// --------------------------------------------------------
+struct RenderSnapshot
+{
+	uint64_t Frame = 0;
+	float DeltaTime = 0.0f;
+	float TotalTime = 0.0f;
+
+	DirectX::XMFLOAT4X4 View = {};
+	DirectX::XMFLOAT4X4 Projection = {};
+	DirectX::XMFLOAT3 CameraPosition = {};
+
+	std::vector<DirectX::XMFLOAT4X4> Worlds;
+	std::vector<DirectX::XMFLOAT4X4> WorldInvTransposes;
+	std::vector<PixelShaderPerMaterial> Materials;
+
+	DirectX::XMFLOAT3 Ambient = {};
+	std::vector<Light> Lights;
+};
+
+// Copies the nodes' current matrices into the snapshot's
+// Worlds and WorldInvTransposes, in the nodes' order
+void CaptureTransforms(TransformStore& scene, const TransformStore::Handle* nodes, size_t count, RenderSnapshot& snapshot);
@@ -0,0 +1,96 @@
+// Generated by ShaderStructGen from the shaders' cbuffers - don't edit by hand.
+// Rebuild the shader-constants target (CMakeLists.txt) after changing a cbuffer.
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+
+// struct Light in Lighting.hlsli
+struct Light
+{
+	int32_t Type;
+	DirectX::XMFLOAT3 Direction;
+	float Range;
+	DirectX::XMFLOAT3 Position;
+	float Intensity;
+	DirectX::XMFLOAT3 Color;
+	float SpotFalloff;
+	DirectX::XMFLOAT3 Padding;
+};
+static_assert(offsetof(Light, Type) == 0, "Light::Type doesn't match HLSL packing");
+static_assert(offsetof(Light, Direction) == 4, "Light::Direction doesn't match HLSL packing");
+static_assert(offsetof(Light, Range) == 16, "Light::Range doesn't match HLSL packing");
+static_assert(offsetof(Light, Position) == 20, "Light::Position doesn't match HLSL packing");
+static_assert(offsetof(Light, Intensity) == 32, "Light::Intensity doesn't match HLSL packing");
+static_assert(offsetof(Light, Color) == 36, "Light::Color doesn't match HLSL packing");
+static_assert(offsetof(Light, SpotFalloff) == 48, "Light::SpotFalloff doesn't match HLSL packing");
+static_assert(offsetof(Light, Padding) == 52, "Light::Padding doesn't match HLSL packing");
+static_assert(sizeof(Light) == 64, "Light doesn't match HLSL packing");
+
+// struct LightCluster in ClusteredLighting.hlsli
+struct LightCluster
+{
+	uint32_t Offset;
+	uint32_t Count;
+};
+static_assert(offsetof(LightCluster, Offset) == 0, "LightCluster::Offset doesn't match HLSL packing");
+static_assert(offsetof(LightCluster, Count) == 4, "LightCluster::Count doesn't match HLSL packing");
+static_assert(sizeof(LightCluster) == 8, "LightCluster doesn't match HLSL packing");
+
+// cbuffer PerObject : register(b2) in VertexShader.hlsl
+struct VertexShaderPerObject
+{
+	static constexpr char BufferName[] = "PerObject";
+
+	DirectX::XMFLOAT4X4 worldViewProjection;
+	DirectX::XMFLOAT4X4 world;
+	DirectX::XMFLOAT4X4 worldInvTranspose;
+};
+static_assert(offsetof(VertexShaderPerObject, worldViewProjection) == 0, "VertexShaderPerObject::worldViewProjection doesn't match HLSL packing");
+static_assert(offsetof(VertexShaderPerObject, world) == 64, "VertexShaderPerObject::world doesn't match HLSL packing");
+static_assert(offsetof(VertexShaderPerObject, worldInvTranspose) == 128, "VertexShaderPerObject::worldInvTranspose doesn't match HLSL packing");
+static_assert(sizeof(VertexShaderPerObject) == 192, "VertexShaderPerObject doesn't match HLSL packing");
+
+// cbuffer PerFrame : register(b0) in ClusteredLighting.hlsli
+struct ClusteredLightingPerFrame
+{
+	static constexpr char BufferName[] = "PerFrame";
+
+	DirectX::XMFLOAT3 cameraPosition;
+	float clusterDepthScale;
+	DirectX::XMFLOAT3 ambient;
+	float clusterDepthBias;
+	DirectX::XMFLOAT2 clusterTileScale;
+	uint32_t globalLightCount;
+	float Pad0[1];
+	DirectX::XMUINT3 clusterCounts;
+	float Pad1[1];
+};
+static_assert(offsetof(ClusteredLightingPerFrame, cameraPosition) == 0, "ClusteredLightingPerFrame::cameraPosition doesn't match HLSL packing");
+static_assert(offsetof(ClusteredLightingPerFrame, clusterDepthScale) == 12, "ClusteredLightingPerFrame::clusterDepthScale doesn't match HLSL packing");
+static_assert(offsetof(ClusteredLightingPerFrame, ambient) == 16, "ClusteredLightingPerFrame::ambient doesn't match HLSL packing");
+static_assert(offsetof(ClusteredLightingPerFrame, clusterDepthBias) == 28, "ClusteredLightingPerFrame::clusterDepthBias doesn't match HLSL packing");
+static_assert(offsetof(ClusteredLightingPerFrame, clusterTileScale) == 32, "ClusteredLightingPerFrame::clusterTileScale doesn't match HLSL packing");
+static_assert(offsetof(ClusteredLightingPerFrame, globalLightCount) == 40, "ClusteredLightingPerFrame::globalLightCount doesn't match HLSL packing");
+static_assert(offsetof(ClusteredLightingPerFrame, clusterCounts) == 48, "ClusteredLightingPerFrame::clusterCounts doesn't match HLSL packing");
+static_assert(sizeof(ClusteredLightingPerFrame) == 64, "ClusteredLightingPerFrame doesn't match HLSL packing");
+
+// cbuffer PerMaterial : register(b1) in PixelShader.hlsl
+struct PixelShaderPerMaterial
+{
+	static constexpr char BufferName[] = "PerMaterial";
+
+	DirectX::XMFLOAT3 colorTint;
+	float roughness;
+	DirectX::XMFLOAT2 uvScale;
+	DirectX::XMFLOAT2 uvOffset;
+};
+static_assert(offsetof(PixelShaderPerMaterial, colorTint) == 0, "PixelShaderPerMaterial::colorTint doesn't match HLSL packing");
+static_assert(offsetof(PixelShaderPerMaterial, roughness) == 12, "PixelShaderPerMaterial::roughness doesn't match HLSL packing");
+static_assert(offsetof(PixelShaderPerMaterial, uvScale) == 16, "PixelShaderPerMaterial::uvScale doesn't match HLSL packing");
+static_assert(offsetof(PixelShaderPerMaterial, uvOffset) == 24, "PixelShaderPerMaterial::uvOffset doesn't match HLSL packing");
+static_assert(sizeof(PixelShaderPerMaterial) == 32, "PixelShaderPerMaterial doesn't match HLSL packing");
+
+// cbuffer PerMaterial in CelShadingPixel.hlsl is laid out the same
+typedef PixelShaderPerMaterial CelShadingPixelPerMaterial;
@@ -0,0 +1,307 @@
+#include "ShaderReflection.h"
+#include "Helpers.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+static_assert(sizeof(ShaderReflectionHeader) == 48, "ShaderReflectionHeader must stay tightly packed");
+
+uint64_t ShaderReflection::HashName(const char* name)
+{
+	return HashBytes(name, strlen(name));
+}
+
+void ShaderReflection::Clear()
+{
+	buffers.clear();
+	variables.clear();
+	resources.clear();
+	inputElements.clear();
+	bufferLookup.clear();
+	variableLookup.clear();
+	resourceLookup.clear();
+	strings.clear();
+}
+
+uint32_t ShaderReflection::AddString(const char* text)
+{
+	uint32_t offset = (uint32_t)strings.size();
+	strings.insert(strings.end(), text, text + strlen(text) + 1);
+	return offset;
+}
+
+void ShaderReflection::AddBuffer(const char* name, uint32_t type, uint32_t bindIndex, uint32_t size)
+{
+	Buffer b = {};
+	b.Name = AddString(name);
+	b.Type = type;
+	b.BindIndex = bindIndex;
+	b.Size = size;
+	b.FirstVariable = (uint32_t)variables.size();
+	buffers.push_back(b);
+}
+
+void ShaderReflection::AddVariable(const char* name, uint32_t byteOffset, uint32_t size)
+{
+	if (buffers.empty())
+		return;
+
+	Variable v = {};
+	v.Name = AddString(name);
+	v.Buffer = (uint32_t)buffers.size() - 1;
+	v.ByteOffset = byteOffset;
+	v.Size = size;
+	variables.push_back(v);
+	buffers.back().VariableCount++;
+}
+
+void ShaderReflection::AddResource(const char* name, ResourceType type, uint32_t bindIndex)
+{
+	Resource r = {};
+	r.Name = AddString(name);
+	r.Type = type;
+	r.BindIndex = bindIndex;
+	r.Index = (uint32_t)std::count_if(resources.begin(), resources.end(), [type](const Resource& other) { return other.Type == type; });
+	resources.push_back(r);
+}
+
+void ShaderReflection::AddInputElement(const char* semanticName, uint32_t semanticIndex, uint32_t format, bool perInstance)
+{
+	InputElement e = {};
+	e.SemanticName = AddString(semanticName);
+	e.SemanticIndex = semanticIndex;
+	e.Format = format;
+	e.PerInstance = perInstance ? 1 : 0;
+	inputElements.push_back(e);
+}
+
+// Sorts each kind of name by hash for Find()
+void ShaderReflection::Finish()
+{
+	auto build = [this](std::vector<Lookup>& lookup, size_t count, auto nameOf) {
+		lookup.resize(count);
+		for (size_t i = 0; i < count; i++)
+			lookup[i] = { HashName(GetString(nameOf(i))), (uint32_t)i, 0 };
+		std::sort(lookup.begin(), lookup.end(), [](const Lookup& a, const Lookup& b) { return a.Hash < b.Hash; });
+	};
+	build(bufferLookup, buffers.size(), [this](size_t i) { return buffers[i].Name; });
+	build(variableLookup, variables.size(), [this](size_t i) { return variables[i].Name; });
+	build(resourceLookup, resources.size(), [this](size_t i) { return resources[i].Name; });
+}
+
+// --------------------------------------------------------
+// Binary searches a lookup array, then walks the run of
+// equal hashes for the exact name (and resource type, if
+// one's given)
+// --------------------------------------------------------
+uint32_t ShaderReflection::Find(const std::vector<Lookup>& lookup, uint64_t hash, const char* name, uint32_t type) const
+{
+	auto it = std::lower_bound(lookup.begin(), lookup.end(), hash,
+		[](const Lookup& l, uint64_t h) { return l.Hash < h; });
+	for (; it != lookup.end() && it->Hash == hash; it++)
+	{
+		uint32_t nameOffset;
+		if (&lookup == &bufferLookup)
+			nameOffset = buffers[it->Index].Name;
+		else if (&lookup == &variableLookup)
+			nameOffset = variables[it->Index].Name;
+		else if (resources[it->Index].Type == type)
+			nameOffset = resources[it->Index].Name;
+		else
+			continue;
+
+		if (strcmp(GetString(nameOffset), name) == 0)
+			return it->Index;
+	}
+	return NotFound;
+}
+
+uint32_t ShaderReflection::FindBuffer(uint64_t hash, const char* name) const
+{
+	return Find(bufferLookup, hash, name, NotFound);
+}
+
+uint32_t ShaderReflection::FindVariable(uint64_t hash, const char* name) const
+{
+	return Find(variableLookup, hash, name, NotFound);
+}
+
+uint32_t ShaderReflection::FindResource(ResourceType type, uint64_t hash, const char* name) const
+{
+	return Find(resourceLookup, hash, name, type);
+}
+
+std::wstring ShaderReflection::GetCachePath(const std::wstring& shaderFile)
+{
+	return shaderFile + L".reflection";
+}
+
+// --------------------------------------------------------
+// Appends the header and arrays, in the order the header
+// describes
+// --------------------------------------------------------
+void ShaderReflection::Write(std::vector<char>& out, uint64_t bytecodeHash, uint64_t bytecodeSize) const
+{
+	ShaderReflectionHeader header = {};
+	header.Magic = Magic;
+	header.Version = Version;
+	header.BytecodeHash = bytecodeHash;
+	header.BytecodeSize = bytecodeSize;
+	header.BufferCount = (uint32_t)buffers.size();
+	header.VariableCount = (uint32_t)variables.size();
+	header.ResourceCount = (uint32_t)resources.size();
+	header.InputElementCount = (uint32_t)inputElements.size();
+	header.StringSize = (uint32_t)strings.size();
+
+	auto append = [&out](const void* data, size_t size) {
+		out.insert(out.end(), (const char*)data, (const char*)data + size);
+	};
+	append(&header, sizeof(header));
+	append(buffers.data(), sizeof(Buffer) * buffers.size());
+	append(variables.data(), sizeof(Variable) * variables.size());
+	append(resources.data(), sizeof(Resource) * resources.size());
+	append(inputElements.data(), sizeof(InputElement) * inputElements.size());
+	append(bufferLookup.data(), sizeof(Lookup) * bufferLookup.size());
+	append(variableLookup.data(), sizeof(Lookup) * variableLookup.size());
+	append(resourceLookup.data(), sizeof(Lookup) * resourceLookup.size());
+	append(strings.data(), strings.size());
+}
+
+bool ShaderReflection::Read(const char* data, size_t size, uint64_t bytecodeHash, uint64_t bytecodeSize)
+{
+	Clear();
+	if (size < sizeof(ShaderReflectionHeader))
+		return false;
+
+	ShaderReflectionHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (header.Magic != Magic ||
+		header.Version != Version ||
+		header.BytecodeHash != bytecodeHash ||
+		header.BytecodeSize != bytecodeSize)
+		return false;
+
+	size_t expectedSize =
+		sizeof(ShaderReflectionHeader) +
+		(sizeof(Buffer) + sizeof(Lookup)) * (size_t)header.BufferCount +
+		(sizeof(Variable) + sizeof(Lookup)) * (size_t)header.VariableCount +
+		(sizeof(Resource) + sizeof(Lookup)) * (size_t)header.ResourceCount +
+		sizeof(InputElement) * (size_t)header.InputElementCount +
+		header.StringSize;
+	if (size != expectedSize)
+		return false;
+
+	const char* next = data + sizeof(header);
+	auto take = [&next](auto& array, size_t count) {
+		array.resize(count);
+		memcpy(array.data(), next, sizeof(array[0]) * count);
+		next += sizeof(array[0]) * count;
+	};
+	take(buffers, header.BufferCount);
+	take(variables, header.VariableCount);
+	take(resources, header.ResourceCount);
+	take(inputElements, header.InputElementCount);
+	take(bufferLookup, header.BufferCount);
+	take(variableLookup, header.VariableCount);
+	take(resourceLookup, header.ResourceCount);
+	take(strings, header.StringSize);
+
+	if (!IsValid())
+	{
+		Clear();
+		return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Checks every offset and index stays in bounds, so a
+// corrupt file can't send a lookup out of its arrays
+// --------------------------------------------------------
+bool ShaderReflection::IsValid() const
+{
+	if (!strings.empty() && strings.back() != 0)
+		return false;
+
+	auto validName = [this](uint32_t offset) { return offset < strings.size(); };
+	for (const Buffer& b : buffers)
+	{
+		if (!validName(b.Name) || (uint64_t)b.FirstVariable + b.VariableCount > variables.size())
+			return false;
+	}
+	for (const Variable& v : variables)
+	{
+		if (!validName(v.Name) || v.Buffer >= buffers.size() || (uint64_t)v.ByteOffset + v.Size > buffers[v.Buffer].Size)
+			return false;
+	}
+	for (const Resource& r : resources)
+	{
+		if (!validName(r.Name) || r.Type > Sampler)
+			return false;
+	}
+	for (const InputElement& e : inputElements)
+	{
+		if (!validName(e.SemanticName))
+			return false;
+	}
+
+	auto validLookup = [](const std::vector<Lookup>& lookup, size_t count) {
+		for (size_t i = 0; i < lookup.size(); i++)
+		{
+			if (lookup[i].Index >= count || (i > 0 && lookup[i].Hash < lookup[i - 1].Hash))
+				return false;
+		}
+		return true;
+	};
+	return
+		validLookup(bufferLookup, buffers.size()) &&
+		validLookup(variableLookup, variables.size()) &&
+		validLookup(resourceLookup, resources.size());
+}
+
+// --------------------------------------------------------
+// Writes to a temporary file first so a half-written cache
+// is never picked up, like MeshCache
+// --------------------------------------------------------
+bool ShaderReflection::Save(const std::wstring& cacheFile, uint64_t bytecodeHash, uint64_t bytecodeSize) const
+{
+	std::vector<char> data;
+	Write(data, bytecodeHash, bytecodeSize);
+
+	std::wstring tempFile = cacheFile + L".tmp";
+	{
+#if defined(_WIN32)
+		std::ofstream out(tempFile, std::ios::binary | std::ios::trunc);
+#else
+		std::ofstream out(WideToNarrow(tempFile), std::ios::binary | std::ios::trunc);
+#endif
+		if (!out.is_open())
+			return false;
+
+		out.write(data.data(), data.size());
+		if (!out.good())
+			return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempFile, cacheFile, error);
+	if (error)
+	{
+		std::filesystem::remove(tempFile, error);
+		return false;
+	}
+	return true;
+}
+
+bool ShaderReflection::Load(const std::wstring& cacheFile, uint64_t bytecodeHash, uint64_t bytecodeSize)
+{
+	MappedFile file;
+	if (!file.Open(cacheFile))
+	{
+		Clear();
+		return false;
+	}
+	return Read(file.GetData(), file.GetSize(), bytecodeHash, bytecodeSize);
+}
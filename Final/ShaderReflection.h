@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Header at the start of a shader reflection cache file
+//
+// - Followed by the buffer, variable, resource and input
+//   element arrays, then the three lookup arrays, then the
+//   string table every name is an offset into
+// - BytecodeHash/Size identify the compiled shader, so a
+//   recompiled .cso invalidates the cache
+// --------------------------------------------------------
+struct ShaderReflectionHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t BytecodeHash;
+	uint64_t BytecodeSize;
+	uint32_t BufferCount;
+	uint32_t VariableCount;
+	uint32_t ResourceCount;
+	uint32_t InputElementCount;
+	uint32_t StringSize;
+	uint32_t Padding;
+};
+
+// --------------------------------------------------------
+// What SimpleShader needs to know about a compiled shader:
+// its constant buffers and their variables, its textures
+// and samplers, and its vertex inputs
+//
+// - Everything is in flat arrays, with names as offsets
+//   into one string table, so it saves and loads as a few
+//   block copies
+// - Lookups by name binary search arrays sorted by name
+//   hash (FNV-1a, the same as SimpleShaderName's), then
+//   compare the names themselves
+// - Nothing here touches D3D; SimpleShader fills it in
+//   from D3DReflect() when there's no up to date cache
+// --------------------------------------------------------
+class ShaderReflection
+{
+public:
+	enum ResourceType : uint32_t
+	{
+		Texture = 0,
+		Sampler = 1
+	};
+
+	struct Buffer
+	{
+		uint32_t Name;
+		uint32_t Type; // D3D_CBUFFER_TYPE
+		uint32_t BindIndex;
+		uint32_t Size;
+		uint32_t FirstVariable;
+		uint32_t VariableCount;
+	};
+
+	struct Variable
+	{
+		uint32_t Name;
+		uint32_t Buffer;
+		uint32_t ByteOffset;
+		uint32_t Size;
+	};
+
+	// Index counts resources of the same type, in reflection order
+	struct Resource
+	{
+		uint32_t Name;
+		uint32_t Type;
+		uint32_t BindIndex;
+		uint32_t Index;
+	};
+
+	struct InputElement
+	{
+		uint32_t SemanticName;
+		uint32_t SemanticIndex;
+		uint32_t Format; // DXGI_FORMAT
+		uint32_t PerInstance;
+	};
+
+	static const uint32_t NotFound = 0xFFFFFFFF;
+	static const uint32_t Magic = 0x4C464552; // "REFL"
+	static const uint32_t Version = 1;
+
+private:
+	struct Lookup
+	{
+		uint64_t Hash;
+		uint32_t Index;
+		uint32_t Padding;
+	};
+
+	std::vector<Buffer> buffers;
+	std::vector<Variable> variables;
+	std::vector<Resource> resources;
+	std::vector<InputElement> inputElements;
+	std::vector<Lookup> bufferLookup;
+	std::vector<Lookup> variableLookup;
+	std::vector<Lookup> resourceLookup;
+	std::vector<char> strings;
+
+	uint32_t AddString(const char* text);
+	uint32_t Find(const std::vector<Lookup>& lookup, uint64_t hash, const char* name, uint32_t type) const;
+	bool IsValid() const;
+
+public:
+	static uint64_t HashName(const char* name);
+
+	void Clear();
+
+	// Building, in reflection order: each buffer's variables
+	// follow it.  Call Finish() once everything's added.
+	void AddBuffer(const char* name, uint32_t type, uint32_t bindIndex, uint32_t size);
+	void AddVariable(const char* name, uint32_t byteOffset, uint32_t size);
+	void AddResource(const char* name, ResourceType type, uint32_t bindIndex);
+	void AddInputElement(const char* semanticName, uint32_t semanticIndex, uint32_t format, bool perInstance);
+	void Finish();
+
+	size_t GetBufferCount() const { return buffers.size(); }
+	size_t GetVariableCount() const { return variables.size(); }
+	size_t GetResourceCount() const { return resources.size(); }
+	size_t GetInputElementCount() const { return inputElements.size(); }
+	const Buffer& GetBuffer(size_t i) const { return buffers[i]; }
+	const Variable& GetVariable(size_t i) const { return variables[i]; }
+	const Resource& GetResource(size_t i) const { return resources[i]; }
+	const InputElement& GetInputElement(size_t i) const { return inputElements[i]; }
+	const char* GetString(uint32_t offset) const { return strings.data() + offset; }
+
+	// Array indices, or NotFound
+	uint32_t FindBuffer(uint64_t hash, const char* name) const;
+	uint32_t FindVariable(uint64_t hash, const char* name) const;
+	uint32_t FindResource(ResourceType type, uint64_t hash, const char* name) const;
+
+	// The cache sits next to the .cso it describes
+	static std::wstring GetCachePath(const std::wstring& shaderFile);
+
+	// Read() rejects anything stale, truncated or inconsistent,
+	// leaving this empty
+	void Write(std::vector<char>& out, uint64_t bytecodeHash, uint64_t bytecodeSize) const;
+	bool Read(const char* data, size_t size, uint64_t bytecodeHash, uint64_t bytecodeSize);
+
+	bool Save(const std::wstring& cacheFile, uint64_t bytecodeHash, uint64_t bytecodeSize) const;
+	bool Load(const std::wstring& cacheFile, uint64_t bytecodeHash, uint64_t bytecodeSize);
+};
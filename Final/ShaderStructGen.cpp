@@ -0,0 +1,649 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Generates ShaderConstants.h: a C++ struct for every
+// cbuffer in the given shaders (and every HLSL struct they
+// use), laid out with HLSL's packing rules, plus the
+// element structs of their StructuredBuffers
+//
+// Usage:
+//  ShaderStructGen [--check] output.h shader.hlsl [shader.hlsl ...]
+//
+// - Structs are named <shader file><cbuffer>, so they're
+//   unique; a cbuffer laid out exactly like one before it
+//   becomes a typedef of that one
+// - Every member's offset and every struct's size gets a
+//   static_assert, so the C++ compiler checks the layout
+// - Only what the shaders here use is supported: scalars,
+//   vectors, 4x4 matrices, structs and arrays of 16-byte
+//   multiples (anything else is reported, not guessed at)
+// - StructuredBuffer elements pack tightly instead, so their
+//   structs must lay out the same both ways (pad by hand)
+// - --check just reports whether output.h is up to date
+// --------------------------------------------------------
+
+struct Member
+{
+	std::string Type;
+	std::string Name;
+	unsigned int ArraySize = 0; // 0 when not an array
+};
+
+struct Declaration
+{
+	std::string Name;
+	std::string File;
+	std::vector<Member> Members;
+	int Register = -1; // cbuffers only
+};
+
+// A type's C++ spelling and HLSL packing
+struct TypeLayout
+{
+	std::string CppType;
+	unsigned int Size = 0;
+	bool StartsRegister = false; // Structs and matrices always start a new 16-byte register
+};
+
+// A member once it's been placed
+struct PlacedMember
+{
+	std::string CppType;
+	std::string Name;
+	unsigned int ArraySize;
+	unsigned int Offset;
+	unsigned int Size;
+};
+
+struct Layout
+{
+	std::vector<PlacedMember> Members;
+	unsigned int Size = 0;
+};
+
+// --------------------------------------------------------
+// Reads a shader, splicing in its #includes and dropping
+// comments, into tokens
+// - Remembers #defines with a single value, for array sizes
+// --------------------------------------------------------
+class ShaderSource
+{
+public:
+	std::vector<std::string> Tokens;
+	std::vector<std::string> TokenFiles; // The file each token came from
+	std::map<std::string, std::string> Defines;
+
+	bool Read(const std::filesystem::path& file)
+	{
+		std::filesystem::path full = std::filesystem::absolute(file).lexically_normal();
+		if (!included.insert(full.string()).second)
+			return true;
+
+		std::ifstream in(full);
+		if (!in.is_open())
+		{
+			fprintf(stderr, "Unable to open '%s'\n", full.string().c_str());
+			return false;
+		}
+
+		std::stringstream contents;
+		contents << in.rdbuf();
+		std::string text = StripComments(contents.str());
+
+		std::istringstream lines(text);
+		std::string line;
+		while (std::getline(lines, line))
+		{
+			size_t start = line.find_first_not_of(" \t");
+			if (start == std::string::npos)
+				continue;
+
+			if (line[start] != '#')
+			{
+				Tokenize(line, full.filename().string());
+				continue;
+			}
+
+			std::istringstream directive(line.substr(start + 1));
+			std::string keyword, name, value;
+			directive >> keyword >> name >> value;
+			if (keyword == "include")
+			{
+				std::string includeFile = name.substr(1, name.size() - 2); // Drop the quotes
+				if (!Read(full.parent_path() / includeFile))
+					return false;
+			}
+			else if (keyword == "define" && !value.empty())
+				Defines[name] = value;
+		}
+		return true;
+	}
+
+private:
+	std::set<std::string> included;
+
+	static std::string StripComments(const std::string& text)
+	{
+		std::string result;
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			if (text.compare(i, 2, "//") == 0)
+			{
+				while (i < text.size() && text[i] != '\n')
+					i++;
+				result += '\n';
+			}
+			else if (text.compare(i, 2, "/*") == 0)
+			{
+				size_t end = text.find("*/", i + 2);
+				for (; i < text.size() && i < end + 1; i++)
+				{
+					if (text[i] == '\n')
+						result += '\n';
+				}
+			}
+			else
+				result += text[i];
+		}
+		return result;
+	}
+
+	void Tokenize(const std::string& line, const std::string& file)
+	{
+		for (size_t i = 0; i < line.size();)
+		{
+			char c = line[i];
+			if (isspace((unsigned char)c))
+				i++;
+			else if (isalnum((unsigned char)c) || c == '_' || c == '.')
+			{
+				size_t start = i;
+				while (i < line.size() && (isalnum((unsigned char)line[i]) || line[i] == '_' || line[i] == '.'))
+					i++;
+				Tokens.push_back(line.substr(start, i - start));
+			}
+			else
+				Tokens.push_back(std::string(1, line[i++]));
+			TokenFiles.resize(Tokens.size(), file);
+		}
+	}
+};
+
+// --------------------------------------------------------
+// Pulls the struct and cbuffer declarations, and the
+// StructuredBuffer element types, out of a shader's tokens,
+// skipping everything else
+// --------------------------------------------------------
+class DeclarationParser
+{
+public:
+	DeclarationParser(const ShaderSource& source) :
+		source(source),
+		tokens(source.Tokens),
+		position(0)
+	{}
+
+	bool Parse(std::vector<Declaration>& structs, std::vector<Declaration>& cbuffers, std::vector<std::string>& structuredTypes)
+	{
+		int depth = 0;
+		while (position < tokens.size())
+		{
+			const std::string& token = tokens[position];
+			file = source.TokenFiles[position];
+			if (depth == 0 && token == "struct" && Peek(2) == "{")
+			{
+				Declaration d;
+				d.Name = tokens[position + 1];
+				d.File = file;
+				position += 3;
+				if (!ParseMembers(d, false))
+					return false;
+				structs.push_back(d);
+			}
+			else if (depth == 0 && token == "cbuffer" && position + 1 < tokens.size())
+			{
+				Declaration d;
+				d.Name = tokens[position + 1];
+				d.File = file;
+				position += 2;
+
+				// ": register(bN)" is optional
+				while (position < tokens.size() && tokens[position] != "{")
+				{
+					if (tokens[position] == "register" && Peek(2).size() > 1 && Peek(2)[0] == 'b')
+						d.Register = atoi(Peek(2).c_str() + 1);
+					position++;
+				}
+				position++;
+				if (!ParseMembers(d, true))
+					return false;
+				cbuffers.push_back(d);
+			}
+			else if (depth == 0 && (token == "StructuredBuffer" || token == "RWStructuredBuffer") && Peek(1) == "<")
+			{
+				structuredTypes.push_back(Peek(2));
+				position += 3;
+			}
+			else
+			{
+				if (token == "{") depth++;
+				if (token == "}") depth--;
+				position++;
+			}
+		}
+		return true;
+	}
+
+private:
+	const ShaderSource& source;
+	const std::vector<std::string>& tokens;
+	std::string file; // Of the current token
+	size_t position;
+
+	std::string Peek(size_t ahead) const
+	{
+		return position + ahead < tokens.size() ? tokens[position + ahead] : std::string();
+	}
+
+	// Member declarations up to and including the closing brace (and any semicolon)
+	bool ParseMembers(Declaration& d, bool isCBuffer)
+	{
+		static const std::set<std::string> modifiers = {
+			"column_major", "nointerpolation", "linear", "centroid", "noperspective", "sample", "precise", "uniform", "const" };
+
+		while (position < tokens.size() && tokens[position] != "}")
+		{
+			while (position < tokens.size() && modifiers.count(tokens[position]))
+				position++;
+
+			if (tokens[position] == "row_major" || tokens[position] == "static")
+			{
+				fprintf(stderr, "%s: '%s' in %s isn't supported\n", file.c_str(), tokens[position].c_str(), d.Name.c_str());
+				return false;
+			}
+
+			std::string type = tokens[position++];
+			do
+			{
+				Member m;
+				m.Type = type;
+				m.Name = Peek(0);
+				position++;
+
+				if (Peek(0) == "[")
+				{
+					std::string size = Peek(1);
+					auto define = source.Defines.find(size);
+					if (define != source.Defines.end())
+						size = define->second;
+					m.ArraySize = (unsigned int)atoi(size.c_str());
+					if (m.ArraySize == 0 || Peek(2) != "]")
+					{
+						fprintf(stderr, "%s: can't work out the size of %s.%s\n", file.c_str(), d.Name.c_str(), m.Name.c_str());
+						return false;
+					}
+					position += 3;
+				}
+
+				// Semantics (on plain structs) are skipped; packoffset would change the layout
+				if (Peek(0) == ":")
+				{
+					if (isCBuffer)
+					{
+						fprintf(stderr, "%s: packoffset on %s.%s isn't supported\n", file.c_str(), d.Name.c_str(), m.Name.c_str());
+						return false;
+					}
+					position += 2;
+				}
+
+				d.Members.push_back(m);
+			} while (Peek(0) == "," && ++position);
+
+			if (Peek(0) != ";")
+			{
+				fprintf(stderr, "%s: expected ';' after %s.%s\n", file.c_str(), d.Name.c_str(), d.Members.back().Name.c_str());
+				return false;
+			}
+			position++;
+		}
+
+		position++; // Closing brace
+		if (Peek(0) == ";")
+			position++;
+		return true;
+	}
+};
+
+// --------------------------------------------------------
+// Works out layouts, and writes the header
+// --------------------------------------------------------
+class Generator
+{
+public:
+	std::vector<Declaration> Structs;
+	std::vector<Declaration> CBuffers;
+	std::vector<std::string> StructuredTypes;
+
+	// Adds a declaration unless the same one (from the same file) is already there
+	// - Two different declarations of a struct name can't both be written out
+	bool AddUnique(std::vector<Declaration>& declarations, const Declaration& d)
+	{
+		for (const Declaration& existing : declarations)
+		{
+			if (existing.Name != d.Name || (&declarations == &CBuffers && existing.File != d.File))
+				continue;
+
+			bool same = existing.File == d.File && existing.Members.size() == d.Members.size();
+			for (size_t m = 0; same && m < d.Members.size(); m++)
+			{
+				same =
+					existing.Members[m].Type == d.Members[m].Type &&
+					existing.Members[m].Name == d.Members[m].Name &&
+					existing.Members[m].ArraySize == d.Members[m].ArraySize;
+			}
+			if (!same)
+			{
+				fprintf(stderr, "%s: struct %s differs from the one in %s\n", d.File.c_str(), d.Name.c_str(), existing.File.c_str());
+				return false;
+			}
+			return true;
+		}
+		declarations.push_back(d);
+		return true;
+	}
+
+	bool Generate(std::string& output)
+	{
+		// Structs go in header as they're first used, ahead of the cbuffers in out
+		header << "// Generated by ShaderStructGen from the shaders' cbuffers - don't edit by hand.\n";
+		header << "// Rebuild the shader-constants target (CMakeLists.txt) after changing a cbuffer.\n";
+		header << "#pragma once\n\n";
+		header << "#include <DirectXMath.h>\n";
+		header << "#include <cstddef>\n";
+		header << "#include <cstdint>\n";
+
+		// Built-in element types (StructuredBuffer<uint>) need nothing
+		for (const std::string& type : StructuredTypes)
+		{
+			TypeLayout layout;
+			if (FindStruct(type) && (!GetType(type, layout) || !CheckTightLayout(type)))
+				return false;
+		}
+
+		std::map<std::string, std::string> emittedBuffers; // Layout signature -> struct name
+		for (const Declaration& cbuffer : CBuffers)
+		{
+			Layout layout;
+			if (!LayOut(cbuffer, layout))
+				return false;
+
+			// Constant buffers are a whole number of registers
+			layout.Size = RoundUp(layout.Size);
+
+			std::string name = std::filesystem::path(cbuffer.File).stem().string() + cbuffer.Name;
+			std::string signature = Signature(cbuffer, layout);
+			auto same = emittedBuffers.find(signature);
+			if (same != emittedBuffers.end())
+			{
+				out << "\n// cbuffer " << cbuffer.Name << " in " << cbuffer.File << " is laid out the same\n";
+				out << "typedef " << same->second << " " << name << ";\n";
+				continue;
+			}
+			emittedBuffers[signature] = name;
+
+			out << "\n// cbuffer " << cbuffer.Name;
+			if (cbuffer.Register >= 0)
+				out << " : register(b" << cbuffer.Register << ")";
+			out << " in " << cbuffer.File << "\n";
+			Emit(name, layout, &cbuffer);
+		}
+
+		output = header.str() + out.str();
+		return true;
+	}
+
+private:
+	std::ostringstream header;
+	std::ostringstream out;
+	std::map<std::string, Layout> structLayouts;
+
+	static unsigned int RoundUp(unsigned int offset) { return (offset + 15) / 16 * 16; }
+
+	const Declaration* FindStruct(const std::string& name)
+	{
+		for (const Declaration& d : Structs)
+		{
+			if (d.Name == name)
+				return &d;
+		}
+		return 0;
+	}
+
+	// Built-in types, or HLSL structs (laid out, and written out, on first use)
+	bool GetType(const std::string& type, TypeLayout& result)
+	{
+		static const struct { const char* Base; const char* Scalar; const char* Vector; } bases[] = {
+			{ "float", "float", "DirectX::XMFLOAT" },
+			{ "int", "int32_t", "DirectX::XMINT" },
+			{ "bool", "int32_t", "DirectX::XMINT" }, // HLSL bools are 4 bytes
+			{ "uint", "uint32_t", "DirectX::XMUINT" },
+			{ "dword", "uint32_t", "DirectX::XMUINT" },
+		};
+
+		if (type == "matrix" || type == "float4x4")
+		{
+			result = { "DirectX::XMFLOAT4X4", 64, true };
+			return true;
+		}
+
+		for (auto& base : bases)
+		{
+			size_t length = strlen(base.Base);
+			if (type.compare(0, length, base.Base) != 0)
+				continue;
+
+			std::string dimensions = type.substr(length);
+			if (dimensions.empty())
+			{
+				result = { base.Scalar, 4, false };
+				return true;
+			}
+			if (dimensions.size() == 1 && dimensions[0] >= '2' && dimensions[0] <= '4')
+			{
+				result = { std::string(base.Vector) + dimensions, 4u * (dimensions[0] - '0'), false };
+				return true;
+			}
+		}
+
+		const Declaration* d = FindStruct(type);
+		if (!d)
+		{
+			fprintf(stderr, "Type '%s' isn't supported\n", type.c_str());
+			return false;
+		}
+
+		auto existing = structLayouts.find(type);
+		if (existing == structLayouts.end())
+		{
+			Layout layout;
+			if (!LayOut(*d, layout))
+				return false;
+			existing = structLayouts.insert({ type, layout }).first;
+
+			std::ostringstream saved;
+			saved.swap(out);
+			out << "\n// struct " << type << " in " << d->File << "\n";
+			Emit(type, layout, 0);
+			saved.swap(out);
+			header << saved.str();
+		}
+
+		result = { type, existing->second.Size, true };
+		return true;
+	}
+
+	// --------------------------------------------------------
+	// HLSL packing: members fill 16-byte registers in order,
+	// but one that would straddle a register boundary moves to
+	// the next register, and structs, matrices and arrays always
+	// start on a new one.  Array elements each take whole
+	// registers.
+	// --------------------------------------------------------
+	bool LayOut(const Declaration& d, Layout& layout)
+	{
+		unsigned int offset = 0;
+		for (const Member& m : d.Members)
+		{
+			TypeLayout type;
+			if (!GetType(m.Type, type))
+				return false;
+
+			unsigned int size = type.Size;
+			if (m.ArraySize > 0)
+			{
+				if (type.Size % 16 != 0)
+				{
+					fprintf(stderr, "%s: elements of %s.%s would be padded to 16 bytes; use a 16-byte type\n", d.File.c_str(), d.Name.c_str(), m.Name.c_str());
+					return false;
+				}
+				size = type.Size * m.ArraySize;
+			}
+
+			if (type.StartsRegister || m.ArraySize > 0 || offset / 16 != (offset + size - 1) / 16)
+				offset = RoundUp(offset);
+
+			layout.Members.push_back({ type.CppType, m.Name, m.ArraySize, offset, size });
+			offset += size;
+		}
+		layout.Size = offset;
+		return true;
+	}
+
+	// Whether a struct laid out by LayOut() has its members back to back,
+	// as a StructuredBuffer (which has no registers) would have them
+	bool CheckTightLayout(const std::string& type)
+	{
+		const Layout& layout = structLayouts[type];
+		unsigned int offset = 0;
+		for (const PlacedMember& m : layout.Members)
+		{
+			if (m.Offset != offset)
+			{
+				fprintf(stderr, "%s.%s is padded in a cbuffer but not in a StructuredBuffer; pad it explicitly\n", type.c_str(), m.Name.c_str());
+				return false;
+			}
+			offset += m.Size;
+		}
+		return true;
+	}
+
+	static std::string Signature(const Declaration& d, const Layout& layout)
+	{
+		std::ostringstream s;
+		s << d.Name << ":" << layout.Size;
+		for (const PlacedMember& m : layout.Members)
+			s << ";" << m.CppType << " " << m.Name << "[" << m.ArraySize << "]@" << m.Offset;
+		return s.str();
+	}
+
+	// The struct, with explicit padding, then its checks
+	void Emit(const std::string& name, const Layout& layout, const Declaration* cbuffer)
+	{
+		out << "struct " << name << "\n{\n";
+		if (cbuffer)
+			out << "\tstatic constexpr char BufferName[] = \"" << cbuffer->Name << "\";\n\n";
+
+		unsigned int offset = 0;
+		int padding = 0;
+		auto pad = [&](unsigned int to) {
+			if (to > offset)
+				out << "\tfloat Pad" << padding++ << "[" << (to - offset) / 4 << "];\n";
+			offset = to;
+		};
+		for (const PlacedMember& m : layout.Members)
+		{
+			pad(m.Offset);
+			out << "\t" << m.CppType << " " << m.Name;
+			if (m.ArraySize > 0)
+				out << "[" << m.ArraySize << "]";
+			out << ";\n";
+			offset += m.Size;
+		}
+		pad(layout.Size);
+		out << "};\n";
+
+		for (const PlacedMember& m : layout.Members)
+			out << "static_assert(offsetof(" << name << ", " << m.Name << ") == " << m.Offset << ", \"" << name << "::" << m.Name << " doesn't match HLSL packing\");\n";
+		out << "static_assert(sizeof(" << name << ") == " << layout.Size << ", \"" << name << " doesn't match HLSL packing\");\n";
+	}
+};
+
+int main(int argc, char* argv[])
+{
+	bool check = argc > 1 && strcmp(argv[1], "--check") == 0;
+	int first = check ? 2 : 1;
+	if (argc < first + 2)
+	{
+		printf("Usage: %s [--check] output.h shader.hlsl [shader.hlsl ...]\n", argv[0]);
+		return 1;
+	}
+
+	Generator generator;
+	for (int i = first + 1; i < argc; i++)
+	{
+		ShaderSource source;
+		if (!source.Read(argv[i]))
+			return 1;
+
+		// Structs from shared includes only need declaring once, and
+		// cbuffers declared in an include are only written out once
+		std::vector<Declaration> structs, cbuffers;
+		std::vector<std::string> structuredTypes;
+		if (!DeclarationParser(source).Parse(structs, cbuffers, structuredTypes))
+			return 1;
+		for (const Declaration& s : structs)
+		{
+			if (!generator.AddUnique(generator.Structs, s))
+				return 1;
+		}
+		for (const Declaration& c : cbuffers)
+		{
+			if (!generator.AddUnique(generator.CBuffers, c))
+				return 1;
+		}
+		for (const std::string& type : structuredTypes)
+		{
+			if (std::find(generator.StructuredTypes.begin(), generator.StructuredTypes.end(), type) == generator.StructuredTypes.end())
+				generator.StructuredTypes.push_back(type);
+		}
+	}
+
+	std::string output;
+	if (!generator.Generate(output))
+		return 1;
+
+	std::ifstream existing(argv[first], std::ios::binary);
+	std::stringstream existingContents;
+	existingContents << existing.rdbuf();
+	bool upToDate = existing.is_open() && existingContents.str() == output;
+
+	if (check)
+	{
+		if (!upToDate)
+			printf("%s is out of date - rebuild the shader-constants target\n", argv[first]);
+		return upToDate ? 0 : 1;
+	}
+
+	if (!upToDate)
+		std::ofstream(argv[first], std::ios::binary) << output;
+	return 0;
+}
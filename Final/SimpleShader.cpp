@@ -1,8 +1,12 @@
 #include "SimpleShader.h"
+#include "Helpers.h"
+
+#include <cstring>
 
 // Default error reporting state
 bool ISimpleShader::ReportErrors = false;
 bool ISimpleShader::ReportWarnings = false;
+unsigned int ISimpleShader::DynamicBufferMaxSize = 1024;
 
 // To enable error reporting, use either or both 
 // of the following lines somewhere in your program, 
@@ -29,6 +33,7 @@ ISimpleShader::ISimpleShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Micros
 	this->constantBufferCount = 0;
 	this->constantBuffers = 0;
 	this->shaderValid = false;
+	this->uploadStats = SimpleShaderUploadStats();
 }
 
 // --------------------------------------------------------
@@ -57,17 +62,122 @@ void ISimpleShader::CleanUp()
 		constantBufferCount = 0;
 	}
 
-	for (unsigned int i = 0; i < shaderResourceViews.size(); i++)
-		delete shaderResourceViews[i];
-	
-	for (unsigned int i = 0; i < samplerStates.size(); i++)
-		delete samplerStates[i];
+	// Clean up resource info (the reflection itself is kept, since
+	// CreateShader() cleans up after it's been loaded)
+	shaderResourceViews.clear();
+	samplerStates.clear();
+	variables.clear();
+}
+
+// --------------------------------------------------------
+// Fills in a reflection from the shader's bytecode, the
+// slow path when there's no up to date cache
+//
+// - Structured buffers count as textures, since they're
+//   set as SRVs
+// - Input elements get their DXGI format from their mask
+//   and component type, and are per instance when their
+//   semantic ends in "_PER_INSTANCE"
+// --------------------------------------------------------
+static bool ReflectShader(ID3DBlob* shaderBlob, ShaderReflection& reflection)
+{
+	reflection.Clear();
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
+	if (FAILED(D3DReflect(
+		shaderBlob->GetBufferPointer(),
+		shaderBlob->GetBufferSize(),
+		IID_ID3D11ShaderReflection,
+		(void**)refl.GetAddressOf())))
+		return false;
+
+	D3D11_SHADER_DESC shaderDesc;
+	refl->GetDesc(&shaderDesc);
 
-	// Clean up tables
-	varTable.clear();
-	cbTable.clear();
-	samplerTable.clear();
-	textureTable.clear();
+	// Bound resources (textures and samplers)
+	for (unsigned int r = 0; r < shaderDesc.BoundResources; r++)
+	{
+		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
+		refl->GetResourceBindingDesc(r, &resourceDesc);
+
+		switch (resourceDesc.Type)
+		{
+		case D3D_SIT_STRUCTURED:
+		case D3D_SIT_TEXTURE:
+			reflection.AddResource(resourceDesc.Name, ShaderReflection::Texture, resourceDesc.BindPoint);
+			break;
+
+		case D3D_SIT_SAMPLER:
+			reflection.AddResource(resourceDesc.Name, ShaderReflection::Sampler, resourceDesc.BindPoint);
+			break;
+		}
+	}
+
+	// Constant buffers, each followed by its variables
+	for (unsigned int b = 0; b < shaderDesc.ConstantBuffers; b++)
+	{
+		ID3D11ShaderReflectionConstantBuffer* cb = refl->GetConstantBufferByIndex(b);
+		D3D11_SHADER_BUFFER_DESC bufferDesc;
+		cb->GetDesc(&bufferDesc);
+
+		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
+		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
+		reflection.AddBuffer(bufferDesc.Name, bufferDesc.Type, bindDesc.BindPoint, bufferDesc.Size);
+
+		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		{
+			D3D11_SHADER_VARIABLE_DESC varDesc;
+			cb->GetVariableByIndex(v)->GetDesc(&varDesc);
+			reflection.AddVariable(varDesc.Name, varDesc.StartOffset, varDesc.Size);
+		}
+	}
+
+	// Vertex inputs, for building input layouts
+	for (unsigned int i = 0; i < shaderDesc.InputParameters; i++)
+	{
+		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
+		refl->GetInputParameterDesc(i, &paramDesc);
+
+		// Check the semantic name for "_PER_INSTANCE"
+		std::string perInstanceStr = "_PER_INSTANCE";
+		std::string sem = paramDesc.SemanticName;
+		int lenDiff = (int)sem.size() - (int)perInstanceStr.size();
+		bool isPerInstance =
+			lenDiff >= 0 &&
+			sem.compare(lenDiff, perInstanceStr.size(), perInstanceStr) == 0;
+
+		// Determine DXGI format
+		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+		if (paramDesc.Mask == 1)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32_FLOAT;
+		}
+		else if (paramDesc.Mask <= 3)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32G32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32G32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32G32_FLOAT;
+		}
+		else if (paramDesc.Mask <= 7)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32G32B32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32G32B32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32G32B32_FLOAT;
+		}
+		else if (paramDesc.Mask <= 15)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32G32B32A32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32G32B32A32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		}
+
+		reflection.AddInputElement(paramDesc.SemanticName, paramDesc.SemanticIndex, format, isPerInstance);
+	}
+
+	reflection.Finish();
+	return true;
 }
 
 // --------------------------------------------------------
@@ -76,6 +186,10 @@ void ISimpleShader::CleanUp()
 //
 // shaderFile - A "wide string" specifying the compiled shader to load
 // 
+// The reflection is cached next to the shader file, keyed
+// by a hash of its bytecode, so later runs skip D3DReflect()
+// entirely until the shader's recompiled
+//
 // Returns true if shader is loaded properly, false otherwise
 // --------------------------------------------------------
 bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
@@ -94,6 +208,34 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
+	// Use the cached reflection if it matches this bytecode,
+	// otherwise reflect and (re)write the cache
+	uint64_t bytecodeSize = shaderBlob->GetBufferSize();
+	uint64_t bytecodeHash = HashBytes(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize());
+	std::wstring cacheFile = ShaderReflection::GetCachePath(shaderFile);
+	if (!reflection.Load(cacheFile, bytecodeHash, bytecodeSize))
+	{
+		if (!ReflectShader(shaderBlob.Get(), reflection))
+		{
+			if (ReportErrors)
+			{
+				LogError("SimpleShader::LoadShaderFile() - Error reflecting shader file '");
+				LogW(shaderFile);
+				LogError("'.\n");
+			}
+
+			return false;
+		}
+
+		// A failed save just means reflecting again next time
+		if (!reflection.Save(cacheFile, bytecodeHash, bytecodeSize) && ReportWarnings)
+		{
+			LogWarning("SimpleShader::LoadShaderFile() - Unable to write reflection cache '");
+			LogWarningW(cacheFile);
+			LogWarning("'.\n");
+		}
+	}
+
 	// Create the shader - Calls an overloaded version of this abstract
 	// method in the appropriate child class
 	shaderValid = CreateShader(shaderBlob);
@@ -109,91 +251,38 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
-	// Set up shader reflection to get information about
-	// this shader and its variables,  buffers, etc.
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
-	
-	// Get the description of the shader
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
+	// Bound resources, indexed by their type's count
+	for (size_t r = 0; r < reflection.GetResourceCount(); r++)
+	{
+		const ShaderReflection::Resource& resource = reflection.GetResource(r);
+		if (resource.Type == ShaderReflection::Texture)
+			shaderResourceViews.push_back({ resource.Index, resource.BindIndex });
+		else
+			samplerStates.push_back({ resource.Index, resource.BindIndex });
+	}
 
 	// Create resource arrays
-	constantBufferCount = shaderDesc.ConstantBuffers;
+	constantBufferCount = (unsigned int)reflection.GetBufferCount();
 	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
-	
-	// Handle bound resources (like shaders and samplers)
-	unsigned int resourceCount = shaderDesc.BoundResources;
-	for (unsigned int r = 0; r < resourceCount; r++)
-	{
-		// Get this resource's description
-		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
-		refl->GetResourceBindingDesc(r, &resourceDesc);
-
-		// Check the type
-		switch (resourceDesc.Type)
-		{
-		case D3D_SIT_STRUCTURED: // Treat structured buffers as texture resources
-		case D3D_SIT_TEXTURE: // A texture resource
-		{
-			// Create the SRV wrapper
-			SimpleSRV* srv = new SimpleSRV();
-			srv->BindIndex = resourceDesc.BindPoint;				// Shader bind point
-			srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
-
-			textureTable.insert(std::pair<std::string, SimpleSRV*>(resourceDesc.Name, srv));
-			shaderResourceViews.push_back(srv);
-		}
-			break;
-
-		case D3D_SIT_SAMPLER: // A sampler resource
-		{
-			// Create the sampler wrapper
-			SimpleSampler* samp = new SimpleSampler();
-			samp->BindIndex = resourceDesc.BindPoint;			// Shader bind point
-			samp->Index = (unsigned int)samplerStates.size();	// Raw index
-
-			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resourceDesc.Name, samp));
-			samplerStates.push_back(samp);
-		}
-			break;
-		}
-	}
+	variables.resize(reflection.GetVariableCount());
 
 	// Loop through all constant buffers
 	for (unsigned int b = 0; b < constantBufferCount; b++)
 	{
-		// Get this buffer
-		ID3D11ShaderReflectionConstantBuffer* cb =
-			refl->GetConstantBufferByIndex(b);
-		
-		// Get the description of this buffer
-		D3D11_SHADER_BUFFER_DESC bufferDesc;
-		cb->GetDesc(&bufferDesc);
+		const ShaderReflection::Buffer& bufferDesc = reflection.GetBuffer(b);
 
 		// Save the type, which we reference when setting these buffers
-		constantBuffers[b].Type = bufferDesc.Type;
-		
-		// Get the description of the resource binding, so
-		// we know exactly how it's bound in the shader
-		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
-		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
-		
-		// Set up the buffer and put its pointer in the table
-		constantBuffers[b].BindIndex = bindDesc.BindPoint;
-		constantBuffers[b].Name = bufferDesc.Name;
-		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
+		constantBuffers[b].Type = (D3D_CBUFFER_TYPE)bufferDesc.Type;
+		constantBuffers[b].BindIndex = bufferDesc.BindIndex;
+		constantBuffers[b].Name = reflection.GetString(bufferDesc.Name);
 
 		// Create this constant buffer
+		constantBuffers[b].Dynamic = bufferDesc.Size <= DynamicBufferMaxSize;
 		D3D11_BUFFER_DESC newBuffDesc = {};
-		newBuffDesc.Usage = D3D11_USAGE_DEFAULT;
+		newBuffDesc.Usage = constantBuffers[b].Dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
 		newBuffDesc.ByteWidth = ((bufferDesc.Size + 15) / 16) * 16; // Quick and dirty 16-byte alignment using integer division
 		newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		newBuffDesc.CPUAccessFlags = 0;
+		newBuffDesc.CPUAccessFlags = constantBuffers[b].Dynamic ? D3D11_CPU_ACCESS_WRITE : 0;
 		newBuffDesc.MiscFlags = 0;
 		newBuffDesc.StructureByteStride = 0;
 		device->CreateBuffer(&newBuffDesc, 0, constantBuffers[b].ConstantBuffer.GetAddressOf());
@@ -203,28 +292,18 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
 		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
 
+		// The GPU copy starts out undefined, so the first copy always uploads
+		constantBuffers[b].Dirty.Add(0, bufferDesc.Size);
+
 		// Loop through all variables in this buffer
-		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		for (unsigned int v = bufferDesc.FirstVariable; v < bufferDesc.FirstVariable + bufferDesc.VariableCount; v++)
 		{
-			// Get this variable
-			ID3D11ShaderReflectionVariable* var =
-				cb->GetVariableByIndex(v);
-			
-			// Get the description of the variable and its type
-			D3D11_SHADER_VARIABLE_DESC varDesc;
-			var->GetDesc(&varDesc);
+			const ShaderReflection::Variable& varDesc = reflection.GetVariable(v);
 
-			// Create the variable struct
-			SimpleShaderVariable varStruct = {};
+			SimpleShaderVariable& varStruct = variables[v];
 			varStruct.ConstantBufferIndex = b;
-			varStruct.ByteOffset = varDesc.StartOffset;
+			varStruct.ByteOffset = varDesc.ByteOffset;
 			varStruct.Size = varDesc.Size;
-			
-			// Get a string version
-			std::string varName(varDesc.Name);
-
-			// Add this variable to the table and the constant buffer
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
 			constantBuffers[b].Variables.push_back(varStruct);
 		}
 	}
@@ -240,18 +319,14 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 // name - the name of the variable to look for
 // size - the size of the variable (for verification), or -1 to bypass
 // --------------------------------------------------------
-SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
+SimpleShaderVariable* ISimpleShader::FindVariable(const SimpleShaderName& name, int size)
 {
-	// Look for the key
-	std::unordered_map<std::string, SimpleShaderVariable>::iterator result =
-		varTable.find(name);
-
-	// Did we find the key?
-	if (result == varTable.end())
+	// Look for the name
+	uint32_t index = reflection.FindVariable(name.Hash, name.Text);
+	if (index == ShaderReflection::NotFound)
 		return 0;
 
-	// Grab the result from the iterator
-	SimpleShaderVariable* var = &(result->second);
+	SimpleShaderVariable* var = &variables[index];
 
 	// Is the data size correct ?
 	if (size > 0 && var->Size != size)
@@ -266,16 +341,12 @@ SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 // --------------------------------------------------------
 SimpleConstantBuffer* ISimpleShader::FindConstantBuffer(std::string name)
 {
-	// Look for the key
-	std::unordered_map<std::string, SimpleConstantBuffer*>::iterator result =
-		cbTable.find(name);
-
-	// Did we find the key?
-	if (result == cbTable.end())
+	// Buffers are in reflection order
+	uint32_t index = reflection.FindBuffer(SimpleShaderName::HashText(name.c_str()), name.c_str());
+	if (index == ShaderReflection::NotFound)
 		return 0;
 
-	// Success
-	return result->second;
+	return &constantBuffers[index];
 }
 
 // --------------------------------------------------------
@@ -345,14 +416,9 @@ void ISimpleShader::CopyAllBufferData()
 	// Ensure the shader is valid
 	if (!shaderValid) return;
 
-	// Loop through the constant buffers and copy all data
+	// Loop through the constant buffers and copy any that changed
 	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer.Get(), 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
-	}
+		UploadBuffer(&constantBuffers[i]);
 }
 
 // --------------------------------------------------------
@@ -380,9 +446,7 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	UploadBuffer(cb);
 }
 
 // --------------------------------------------------------
@@ -402,9 +466,56 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	UploadBuffer(cb);
+}
+
+// --------------------------------------------------------
+// Copies local data to the constant buffer holding the
+// given variable, without looking the buffer up by name
+// --------------------------------------------------------
+void ISimpleShader::CopyBufferData(SimpleShaderHandle variable)
+{
+	if (!variable.IsValid())
+		return;
+
+	CopyBufferData(variable.ConstantBufferIndex);
+}
+
+// --------------------------------------------------------
+// Sends a buffer's local data to the GPU, if any of it
+// changed since the last upload
+//
+// - Constant buffers can only be replaced whole, so the
+//   entire buffer goes up; the dirty range just decides
+//   whether to, and is counted in the stats
+// --------------------------------------------------------
+void ISimpleShader::UploadBuffer(SimpleConstantBuffer* cb)
+{
+	if (!cb->Dirty.IsDirty())
+	{
+		uploadStats.UploadsSkipped++;
+		return;
+	}
+
+	if (cb->Dynamic)
+	{
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		if (FAILED(deviceContext->Map(cb->ConstantBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+			return;
+		memcpy(mapped.pData, cb->LocalDataBuffer, cb->Size);
+		deviceContext->Unmap(cb->ConstantBuffer.Get(), 0);
+	}
+	else
+	{
+		deviceContext->UpdateSubresource(
+			cb->ConstantBuffer.Get(), 0, 0,
+			cb->LocalDataBuffer, 0, 0);
+	}
+
+	uploadStats.Uploads++;
+	uploadStats.BytesUploaded += cb->Size;
+	uploadStats.BytesChanged += cb->Dirty.GetSize();
+	cb->Dirty.Clear();
 }
 
 
@@ -417,7 +528,7 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 //
 // Returns true if data is copied, false if variable doesn't exist
 // --------------------------------------------------------
-bool ISimpleShader::SetData(std::string name, const void* data, unsigned int size)
+bool ISimpleShader::SetData(SimpleShaderName name, const void* data, unsigned int size)
 {
 	// Look for the variable and verify
 	SimpleShaderVariable* var = FindVariable(name, -1);
@@ -426,7 +537,7 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleShader::SetData() - Shader variable '");
-			Log(name);
+			Log(name.Text);
 			LogWarning("' not found. Ensure the name is spelled correctly and that it exists in a constant buffer in the shader.\n");
 		}
 		return false;
@@ -439,17 +550,15 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 		if (ReportWarnings)
 		{
 			LogWarning("SimpleShader::SetData() - Shader variable '");
-			Log(name);
+			Log(name.Text);
 			LogWarning("' is smaller than the size of the data being set. Ensure the variable is large enough for the specified data.\n");
 		}
 		return false;
 	}
 
-	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
-		data,
-		size);
+	// Set the data in the local data buffer, noting if it changed
+	SimpleConstantBuffer& cb = constantBuffers[var->ConstantBufferIndex];
+	cb.Dirty.Write(cb.LocalDataBuffer, var->ByteOffset, data, size);
 
 	// Success
 	return true;
@@ -458,7 +567,7 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 // --------------------------------------------------------
 // Sets INTEGER data
 // --------------------------------------------------------
-bool ISimpleShader::SetInt(std::string name, int data)
+bool ISimpleShader::SetInt(SimpleShaderName name, int data)
 {
 	return this->SetData(name, (void*)(&data), sizeof(int));
 }
@@ -466,7 +575,7 @@ bool ISimpleShader::SetInt(std::string name, int data)
 // --------------------------------------------------------
 // Sets a FLOAT variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat(std::string name, float data)
+bool ISimpleShader::SetFloat(SimpleShaderName name, float data)
 {
 	return this->SetData(name, (void*)(&data), sizeof(float));
 }
@@ -474,7 +583,7 @@ bool ISimpleShader::SetFloat(std::string name, float data)
 // --------------------------------------------------------
 // Sets a FLOAT2 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat2(std::string name, const float data[2])
+bool ISimpleShader::SetFloat2(SimpleShaderName name, const float data[2])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 2);
 }
@@ -482,7 +591,7 @@ bool ISimpleShader::SetFloat2(std::string name, const float data[2])
 // --------------------------------------------------------
 // Sets a FLOAT2 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat2(std::string name, const DirectX::XMFLOAT2 data)
+bool ISimpleShader::SetFloat2(SimpleShaderName name, const DirectX::XMFLOAT2 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 2);
 }
@@ -490,7 +599,7 @@ bool ISimpleShader::SetFloat2(std::string name, const DirectX::XMFLOAT2 data)
 // --------------------------------------------------------
 // Sets a FLOAT3 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat3(std::string name, const float data[3])
+bool ISimpleShader::SetFloat3(SimpleShaderName name, const float data[3])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 3);
 }
@@ -498,7 +607,7 @@ bool ISimpleShader::SetFloat3(std::string name, const float data[3])
 // --------------------------------------------------------
 // Sets a FLOAT3 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat3(std::string name, const DirectX::XMFLOAT3 data)
+bool ISimpleShader::SetFloat3(SimpleShaderName name, const DirectX::XMFLOAT3 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 3);
 }
@@ -506,7 +615,7 @@ bool ISimpleShader::SetFloat3(std::string name, const DirectX::XMFLOAT3 data)
 // --------------------------------------------------------
 // Sets a FLOAT4 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat4(std::string name, const float data[4])
+bool ISimpleShader::SetFloat4(SimpleShaderName name, const float data[4])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 4);
 }
@@ -514,7 +623,7 @@ bool ISimpleShader::SetFloat4(std::string name, const float data[4])
 // --------------------------------------------------------
 // Sets a FLOAT4 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat4(std::string name, const DirectX::XMFLOAT4 data)
+bool ISimpleShader::SetFloat4(SimpleShaderName name, const DirectX::XMFLOAT4 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 4);
 }
@@ -522,7 +631,7 @@ bool ISimpleShader::SetFloat4(std::string name, const DirectX::XMFLOAT4 data)
 // --------------------------------------------------------
 // Sets a MATRIX (4x4) variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetMatrix4x4(std::string name, const float data[16])
+bool ISimpleShader::SetMatrix4x4(SimpleShaderName name, const float data[16])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 16);
 }
@@ -530,16 +639,98 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const float data[16])
 // --------------------------------------------------------
 // Sets a MATRIX (4x4) variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data)
+bool ISimpleShader::SetMatrix4x4(SimpleShaderName name, const DirectX::XMFLOAT4X4 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 16);
 }
 
+// --------------------------------------------------------
+// Looks a variable up once, so it can be set by handle
+// without searching for it again
+//
+// Returns an invalid handle if the variable doesn't exist
+// --------------------------------------------------------
+SimpleShaderHandle ISimpleShader::GetVariableHandle(SimpleShaderName name)
+{
+	SimpleShaderHandle handle;
+	SimpleShaderVariable* var = FindVariable(name, -1);
+	if (var == 0)
+		return handle;
+
+	handle.ConstantBufferIndex = var->ConstantBufferIndex;
+	handle.ByteOffset = var->ByteOffset;
+	handle.Size = var->Size;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Resolves a constant buffer once, as a handle spanning
+// all of it
+// --------------------------------------------------------
+SimpleShaderHandle ISimpleShader::GetBufferHandle(SimpleShaderName bufferName)
+{
+	SimpleShaderHandle handle;
+	uint32_t index = reflection.FindBuffer(bufferName.Hash, bufferName.Text);
+	if (index == ShaderReflection::NotFound)
+		return handle;
+
+	handle.ConstantBufferIndex = index;
+	handle.ByteOffset = 0;
+	handle.Size = constantBuffers[index].Size;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Sets a variable by handle with arbitrary data
+//
+// Returns false (quietly) for invalid handles, or data
+// larger than the variable
+// --------------------------------------------------------
+bool ISimpleShader::SetData(SimpleShaderHandle variable, const void* data, unsigned int size)
+{
+	if (size > variable.Size || variable.ConstantBufferIndex >= constantBufferCount)
+		return false;
+
+	SimpleConstantBuffer& cb = constantBuffers[variable.ConstantBufferIndex];
+	cb.Dirty.Write(cb.LocalDataBuffer, variable.ByteOffset, data, size);
+	return true;
+}
+
+bool ISimpleShader::SetInt(SimpleShaderHandle variable, int data)
+{
+	return this->SetData(variable, &data, sizeof(int));
+}
+
+bool ISimpleShader::SetFloat(SimpleShaderHandle variable, float data)
+{
+	return this->SetData(variable, &data, sizeof(float));
+}
+
+bool ISimpleShader::SetFloat2(SimpleShaderHandle variable, const DirectX::XMFLOAT2& data)
+{
+	return this->SetData(variable, &data, sizeof(float) * 2);
+}
+
+bool ISimpleShader::SetFloat3(SimpleShaderHandle variable, const DirectX::XMFLOAT3& data)
+{
+	return this->SetData(variable, &data, sizeof(float) * 3);
+}
+
+bool ISimpleShader::SetFloat4(SimpleShaderHandle variable, const DirectX::XMFLOAT4& data)
+{
+	return this->SetData(variable, &data, sizeof(float) * 4);
+}
+
+bool ISimpleShader::SetMatrix4x4(SimpleShaderHandle variable, const DirectX::XMFLOAT4X4& data)
+{
+	return this->SetData(variable, &data, sizeof(float) * 16);
+}
+
 // --------------------------------------------------------
 // Determines if the shader contains the specified
 // variable within one of its constant buffers
 // --------------------------------------------------------
-bool ISimpleShader::HasVariable(std::string name)
+bool ISimpleShader::HasVariable(SimpleShaderName name)
 {
 	return FindVariable(name, -1) != 0;
 }
@@ -563,7 +754,7 @@ bool ISimpleShader::HasSamplerState(std::string name)
 // --------------------------------------------------------
 // Gets info about a shader variable, if it exists
 // --------------------------------------------------------
-const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string name)
+const SimpleShaderVariable* ISimpleShader::GetVariableInfo(SimpleShaderName name)
 {
 	return FindVariable(name, -1);
 }
@@ -575,16 +766,13 @@ const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string name)
 // --------------------------------------------------------
 const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(std::string name)
 {
-	// Look for the key
-	std::unordered_map<std::string, SimpleSRV*>::iterator result =
-		textureTable.find(name);
-
-	// Did we find the key?
-	if (result == textureTable.end())
+	// Look for the name
+	uint32_t index = reflection.FindResource(ShaderReflection::Texture, SimpleShaderName::HashText(name.c_str()), name.c_str());
+	if (index == ShaderReflection::NotFound)
 		return 0;
 
 	// Success
-	return result->second;
+	return &shaderResourceViews[reflection.GetResource(index).Index];
 }
 
 
@@ -599,7 +787,7 @@ const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(unsigned int index)
 	if (index >= shaderResourceViews.size()) return 0;
 
 	// Grab the bind index
-	return shaderResourceViews[index];
+	return &shaderResourceViews[index];
 }
 
 
@@ -610,16 +798,13 @@ const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(unsigned int index)
 // --------------------------------------------------------
 const SimpleSampler* ISimpleShader::GetSamplerInfo(std::string name)
 {
-	// Look for the key
-	std::unordered_map<std::string, SimpleSampler*>::iterator result =
-		samplerTable.find(name);
-
-	// Did we find the key?
-	if (result == samplerTable.end())
+	// Look for the name
+	uint32_t index = reflection.FindResource(ShaderReflection::Sampler, SimpleShaderName::HashText(name.c_str()), name.c_str());
+	if (index == ShaderReflection::NotFound)
 		return 0;
 
 	// Success
-	return result->second;
+	return &samplerStates[reflection.GetResource(index).Index];
 }
 
 // --------------------------------------------------------
@@ -633,9 +818,62 @@ const SimpleSampler* ISimpleShader::GetSamplerInfo(unsigned int index)
 	if (index >= samplerStates.size()) return 0;
 
 	// Grab the bind index
-	return samplerStates[index];
+	return &samplerStates[index];
+}
+
+
+// --------------------------------------------------------
+// Stores a resource at slot in a dense range starting at
+// firstSlot, growing the range at either end as needed
+// (with nulls in any registers it skips over)
+// --------------------------------------------------------
+template<typename T>
+void ISimpleShader::PlaceInRange(std::vector<T*>& range, unsigned int& firstSlot, unsigned int slot, T* resource)
+{
+	if (range.empty())
+		firstSlot = slot;
+	else if (slot < firstSlot)
+	{
+		range.insert(range.begin(), firstSlot - slot, nullptr);
+		firstSlot = slot;
+	}
+
+	if (slot - firstSlot >= range.size())
+		range.resize(slot - firstSlot + 1, nullptr);
+	range[slot - firstSlot] = resource;
+}
+
+// --------------------------------------------------------
+// Puts an SRV in a bind table at the register the named
+// texture is bound to, widening the table's range to
+// cover it
+//
+// Returns false (leaving the table alone) if the shader
+// has no texture of that name
+// --------------------------------------------------------
+bool ISimpleShader::AddToBindTable(SimpleBindTable& table, std::string name, ID3D11ShaderResourceView* srv)
+{
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
+	if (srvInfo == 0)
+		return false;
+
+	PlaceInRange(table.SRVs, table.FirstSRVSlot, srvInfo->BindIndex, srv);
+	return true;
 }
 
+// --------------------------------------------------------
+// Puts a sampler in a bind table at the register the
+// named sampler is bound to
+// --------------------------------------------------------
+bool ISimpleShader::AddToBindTable(SimpleBindTable& table, std::string name, ID3D11SamplerState* sampler)
+{
+	const SimpleSampler* sampInfo = GetSamplerInfo(name);
+	if (sampInfo == 0)
+		return false;
+
+	PlaceInRange(table.Samplers, table.FirstSamplerSlot, sampInfo->BindIndex, sampler);
+	return true;
+}
 
 // --------------------------------------------------------
 // Gets the number of constant buffers in this shader
@@ -766,49 +1004,27 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 	if (inputLayout)
 		return true;
 
-	// Vertex shader was created successfully, so we now use the
-	// shader code to re-reflect and create an input layout that 
-	// matches what the vertex shader expects.  Code adapted from:
+	// Vertex shader was created successfully, so we now build an
+	// input layout that matches what the vertex shader expects,
+	// from the (possibly cached) reflection.  Code adapted from:
 	// https://takinginitiative.wordpress.com/2011/12/11/directx-1011-basic-shader-reflection-automatic-input-layout-creation/
-
-	// Reflect shader info
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
-	
-	// Get shader info
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
-	// Read input layout description from shader info
 	std::vector<D3D11_INPUT_ELEMENT_DESC> inputLayoutDesc;
-	for (unsigned int i = 0; i< shaderDesc.InputParameters; i++)
+	for (size_t i = 0; i < reflection.GetInputElementCount(); i++)
 	{
-		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
-		refl->GetInputParameterDesc(i, &paramDesc);
-
-		// Check the semantic name for "_PER_INSTANCE"
-		std::string perInstanceStr = "_PER_INSTANCE";
-		std::string sem = paramDesc.SemanticName;
-		int lenDiff = (int)sem.size() - (int)perInstanceStr.size();
-		bool isPerInstance = 
-			lenDiff >= 0 &&
-			sem.compare(lenDiff, perInstanceStr.size(), perInstanceStr) == 0;
+		const ShaderReflection::InputElement& input = reflection.GetInputElement(i);
 
 		// Fill out input element desc
 		D3D11_INPUT_ELEMENT_DESC elementDesc = {};
-		elementDesc.SemanticName = paramDesc.SemanticName;
-		elementDesc.SemanticIndex = paramDesc.SemanticIndex;
+		elementDesc.SemanticName = reflection.GetString(input.SemanticName);
+		elementDesc.SemanticIndex = input.SemanticIndex;
+		elementDesc.Format = (DXGI_FORMAT)input.Format;
 		elementDesc.InputSlot = 0;
 		elementDesc.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
 		elementDesc.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 		elementDesc.InstanceDataStepRate = 0;
 
 		// Replace anything affected by "per instance" data
-		if (isPerInstance)
+		if (input.PerInstance)
 		{
 			elementDesc.InputSlot = 1; // Assume per instance data comes from another input slot!
 			elementDesc.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
@@ -817,32 +1033,6 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 			perInstanceCompatible = true;
 		}
 
-		// Determine DXGI format
-		if (paramDesc.Mask == 1)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 3)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 7)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 15)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-		}
-
 		// Save element desc
 		inputLayoutDesc.push_back(elementDesc);
 	}
@@ -947,6 +1137,18 @@ bool SimpleVertexShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a bind table's resources in the vertex shader stage,
+// each kind with a single call
+// --------------------------------------------------------
+void SimpleVertexShader::SetBindTable(const SimpleBindTable& table)
+{
+	if (!table.SRVs.empty())
+		deviceContext->VSSetShaderResources(table.FirstSRVSlot, (unsigned int)table.SRVs.size(), table.SRVs.data());
+	if (!table.Samplers.empty())
+		deviceContext->VSSetSamplers(table.FirstSamplerSlot, (unsigned int)table.Samplers.size(), table.Samplers.data());
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // ------ SIMPLE PIXEL SHADER -------------------------------------------------
@@ -1089,6 +1291,18 @@ bool SimplePixelShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a bind table's resources in the pixel shader stage,
+// each kind with a single call
+// --------------------------------------------------------
+void SimplePixelShader::SetBindTable(const SimpleBindTable& table)
+{
+	if (!table.SRVs.empty())
+		deviceContext->PSSetShaderResources(table.FirstSRVSlot, (unsigned int)table.SRVs.size(), table.SRVs.data());
+	if (!table.Samplers.empty())
+		deviceContext->PSSetSamplers(table.FirstSamplerSlot, (unsigned int)table.Samplers.size(), table.Samplers.data());
+}
+
 
 
 
@@ -1233,6 +1447,18 @@ bool SimpleDomainShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a bind table's resources in the domain shader stage,
+// each kind with a single call
+// --------------------------------------------------------
+void SimpleDomainShader::SetBindTable(const SimpleBindTable& table)
+{
+	if (!table.SRVs.empty())
+		deviceContext->DSSetShaderResources(table.FirstSRVSlot, (unsigned int)table.SRVs.size(), table.SRVs.data());
+	if (!table.Samplers.empty())
+		deviceContext->DSSetSamplers(table.FirstSamplerSlot, (unsigned int)table.Samplers.size(), table.Samplers.data());
+}
+
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1376,6 +1602,18 @@ bool SimpleHullShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a bind table's resources in the hull shader stage,
+// each kind with a single call
+// --------------------------------------------------------
+void SimpleHullShader::SetBindTable(const SimpleBindTable& table)
+{
+	if (!table.SRVs.empty())
+		deviceContext->HSSetShaderResources(table.FirstSRVSlot, (unsigned int)table.SRVs.size(), table.SRVs.data());
+	if (!table.Samplers.empty())
+		deviceContext->HSSetSamplers(table.FirstSamplerSlot, (unsigned int)table.Samplers.size(), table.Samplers.data());
+}
+
 
 
 
@@ -1650,6 +1888,18 @@ bool SimpleGeometryShader::SetSamplerState(std::string name, Microsoft::WRL::Com
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a bind table's resources in the geometry shader stage,
+// each kind with a single call
+// --------------------------------------------------------
+void SimpleGeometryShader::SetBindTable(const SimpleBindTable& table)
+{
+	if (!table.SRVs.empty())
+		deviceContext->GSSetShaderResources(table.FirstSRVSlot, (unsigned int)table.SRVs.size(), table.SRVs.data());
+	if (!table.Samplers.empty())
+		deviceContext->GSSetSamplers(table.FirstSamplerSlot, (unsigned int)table.Samplers.size(), table.Samplers.data());
+}
+
 // --------------------------------------------------------
 // Calculates the number of components specified by a parameter description mask
 //
@@ -1921,6 +2171,18 @@ bool SimpleComputeShader::SetSamplerState(std::string name, Microsoft::WRL::ComP
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a bind table's resources in the compute shader stage,
+// each kind with a single call
+// --------------------------------------------------------
+void SimpleComputeShader::SetBindTable(const SimpleBindTable& table)
+{
+	if (!table.SRVs.empty())
+		deviceContext->CSSetShaderResources(table.FirstSRVSlot, (unsigned int)table.SRVs.size(), table.SRVs.data());
+	if (!table.Samplers.empty())
+		deviceContext->CSSetSamplers(table.FirstSamplerSlot, (unsigned int)table.Samplers.size(), table.Samplers.data());
+}
+
 // --------------------------------------------------------
 // Sets an unordered access view in the Compute shader stage
 //
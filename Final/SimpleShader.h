@@ -7,6 +7,8 @@
 #include <DirectXMath.h>
 #include <wrl/client.h>
 
+#include "DirtyRange.h"
+#include "ShaderReflection.h"
 #include <unordered_map>
 #include <vector>
 #include <string>
@@ -23,6 +25,52 @@ struct SimpleShaderVariable
 	unsigned int ConstantBufferIndex;
 };
 
+// --------------------------------------------------------
+// A resolved variable: which buffer it's in and where, so
+// setting it skips the name lookup entirely
+// - Only valid for the shader it came from
+// - Default (or not found) handles have no size, and
+//   setting them does nothing
+// --------------------------------------------------------
+struct SimpleShaderHandle
+{
+	unsigned int ConstantBufferIndex = 0;
+	unsigned int ByteOffset = 0;
+	unsigned int Size = 0;
+
+	bool IsValid() const { return Size != 0; }
+};
+
+// --------------------------------------------------------
+// A variable name along with its hash, so looking it up
+// doesn't need a std::string
+// - Built from a string literal, the hash is a constant
+//   expression the compiler works out ahead of time
+// - Only keeps a pointer to the text, so it shouldn't
+//   outlive the string it was made from
+// --------------------------------------------------------
+struct SimpleShaderName
+{
+	const char* Text;
+	unsigned long long Hash;
+
+	template<size_t N>
+	constexpr SimpleShaderName(const char(&text)[N]) : Text(text), Hash(HashText(text)) {}
+	SimpleShaderName(const std::string& text) : Text(text.c_str()), Hash(HashText(text.c_str())) {}
+
+	// 64-bit FNV-1a
+	static constexpr unsigned long long HashText(const char* text)
+	{
+		unsigned long long hash = 14695981039346656037ull;
+		for (; *text; text++)
+		{
+			hash ^= (unsigned char)*text;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+};
+
 // --------------------------------------------------------
 // Contains information about a specific
 // constant buffer in a shader, as well as
@@ -37,6 +85,25 @@ struct SimpleConstantBuffer
 	Microsoft::WRL::ComPtr<ID3D11Buffer> ConstantBuffer = 0;
 	unsigned char* LocalDataBuffer = 0;
 	std::vector<SimpleShaderVariable> Variables;
+
+	// What's changed in LocalDataBuffer since the last upload;
+	// unchanged buffers are skipped entirely
+	DirtyRange Dirty;
+
+	// Dynamic buffers upload with Map(WRITE_DISCARD) rather
+	// than UpdateSubresource()
+	bool Dynamic = false;
+};
+
+// --------------------------------------------------------
+// Counts of a shader's constant buffer uploads
+// --------------------------------------------------------
+struct SimpleShaderUploadStats
+{
+	size_t Uploads;
+	size_t UploadsSkipped;	// Copy requests for buffers with no changes
+	size_t BytesUploaded;	// Whole buffers, which is what the GPU copies
+	size_t BytesChanged;	// Just the dirty ranges
 };
 
 // --------------------------------------------------------
@@ -57,6 +124,23 @@ struct SimpleSampler
 	unsigned int BindIndex; // The register of the Sampler
 };
 
+// --------------------------------------------------------
+// A shader's textures and samplers laid out by register,
+// so binding them all takes one call of each kind
+// - Registers between bound ones hold null
+// - Holds raw pointers; whoever fills it in owns the
+//   resources, and must rebuild it if they change
+// --------------------------------------------------------
+struct SimpleBindTable
+{
+	unsigned int FirstSRVSlot = 0;
+	std::vector<ID3D11ShaderResourceView*> SRVs;
+	unsigned int FirstSamplerSlot = 0;
+	std::vector<ID3D11SamplerState*> Samplers;
+
+	void Clear() { SRVs.clear(); Samplers.clear(); }
+};
+
 // --------------------------------------------------------
 // Base abstract class for simplifying shader handling
 // --------------------------------------------------------
@@ -74,40 +158,72 @@ public:
 	void CopyAllBufferData();
 	void CopyBufferData(unsigned int index);
 	void CopyBufferData(std::string bufferName);
+	void CopyBufferData(SimpleShaderHandle variable); // The buffer the variable is in
+
+	// Upload counts since the last reset
+	const SimpleShaderUploadStats& GetUploadStats() { return uploadStats; }
+	void ResetUploadStats() { uploadStats = SimpleShaderUploadStats(); }
 
 	// Sets arbitrary shader data
-	bool SetData(std::string name, const void* data, unsigned int size);
-
-	bool SetInt(std::string name, int data);
-	bool SetFloat(std::string name, float data);
-	bool SetFloat2(std::string name, const float data[2]);
-	bool SetFloat2(std::string name, const DirectX::XMFLOAT2 data);
-	bool SetFloat3(std::string name, const float data[3]);
-	bool SetFloat3(std::string name, const DirectX::XMFLOAT3 data);
-	bool SetFloat4(std::string name, const float data[4]);
-	bool SetFloat4(std::string name, const DirectX::XMFLOAT4 data);
-	bool SetMatrix4x4(std::string name, const float data[16]);
-	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
+	bool SetData(SimpleShaderName name, const void* data, unsigned int size);
+
+	bool SetInt(SimpleShaderName name, int data);
+	bool SetFloat(SimpleShaderName name, float data);
+	bool SetFloat2(SimpleShaderName name, const float data[2]);
+	bool SetFloat2(SimpleShaderName name, const DirectX::XMFLOAT2 data);
+	bool SetFloat3(SimpleShaderName name, const float data[3]);
+	bool SetFloat3(SimpleShaderName name, const DirectX::XMFLOAT3 data);
+	bool SetFloat4(SimpleShaderName name, const float data[4]);
+	bool SetFloat4(SimpleShaderName name, const DirectX::XMFLOAT4 data);
+	bool SetMatrix4x4(SimpleShaderName name, const float data[16]);
+	bool SetMatrix4x4(SimpleShaderName name, const DirectX::XMFLOAT4X4 data);
+
+	// Resolves a variable once, for setting it by handle from then on
+	SimpleShaderHandle GetVariableHandle(SimpleShaderName name);
+
+	bool SetData(SimpleShaderHandle variable, const void* data, unsigned int size);
+	bool SetInt(SimpleShaderHandle variable, int data);
+	bool SetFloat(SimpleShaderHandle variable, float data);
+	bool SetFloat2(SimpleShaderHandle variable, const DirectX::XMFLOAT2& data);
+	bool SetFloat3(SimpleShaderHandle variable, const DirectX::XMFLOAT3& data);
+	bool SetFloat4(SimpleShaderHandle variable, const DirectX::XMFLOAT4& data);
+	bool SetMatrix4x4(SimpleShaderHandle variable, const DirectX::XMFLOAT4X4& data);
+
+	// A handle covering a whole constant buffer, for setting it in one go
+	// from one of the structs generated into ShaderConstants.h
+	SimpleShaderHandle GetBufferHandle(SimpleShaderName bufferName);
+
+	template<typename T>
+	bool SetBufferData(SimpleShaderHandle buffer, const T& data)
+	{
+		// A size mismatch means the struct's from a different shader
+		return sizeof(T) == buffer.Size && SetData(buffer, &data, sizeof(T));
+	}
 
 	// Setting shader resources
 	virtual bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv) = 0;
 	virtual bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState) = 0;
 
+	// Building bind tables once, then setting a whole table at a time
+	bool AddToBindTable(SimpleBindTable& table, std::string name, ID3D11ShaderResourceView* srv);
+	bool AddToBindTable(SimpleBindTable& table, std::string name, ID3D11SamplerState* sampler);
+	virtual void SetBindTable(const SimpleBindTable& table) = 0;
+
 	// Simple resource checking
-	bool HasVariable(std::string name);
+	bool HasVariable(SimpleShaderName name);
 	bool HasShaderResourceView(std::string name);
 	bool HasSamplerState(std::string name);
 
 	// Getting data about variables and resources
-	const SimpleShaderVariable* GetVariableInfo(std::string name);
+	const SimpleShaderVariable* GetVariableInfo(SimpleShaderName name);
 	
 	const SimpleSRV* GetShaderResourceViewInfo(std::string name);
 	const SimpleSRV* GetShaderResourceViewInfo(unsigned int index);
-	size_t GetShaderResourceViewCount() { return textureTable.size(); }
+	size_t GetShaderResourceViewCount() { return shaderResourceViews.size(); }
 	
 	const SimpleSampler* GetSamplerInfo(std::string name);
 	const SimpleSampler* GetSamplerInfo(unsigned int index);
-	size_t GetSamplerCount() { return samplerTable.size(); }
+	size_t GetSamplerCount() { return samplerStates.size(); }
 
 	// Get data about constant buffers
 	unsigned int GetBufferCount();
@@ -122,6 +238,11 @@ public:
 	static bool ReportErrors;
 	static bool ReportWarnings;
 
+	// Constant buffers up to this size are created dynamic, since they're
+	// cheap to rewrite whole with Map(WRITE_DISCARD); larger ones are
+	// updated with UpdateSubresource().  Applies to shaders loaded afterwards.
+	static unsigned int DynamicBufferMaxSize;
+
 protected:
 	
 	bool shaderValid;
@@ -131,15 +252,17 @@ protected:
 
 	// Resource counts
 	unsigned int constantBufferCount;
+	SimpleShaderUploadStats uploadStats;
 	
-	// Maps for variables and buffers
+	// Everything found by name, loaded from the reflection cache
+	// when it's up to date - Lookups go through it
+	ShaderReflection reflection;
+
+	// Runtime info, in reflection order
 	SimpleConstantBuffer*		constantBuffers; // For index-based lookup
-	std::vector<SimpleSRV*>		shaderResourceViews;
-	std::vector<SimpleSampler*>	samplerStates;
-	std::unordered_map<std::string, SimpleConstantBuffer*> cbTable;
-	std::unordered_map<std::string, SimpleShaderVariable> varTable;
-	std::unordered_map<std::string, SimpleSRV*> textureTable;
-	std::unordered_map<std::string, SimpleSampler*> samplerTable;
+	std::vector<SimpleSRV>		shaderResourceViews;
+	std::vector<SimpleSampler>	samplerStates;
+	std::vector<SimpleShaderVariable> variables;
 
 	// Initialization method
 	bool LoadShaderFile(LPCWSTR shaderFile);
@@ -151,9 +274,15 @@ protected:
 	virtual void CleanUp();
 
 	// Helpers for finding data by name
-	SimpleShaderVariable* FindVariable(std::string name, int size);
+	SimpleShaderVariable* FindVariable(const SimpleShaderName& name, int size);
 	SimpleConstantBuffer* FindConstantBuffer(std::string name);
 
+	template<typename T>
+	static void PlaceInRange(std::vector<T*>& range, unsigned int& firstSlot, unsigned int slot, T* resource);
+
+	// Uploads a buffer if it's dirty, and counts it
+	void UploadBuffer(SimpleConstantBuffer* cb);
+
 	// Error logging
 	void Log(std::string message, WORD color);
 	void LogW(std::wstring message, WORD color);
@@ -180,6 +309,7 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	void SetBindTable(const SimpleBindTable& table);
 
 protected:
 	bool perInstanceCompatible;
@@ -203,6 +333,7 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	void SetBindTable(const SimpleBindTable& table);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> shader;
@@ -223,6 +354,7 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	void SetBindTable(const SimpleBindTable& table);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11DomainShader> shader;
@@ -243,6 +375,7 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	void SetBindTable(const SimpleBindTable& table);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11HullShader> shader;
@@ -263,6 +396,7 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	void SetBindTable(const SimpleBindTable& table);
 
 	bool CreateCompatibleStreamOutBuffer(Microsoft::WRL::ComPtr<ID3D11Buffer> buffer, int vertexCount);
 
@@ -304,6 +438,7 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	void SetBindTable(const SimpleBindTable& table);
 	bool SetUnorderedAccessView(std::string name, Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> uav, unsigned int appendConsumeOffset = -1);
 
 	int GetUnorderedAccessViewIndex(std::string name);
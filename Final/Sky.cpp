@@ -186,15 +186,15 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(
 	return cubeSRV;
 }
 
-void Sky::Draw(std::shared_ptr<Camera> camera) {
+void Sky::Draw(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection) {
 	context->RSSetState(skyboxRasterizer.Get());
 	context->OMSetDepthStencilState(skyboxDepth.Get(), 0);
 
 	skyboxVS->SetShader();
 	skyboxPS->SetShader();
 
-	skyboxVS->SetMatrix4x4("view", camera->GetView());
-	skyboxVS->SetMatrix4x4("projection", camera->GetProjection());
+	skyboxVS->SetMatrix4x4("view", view);
+	skyboxVS->SetMatrix4x4("projection", projection);
 	skyboxVS->CopyAllBufferData();
 
 	skyboxPS->SetShaderResourceView("SkyTexture", skyboxSRV);
@@ -67,7 +67,8 @@ public:
 		Microsoft::WRL::ComPtr<ID3D11Device> device
 	);
 	~Sky();
-	void Draw(std::shared_ptr<Camera> camera);
+	// Takes the camera's matrices rather than the camera, so it can draw from a render snapshot
+	void Draw(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection);
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetTexture();
 
 };
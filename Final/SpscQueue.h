@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// --------------------------------------------------------
+// Fixed-size lock-free queue for one producer thread and
+// one consumer thread
+//
+// - Only the producer calls TryPush() and only the consumer
+//   calls TryPop(); neither ever waits on the other, they
+//   just fail when the queue is full or empty
+// - The producer owns tail and the consumer owns head, so
+//   each index has one writer; the release store of one
+//   publishes the item to the acquire load of the other
+// --------------------------------------------------------
+template<typename T, size_t Capacity>
+class SpscQueue
+{
+private:
+	// One slot more than Capacity, so full and empty differ
+	static constexpr size_t Slots = Capacity + 1;
+
+	T items[Slots];
+
+	// Apart, so the two threads don't share a cache line
+	alignas(64) std::atomic<size_t> head; // Next to pop
+	alignas(64) std::atomic<size_t> tail; // Next to push
+
+public:
+	SpscQueue() : items(), head(0), tail(0) {}
+	SpscQueue(SpscQueue const&) = delete;
+	void operator=(SpscQueue const&) = delete;
+
+	bool TryPush(const T& item)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		size_t next = (t + 1) % Slots;
+		if (next == head.load(std::memory_order_acquire))
+			return false;
+
+		items[t] = item;
+		tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	bool TryPop(T& item)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return false;
+
+		item = items[h];
+		head.store((h + 1) % Slots, std::memory_order_release);
+		return true;
+	}
+};
@@ -0,0 +1,38 @@
+#include "StructuredBuffer.h"
+#include <cstring>
+
+StructuredBuffer::StructuredBuffer(size_t elementSize) :
+	buffer(D3D11_BIND_SHADER_RESOURCE, elementSize, D3D11_RESOURCE_MISC_BUFFER_STRUCTURED)
+{
+}
+
+bool StructuredBuffer::Upload(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const void* data, size_t count)
+{
+	size_t previousCapacity = buffer.GetCapacity();
+	if (!buffer.Reserve(device, count))
+	{
+		srv.Reset();
+		return false;
+	}
+
+	// Growing made a new buffer, which needs a new view
+	if (buffer.GetCapacity() != previousCapacity || !srv)
+	{
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements = (UINT)buffer.GetCapacity();
+		srv.Reset();
+		if (FAILED(device->CreateShaderResourceView(buffer.Get(), &srvDesc, srv.GetAddressOf())))
+			return false;
+	}
+
+	void* mapped = buffer.Map(context);
+	if (!mapped)
+		return false;
+	if (count > 0)
+		memcpy(mapped, data, buffer.GetStride() * count);
+	buffer.Unmap(context);
+	return true;
+}
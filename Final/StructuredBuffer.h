@@ -0,0 +1,26 @@
+#pragma once
+
+#include "DynamicBuffer.h"
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <cstddef>
+
+// --------------------------------------------------------
+// A dynamic structured buffer and its shader resource view,
+// rewritten whole by every Upload()
+// - Sized like any DynamicBuffer; the view is remade
+//   whenever the buffer grows
+// --------------------------------------------------------
+class StructuredBuffer
+{
+private:
+	DynamicBuffer buffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+
+public:
+	StructuredBuffer(size_t elementSize);
+
+	// Copies count elements in; false if the buffer couldn't be made or mapped
+	bool Upload(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const void* data, size_t count);
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetSRV() { return srv; }
+};
@@ -0,0 +1,120 @@
+#include "TextureDecoder.h"
+#include <wincodec.h>
+
+#pragma comment(lib, "windowscodecs.lib")
+
+// Converts the decoder's first frame to RGBA8
+static bool DecodeFirstFrame(IWICImagingFactory* factory, IWICBitmapDecoder* decoder, DecodedImage& image)
+{
+	Microsoft::WRL::ComPtr<IWICBitmapFrameDecode> frame;
+	Microsoft::WRL::ComPtr<IWICFormatConverter> converter;
+
+	UINT width = 0;
+	UINT height = 0;
+	if (FAILED(decoder->GetFrame(0, frame.GetAddressOf())) ||
+		FAILED(factory->CreateFormatConverter(converter.GetAddressOf())) ||
+		FAILED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom)) ||
+		FAILED(converter->GetSize(&width, &height)))
+		return false;
+
+	image.Width = width;
+	image.Height = height;
+	image.Pixels.resize((size_t)width * height * 4);
+	return SUCCEEDED(converter->CopyPixels(nullptr, width * 4, (UINT)image.Pixels.size(), image.Pixels.data()));
+}
+
+// --------------------------------------------------------
+// Decodes the first frame of an image file into RGBA8
+//
+// - Initializes COM for the calling thread (worker threads
+//   won't have it yet) and uses its own WIC factory, so
+//   nothing here is shared between threads
+// --------------------------------------------------------
+bool DecodeImageFile(const std::wstring& file, DecodedImage& image)
+{
+	HRESULT com = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	bool succeeded = false;
+	{
+		Microsoft::WRL::ComPtr<IWICImagingFactory> factory;
+		Microsoft::WRL::ComPtr<IWICBitmapDecoder> decoder;
+		succeeded =
+			SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(factory.GetAddressOf()))) &&
+			SUCCEEDED(factory->CreateDecoderFromFilename(file.c_str(), nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf())) &&
+			DecodeFirstFrame(factory.Get(), decoder.Get(), image);
+	}
+
+	// Only balance the init if it actually happened on this thread
+	if (SUCCEEDED(com))
+		CoUninitialize();
+
+	return succeeded;
+}
+
+// Same as DecodeImageFile(), from an image file already in memory
+bool DecodeImageMemory(const void* data, size_t size, DecodedImage& image)
+{
+	HRESULT com = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	bool succeeded = false;
+	{
+		Microsoft::WRL::ComPtr<IWICImagingFactory> factory;
+		Microsoft::WRL::ComPtr<IWICStream> stream;
+		Microsoft::WRL::ComPtr<IWICBitmapDecoder> decoder;
+		succeeded =
+			size <= UINT_MAX &&
+			SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(factory.GetAddressOf()))) &&
+			SUCCEEDED(factory->CreateStream(stream.GetAddressOf())) &&
+			SUCCEEDED(stream->InitializeFromMemory((BYTE*)data, (DWORD)size)) &&
+			SUCCEEDED(factory->CreateDecoderFromStream(stream.Get(), nullptr, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf())) &&
+			DecodeFirstFrame(factory.Get(), decoder.Get(), image);
+	}
+
+	if (SUCCEEDED(com))
+		CoUninitialize();
+
+	return succeeded;
+}
+
+// --------------------------------------------------------
+// Uploads the image as mip 0 and has the GPU generate the
+// rest, matching what CreateWICTextureFromFile() does when
+// it's given a context
+// --------------------------------------------------------
+HRESULT CreateTextureFromImage(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	const DecodedImage& image,
+	ID3D11ShaderResourceView** srv)
+{
+	if (image.Pixels.empty())
+		return E_INVALIDARG;
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = image.Width;
+	desc.Height = image.Height;
+	desc.MipLevels = 0;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	HRESULT hr = device->CreateTexture2D(&desc, nullptr, texture.GetAddressOf());
+	if (FAILED(hr))
+		return hr;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = desc.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MipLevels = (UINT)-1;
+	hr = device->CreateShaderResourceView(texture.Get(), &srvDesc, srv);
+	if (FAILED(hr))
+		return hr;
+
+	context->UpdateSubresource(texture.Get(), 0, nullptr, image.Pixels.data(), image.Width * 4, 0);
+	context->GenerateMips(*srv);
+	return S_OK;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "AssetCache.h"
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// An image decoded to 32-bit RGBA, ready to be uploaded
+// --------------------------------------------------------
+struct DecodedImage
+{
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	std::vector<unsigned char> Pixels;
+};
+
+// Decodes an image file with WIC.  Safe to call from any thread.
+bool DecodeImageFile(const std::wstring& file, DecodedImage& image);
+bool DecodeImageMemory(const void* data, size_t size, DecodedImage& image);
+
+// Creates a mipmapped texture and SRV from a decoded image.
+// Uses the immediate context, so only call on the thread that owns it.
+HRESULT CreateTextureFromImage(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	const DecodedImage& image,
+	ID3D11ShaderResourceView** srv);
+
+// Texture SRVs by file, decoded with DecodeImageMemory()
+typedef AssetCache<DecodedImage, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> TextureCache;
@@ -100,18 +100,39 @@ void Transform::Scale(float x, float y, float z) {
 	dirtyMat = true;
 }
 
-// Updating the matrices as a helper function called at EOF as suggested for optimization
+// --------------------------------------------------------
+// Rebuilds world = scale * rotation * translation and its
+// inverse transpose, then clears the dirty flag
+//
+// - Both come straight from the parts instead of matrix
+//   products and a general inverse: world's rows are the
+//   rotation's rows times their scale, and the inverse
+//   transpose's rows are the rotation's rows divided by
+//   their scale, with -dot(position, row) / scale in w
+// --------------------------------------------------------
 void Transform::UpdateMatrices() {
-	if (dirtyMat) {
-		XMMATRIX translationMat = XMMatrixTranslation(position.x, position.y, position.z);
-		XMMATRIX rotationMat = XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z);
-		XMMATRIX scaleMat = XMMatrixScaling(scale.x, scale.y, scale.z);
+	if (!dirtyMat)
+		return;
 
-		XMMATRIX world = scaleMat * rotationMat * translationMat;
+	XMMATRIX rotationMat = XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z);
+	XMVECTOR positionVec = XMLoadFloat3(&position);
+	const float scales[3] = { scale.x, scale.y, scale.z };
 
-		XMStoreFloat4x4(&worldMatrix, world);
-		XMStoreFloat4x4(&worldInverseTransposeMatrix, XMMatrixInverse(0, XMMatrixTranspose(world)));
+	XMMATRIX world, inverseTranspose;
+	for (int i = 0; i < 3; i++)
+	{
+		XMVECTOR row = rotationMat.r[i];
+		float offset = -XMVectorGetX(XMVector3Dot(positionVec, row));
+
+		world.r[i] = row * XMVectorReplicate(scales[i]);
+		inverseTranspose.r[i] = XMVectorSetW(row, offset) * XMVectorReplicate(1.0f / scales[i]);
 	}
+	world.r[3] = XMVectorSetW(positionVec, 1.0f);
+	inverseTranspose.r[3] = XMVectorSet(0, 0, 0, 1);
+
+	XMStoreFloat4x4(&worldMatrix, world);
+	XMStoreFloat4x4(&worldInverseTransposeMatrix, inverseTranspose);
+	dirtyMat = false;
 }
 void Transform::UpdateVectors() {
 	if (dirtyVec) {
@@ -8,11 +8,16 @@ private:
 	DirectX::XMFLOAT3 position, scale, rotation, up, right, forward;
 	bool dirtyMat, dirtyVec;
 
-	void UpdateMatrices();
 	void UpdateVectors();
 public:
 	Transform();
 
+	// Rebuilds the matrices if anything changed since the last call.
+	// Getters do this lazily; calling it once per frame for every
+	// transform flushes all changes in one pass instead.
+	void UpdateMatrices();
+	bool IsDirty() { return dirtyMat; }
+
 	void SetPosition(float x, float y, float z);
 	void SetRotation(float pitch, float yaw, float roll);
 	void SetScale(float x, float y, float z);
@@ -0,0 +1,284 @@
+#include "TransformStore.h"
+#include "JobSystem.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	// Fewer words of dirty bits (64 transforms each) aren't worth a job
+	const size_t MinWordsPerJob = 16;
+
+	XMVECTOR LoadBatch(const std::vector<float>& component, size_t first)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&component[first]));
+	}
+
+	// --------------------------------------------------------
+	// Stores one row of four matrices at once, where lane i of
+	// x/y/z/w belongs to *matrices[i]
+	// --------------------------------------------------------
+	void StoreRow(XMFLOAT4X4* const* matrices, int row, FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, GXMVECTOR w)
+	{
+		XMMATRIX rows = XMMatrixTranspose(XMMATRIX(x, y, z, w));
+		for (int i = 0; i < 4; i++)
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&matrices[i]->m[row][0]), rows.r[i]);
+	}
+}
+
+TransformStore::TransformStore() :
+	count(0)
+{
+}
+
+void TransformStore::Reserve(size_t capacity)
+{
+	capacity = (capacity + 3) & ~(size_t)3;
+	for (auto* component : { &positionX, &positionY, &positionZ, &pitch, &yaw, &roll, &scaleX, &scaleY, &scaleZ })
+		component->reserve(capacity);
+	parents.reserve(capacity);
+	for (auto* matrices : { &localMatrices, &localInverseTransposeMatrices, &worldMatrices, &worldInverseTransposeMatrices })
+		matrices->reserve(capacity);
+	dirtyBits.reserve((capacity + 63) / 64);
+	changedBits.reserve((capacity + 63) / 64);
+	wordHasChildren.reserve((capacity + 63) / 64);
+}
+
+// --------------------------------------------------------
+// Adds an identity transform, optionally under an existing
+// parent (which puts it wherever the parent is)
+// - Storage grows four transforms at a time, so the
+//   padding is always a valid (identity) transform
+// --------------------------------------------------------
+TransformStore::Handle TransformStore::Create(Handle parent)
+{
+	if (parent != NoParent && parent >= count)
+		parent = NoParent;
+
+	if (count % 4 == 0)
+	{
+		size_t padded = count + 4;
+		for (auto* component : { &positionX, &positionY, &positionZ, &pitch, &yaw, &roll })
+			component->resize(padded, 0.0f);
+		for (auto* component : { &scaleX, &scaleY, &scaleZ })
+			component->resize(padded, 1.0f);
+
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		parents.resize(padded, NoParent);
+		for (auto* matrices : { &localMatrices, &localInverseTransposeMatrices, &worldMatrices, &worldInverseTransposeMatrices })
+			matrices->resize(padded, identity);
+		dirtyBits.resize((padded + 63) / 64, 0);
+		changedBits.resize((padded + 63) / 64, 0);
+		wordHasChildren.resize((padded + 63) / 64, false);
+	}
+
+	Handle h = (Handle)count++;
+	parents[h] = parent;
+	if (parent != NoParent)
+	{
+		wordHasChildren[h >> 6] = true;
+
+		// Picks up the parent's world matrix on the next update
+		MarkDirty(h);
+	}
+	return h;
+}
+
+// Setters
+void TransformStore::SetPosition(Handle h, float x, float y, float z) {
+	positionX[h] = x;
+	positionY[h] = y;
+	positionZ[h] = z;
+	MarkDirty(h);
+}
+void TransformStore::SetRotation(Handle h, float p, float y, float r) {
+	pitch[h] = p;
+	yaw[h] = y;
+	roll[h] = r;
+	MarkDirty(h);
+}
+void TransformStore::SetScale(Handle h, float x, float y, float z) {
+	scaleX[h] = x;
+	scaleY[h] = y;
+	scaleZ[h] = z;
+	MarkDirty(h);
+}
+
+// Getters
+XMFLOAT3 TransformStore::GetPosition(Handle h) {
+	return XMFLOAT3(positionX[h], positionY[h], positionZ[h]);
+}
+XMFLOAT3 TransformStore::GetPitchYawRoll(Handle h) {
+	return XMFLOAT3(pitch[h], yaw[h], roll[h]);
+}
+XMFLOAT3 TransformStore::GetScale(Handle h) {
+	return XMFLOAT3(scaleX[h], scaleY[h], scaleZ[h]);
+}
+
+// Transform functions, same as Transform's
+void TransformStore::MoveAbsolute(Handle h, float x, float y, float z) {
+	positionX[h] += x;
+	positionY[h] += y;
+	positionZ[h] += z;
+	MarkDirty(h);
+}
+void TransformStore::Rotate(Handle h, float p, float y, float r) {
+	pitch[h] += p;
+	yaw[h] += y;
+	roll[h] += r;
+	MarkDirty(h);
+}
+void TransformStore::Scale(Handle h, float x, float y, float z) {
+	scaleX[h] *= x;
+	scaleY[h] *= y;
+	scaleZ[h] *= z;
+	MarkDirty(h);
+}
+
+size_t TransformStore::GetDirtyCount()
+{
+	size_t dirty = 0;
+	for (uint64_t bits : dirtyBits)
+		for (; bits; bits &= bits - 1)
+			dirty++;
+	return dirty;
+}
+
+// --------------------------------------------------------
+// Rebuilds matrices in two passes
+//
+// - Local: walks the dirty bits a word (64 transforms) at
+//   a time, rebuilding any group of four that has a dirty
+//   member
+// - World: roots' local matrices were already written as
+//   their world matrices, so this only visits children, in
+//   handle order.  Parents come first, so a parent's world
+//   matrix is final before any child reads it.  Changes
+//   spread down the hierarchy through the changed bits,
+//   and words with no children are skipped whole.
+// - Local batches only touch their own four transforms, so
+//   with jobs, ranges of words run in parallel.  The world
+//   pass follows parents across words, so it stays serial.
+// --------------------------------------------------------
+void TransformStore::UpdateMatrices(JobSystem* jobs)
+{
+	auto updateLocal = [this](size_t begin, size_t end) {
+		for (size_t w = begin; w < end; w++)
+		{
+			uint64_t bits = dirtyBits[w];
+			changedBits[w] = bits;
+			if (bits == 0)
+				continue;
+
+			for (int group = 0; group < 16; group++)
+			{
+				if ((bits >> (group * 4)) & 0xF)
+					UpdateBatch(w * 64 + group * 4);
+			}
+			dirtyBits[w] = 0;
+		}
+	};
+	if (jobs)
+		jobs->ParallelFor(dirtyBits.size(), MinWordsPerJob, updateLocal);
+	else
+		updateLocal(0, dirtyBits.size());
+
+	for (size_t w = 0; w < changedBits.size(); w++)
+	{
+		if (!wordHasChildren[w])
+			continue;
+
+		size_t end = std::min(count, w * 64 + 64);
+		for (size_t h = w * 64; h < end; h++)
+		{
+			Handle parent = parents[h];
+			if (parent == NoParent)
+				continue;
+
+			bool changed =
+				((changedBits[w] >> (h & 63)) & 1) ||
+				((changedBits[parent >> 6] >> (parent & 63)) & 1);
+			if (!changed)
+				continue;
+
+			changedBits[w] |= 1ull << (h & 63);
+			UpdateWorld(h);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// World = local * parent's world, and the same for the
+// inverse transposes, since (L * P)^-T = L^-T * P^-T
+// --------------------------------------------------------
+void TransformStore::UpdateWorld(size_t h)
+{
+	Handle parent = parents[h];
+	XMStoreFloat4x4(&worldMatrices[h],
+		XMLoadFloat4x4(&localMatrices[h]) * XMLoadFloat4x4(&worldMatrices[parent]));
+	XMStoreFloat4x4(&worldInverseTransposeMatrices[h],
+		XMLoadFloat4x4(&localInverseTransposeMatrices[h]) * XMLoadFloat4x4(&worldInverseTransposeMatrices[parent]));
+}
+
+// --------------------------------------------------------
+// Builds local = scale * rotation * translation for four
+// transforms, one per SIMD lane
+//
+// - Rotation terms are the same as XMMatrixRotationRollPitchYaw
+// - The inverse transpose comes straight from the parts:
+//   the rotation's rows divided by their scale, plus a
+//   translation column of -dot(position, row) / scale,
+//   with no general 4x4 inverse
+// --------------------------------------------------------
+void TransformStore::UpdateBatch(size_t first)
+{
+	XMVECTOR sp, cp, sy, cy, sr, cr;
+	XMVectorSinCos(&sp, &cp, LoadBatch(pitch, first));
+	XMVectorSinCos(&sy, &cy, LoadBatch(yaw, first));
+	XMVectorSinCos(&sr, &cr, LoadBatch(roll, first));
+
+	// Rotation matrix, element by element
+	XMVECTOR r00 = cr * cy + sr * sp * sy;
+	XMVECTOR r01 = sr * cp;
+	XMVECTOR r02 = sr * sp * cy - cr * sy;
+	XMVECTOR r10 = cr * sp * sy - sr * cy;
+	XMVECTOR r11 = cr * cp;
+	XMVECTOR r12 = sr * sy + cr * sp * cy;
+	XMVECTOR r20 = cp * sy;
+	XMVECTOR r21 = XMVectorNegate(sp);
+	XMVECTOR r22 = cp * cy;
+
+	XMVECTOR sx = LoadBatch(scaleX, first);
+	XMVECTOR sY = LoadBatch(scaleY, first);
+	XMVECTOR sz = LoadBatch(scaleZ, first);
+	XMVECTOR tx = LoadBatch(positionX, first);
+	XMVECTOR ty = LoadBatch(positionY, first);
+	XMVECTOR tz = LoadBatch(positionZ, first);
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR one = XMVectorSplatOne();
+
+	// Roots have nothing to combine with, so theirs go straight to world
+	XMFLOAT4X4* matrices[4];
+	XMFLOAT4X4* inverseTransposes[4];
+	for (int i = 0; i < 4; i++)
+	{
+		bool root = parents[first + i] == NoParent;
+		matrices[i] = root ? &worldMatrices[first + i] : &localMatrices[first + i];
+		inverseTransposes[i] = root ? &worldInverseTransposeMatrices[first + i] : &localInverseTransposeMatrices[first + i];
+	}
+
+	StoreRow(matrices, 0, r00 * sx, r01 * sx, r02 * sx, zero);
+	StoreRow(matrices, 1, r10 * sY, r11 * sY, r12 * sY, zero);
+	StoreRow(matrices, 2, r20 * sz, r21 * sz, r22 * sz, zero);
+	StoreRow(matrices, 3, tx, ty, tz, one);
+
+	XMVECTOR invX = XMVectorReciprocal(sx);
+	XMVECTOR invY = XMVectorReciprocal(sY);
+	XMVECTOR invZ = XMVectorReciprocal(sz);
+
+	StoreRow(inverseTransposes, 0, r00 * invX, r01 * invX, r02 * invX, XMVectorNegate(tx * r00 + ty * r01 + tz * r02) * invX);
+	StoreRow(inverseTransposes, 1, r10 * invY, r11 * invY, r12 * invY, XMVectorNegate(tx * r10 + ty * r11 + tz * r12) * invY);
+	StoreRow(inverseTransposes, 2, r20 * invZ, r21 * invZ, r22 * invZ, XMVectorNegate(tx * r20 + ty * r21 + tz * r22) * invZ);
+	StoreRow(inverseTransposes, 3, zero, zero, zero, one);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// --------------------------------------------------------
+// Structure-of-arrays storage for many transforms
+//
+// - Each transform is a handle (an index).  Positions,
+//   rotations and scales live in one float array per
+//   component, so four transforms load as one vector
+// - Setters only mark a transform dirty.  UpdateMatrices()
+//   then rebuilds just the dirty ones, four at a time,
+//   into contiguous world / inverse transpose arrays
+// - Rotations are pitch/yaw/roll, matching Transform
+// - A transform can have a parent, which must already
+//   exist.  Parents therefore always come before their
+//   children, so world matrices are propagated in one
+//   linear pass instead of a recursive walk
+// --------------------------------------------------------
+class TransformStore
+{
+public:
+	typedef uint32_t Handle;
+	static constexpr Handle NoParent = 0xFFFFFFFF;
+
+private:
+	size_t count;
+
+	// Padded to a multiple of 4 so batches never run off the end
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> pitch, yaw, roll;
+	std::vector<float> scaleX, scaleY, scaleZ;
+	std::vector<Handle> parents;
+
+	// Relative to the parent, then the result of the hierarchy pass
+	std::vector<DirectX::XMFLOAT4X4> localMatrices;
+	std::vector<DirectX::XMFLOAT4X4> localInverseTransposeMatrices;
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+	std::vector<DirectX::XMFLOAT4X4> worldInverseTransposeMatrices;
+
+	// One bit per transform, so clean stretches are skipped 64 at a time
+	std::vector<uint64_t> dirtyBits;
+	std::vector<uint64_t> changedBits;
+
+	// Whether each 64-transform word has any transform with a parent
+	std::vector<bool> wordHasChildren;
+
+	void MarkDirty(Handle h) { dirtyBits[h >> 6] |= 1ull << (h & 63); }
+	void UpdateBatch(size_t first);
+	void UpdateWorld(size_t h);
+
+public:
+	TransformStore();
+
+	void Reserve(size_t capacity);
+	Handle Create(Handle parent = NoParent);
+	size_t GetCount() { return count; }
+	Handle GetParent(Handle h) { return parents[h]; }
+
+	void SetPosition(Handle h, float x, float y, float z);
+	void SetRotation(Handle h, float pitch, float yaw, float roll);
+	void SetScale(Handle h, float x, float y, float z);
+
+	DirectX::XMFLOAT3 GetPosition(Handle h);
+	DirectX::XMFLOAT3 GetPitchYawRoll(Handle h);
+	DirectX::XMFLOAT3 GetScale(Handle h);
+
+	void MoveAbsolute(Handle h, float x, float y, float z);
+	void Rotate(Handle h, float pitch, float yaw, float roll);
+	void Scale(Handle h, float x, float y, float z);
+
+	// Rebuilds the matrices of every transform changed since the
+	// last call, and of everything below them in the hierarchy.
+	// Given jobs, the local pass is split across its threads.
+	void UpdateMatrices(JobSystem* jobs = 0);
+	size_t GetDirtyCount();
+
+	// Only up to date after UpdateMatrices()
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(Handle h) { return worldMatrices[h]; }
+	const DirectX::XMFLOAT4X4& GetWorldInverseTransposeMatrix(Handle h) { return worldInverseTransposeMatrices[h]; }
+	const DirectX::XMFLOAT4X4* GetWorldMatrices() { return worldMatrices.data(); }
+	const DirectX::XMFLOAT4X4* GetWorldInverseTransposeMatrices() { return worldInverseTransposeMatrices.data(); }
+};
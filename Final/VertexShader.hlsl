@@ -1,11 +1,11 @@
 #include "Lighting.hlsli"
 
-// Input for m, v, p mats
-cbuffer ExternalData : register(b0)
+// The only data uploaded for every draw; worldViewProjection
+// is multiplied out on the CPU, once per object
+cbuffer PerObject : register(b2)
 {
+	matrix worldViewProjection;
 	matrix world;
-	matrix view;
-	matrix projection;
 	matrix worldInvTranspose;
 }
 
@@ -17,8 +17,7 @@ VertexToPixel main(VertexShaderInput input)
 	
 	VertexToPixel output;
 
-	matrix wvp = mul(projection, mul(view, world));
-	output.screenPosition = mul(wvp, float4(input.localPosition, 1.0f));
+	output.screenPosition = mul(worldViewProjection, float4(input.localPosition, 1.0f));
 	output.uv = input.uv;
 	output.normal = mul((float3x3)worldInvTranspose, input.normal);
 	output.tangent = mul((float3x3)world, input.tangent);
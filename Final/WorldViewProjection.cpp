@@ -0,0 +1,32 @@
+#include "WorldViewProjection.h"
+
+using namespace DirectX;
+
+void ComputeWorldViewProjections(const XMFLOAT4X4& viewProjection, const XMFLOAT4X4* worlds, const uint32_t* indices, size_t count, XMFLOAT4X4* results)
+{
+	XMVECTOR vp0 = XMLoadFloat4((const XMFLOAT4*)viewProjection.m[0]);
+	XMVECTOR vp1 = XMLoadFloat4((const XMFLOAT4*)viewProjection.m[1]);
+	XMVECTOR vp2 = XMLoadFloat4((const XMFLOAT4*)viewProjection.m[2]);
+	XMVECTOR vp3 = XMLoadFloat4((const XMFLOAT4*)viewProjection.m[3]);
+
+	for (size_t n = 0; n < count; n++)
+	{
+		const XMFLOAT4X4& w = worlds[indices[n]];
+		XMFLOAT4X4& out = results[n];
+
+		// Each result row is the world row's xyz weighting the view-projection
+		// rows; the world's w column is 0 except in the translation row
+		for (int r = 0; r < 3; r++)
+		{
+			XMVECTOR row = XMVectorScale(vp0, w.m[r][0]);
+			row = XMVectorMultiplyAdd(XMVectorReplicate(w.m[r][1]), vp1, row);
+			row = XMVectorMultiplyAdd(XMVectorReplicate(w.m[r][2]), vp2, row);
+			XMStoreFloat4((XMFLOAT4*)out.m[r], row);
+		}
+
+		XMVECTOR row = XMVectorMultiplyAdd(XMVectorReplicate(w._41), vp0, vp3);
+		row = XMVectorMultiplyAdd(XMVectorReplicate(w._42), vp1, row);
+		row = XMVectorMultiplyAdd(XMVectorReplicate(w._43), vp2, row);
+		XMStoreFloat4((XMFLOAT4*)out.m[3], row);
+	}
+}
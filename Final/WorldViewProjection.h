@@ -0,0 +1,24 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+
+// --------------------------------------------------------
+// Multiplies a batch of world matrices by one view-
+// projection matrix, so vertex shaders get a finished
+// world-view-projection instead of chaining three matrices
+// for every vertex
+//
+// - results[n] = worlds[indices[n]] * viewProjection, with
+//   indices picking out (say) just the visible transforms
+// - Worlds must be affine (last column 0, 0, 0, 1), as
+//   TransformStore's always are, which saves a quarter of
+//   the multiplies
+// --------------------------------------------------------
+void ComputeWorldViewProjections(
+	const DirectX::XMFLOAT4X4& viewProjection,
+	const DirectX::XMFLOAT4X4* worlds,
+	const uint32_t* indices,
+	size_t count,
+	DirectX::XMFLOAT4X4* results);